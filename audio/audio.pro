@@ -61,32 +61,19 @@ LIBS += -ldl -lasound
 SOURCES += main.cpp \
     kmreaudio.cpp \
     audio_adaptor.cpp \
-    threadpool.cpp \
     audioserver.cpp \
     playbackworker.cpp \
-    recordingworker.cpp \
-    utils.cpp \
-    common/utils/sockets.cpp \
-    common/socket/UnixStream.cpp \
-    common/socket/SocketStream.cpp
+    recordingworker.cpp
 
 HEADERS += \
     kmreaudio.h \
     audio_adaptor.h \
-    threadpool.h \
     audioserver.h \
     playbackworker.h \
     recordingworker.h \
-    utils.h \
-    common/utils/thread.h \
-    common/utils/sockets.h \
-    common/socket/UnixStream.h \
-    common/socket/SocketStream.h \
-    common/include/IOStream.h \
     myutils.h
 
-INCLUDEPATH += common
-INCLUDEPATH += common/include
+include(../common/common.pri)
 
 # for wayland
 #DEFINES += UKUI_WAYLAND
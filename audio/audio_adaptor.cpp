@@ -33,6 +33,14 @@ AudioAdaptor::~AudioAdaptor()
     // destructor
 }
 
+QVariantMap AudioAdaptor::getStreamStats()
+{
+    // handle method call cn.kylinos.Kmre.Audio.getStreamStats
+    QVariantMap out0;
+    QMetaObject::invokeMethod(parent(), "getStreamStats", Q_RETURN_ARG(QVariantMap, out0));
+    return out0;
+}
+
 void AudioAdaptor::start()
 {
     // handle method call cn.kylinos.Kmre.Audio.start
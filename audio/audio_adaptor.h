@@ -34,6 +34,10 @@ class AudioAdaptor: public QDBusAbstractAdaptor
 "  <interface name=\"cn.kylinos.Kmre.Audio\">\n"
 "    <method name=\"start\"/>\n"
 "    <method name=\"stop\"/>\n"
+"    <method name=\"getStreamStats\">\n"
+"      <arg direction=\"out\" type=\"a{sv}\"/>\n"
+"      <annotation value=\"QVariantMap\" name=\"org.qtproject.QtDBus.QtTypeName.Out0\"/>\n"
+"    </method>\n"
 "  </interface>\n"
         "")
 public:
@@ -42,6 +46,7 @@ public:
 
 public: // PROPERTIES
 public Q_SLOTS: // METHODS
+    QVariantMap getStreamStats();
     void start();
     void stop();
 Q_SIGNALS: // SIGNALS
@@ -26,6 +26,7 @@
 #include "playbackworker.h"
 #include "recordingworker.h"
 #include "threadpool.h"
+#include "utils.h"
 
 AudioServer::AudioServer(QObject *parent)
     : QObject(parent)
@@ -41,6 +42,7 @@ AudioServer::~AudioServer()
 void AudioServer::onInit()
 {
     m_playWorker = new PlaybackWorker();
+    m_playWorker->setStreamStats(&mPlaybackStats);
     mPlayWorkerThread = ThreadPool::instance()->newThread();
     m_playWorker->moveToThread(mPlayWorkerThread);
     connect(mPlayWorkerThread, SIGNAL(started()), m_playWorker, SLOT(initData()));
@@ -49,6 +51,7 @@ void AudioServer::onInit()
 
 
     m_recordWorker = new RecordingWorker();
+    m_recordWorker->setStreamStats(&mRecordingStats);
     QThread *thread2 = ThreadPool::instance()->newThread();
     m_recordWorker->moveToThread(thread2);
     connect(thread2, SIGNAL(started()), m_recordWorker, SLOT(initData()));
@@ -64,6 +67,14 @@ void AudioServer::onInit()
 #endif
 }
 
+QVariantMap AudioServer::streamStats()
+{
+    QVariantMap stats;
+    stats.insert("playback", Utils::streamStatsToMap(mPlaybackStats));
+    stats.insert("recording", Utils::streamStatsToMap(mRecordingStats));
+    return stats;
+}
+
 void AudioServer::onSleep(bool sleep)
 {
     syslog(LOG_INFO, "[%s] sleep = %d, ", __func__, sleep);
@@ -77,6 +88,7 @@ void AudioServer::onSleep(bool sleep)
         }
         syslog(LOG_DEBUG, "[%s] re-init playback ...", __func__);
         m_playWorker = new PlaybackWorker();
+        m_playWorker->setStreamStats(&mPlaybackStats);
         mPlayWorkerThread = ThreadPool::instance()->newThread();
         m_playWorker->moveToThread(mPlayWorkerThread);
         connect(mPlayWorkerThread, SIGNAL(started()), m_playWorker, SLOT(initData()));
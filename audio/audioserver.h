@@ -25,6 +25,7 @@
 #include <QThread>
 #include <QList>
 #include <QMap>
+#include <QVariantMap>
 
 #include "socket/UnixStream.h"
 
@@ -38,6 +39,9 @@ public:
     explicit AudioServer(QObject *parent = nullptr);
     ~AudioServer();
 
+    /* playback/recording两路socket的统计，可在任意线程调用 */
+    QVariantMap streamStats();
+
 public slots:
     void onInit();
     void onSleep(bool sleep);
@@ -47,6 +51,8 @@ private:
     RecordingWorker *m_recordWorker = nullptr;
     QThread *mPlayWorkerThread = nullptr;
     QThread *mRecordWorkerThread = nullptr;
+    SocketStreamStats mPlaybackStats;
+    SocketStreamStats mRecordingStats;
 };
 
 #endif // AUDIOSEVER_H
@@ -26,6 +26,7 @@
 #include "threadpool.h"
 #include "audioserver.h"
 #include "utils.h"
+#include "utils/servicehost.h"
 
 KmreAudio::KmreAudio(QObject * parent)
     : QObject(parent)
@@ -49,6 +50,11 @@ void KmreAudio::init()
     connect(thread, SIGNAL(started()), m_server, SLOT(onInit()));
     thread->start();
 
+    /* 合并进程模式下由宿主统一处理Stopped信号 */
+    if (kmre::ServiceHost::isHosted()) {
+        return;
+    }
+
     QDBusConnection::systemBus().connect(QString("cn.kylinos.Kmre"),
                                              QString("/cn/kylinos/Kmre"),
                                              QString("cn.kylinos.Kmre"),
@@ -62,9 +68,20 @@ void KmreAudio::start()
 
 void KmreAudio::stop()
 {
+    if (kmre::ServiceHost::handleStop("cn.kylinos.Kmre.Audio")) {
+        return;
+    }
     qApp->quit();
 }
 
+QVariantMap KmreAudio::getStreamStats()
+{
+    if (!m_server) {
+        return QVariantMap();
+    }
+    return m_server->streamStats();
+}
+
 void KmreAudio::onStopApplication(const QString &container)
 {
     QString name = QString("kmre-%1-%2").arg(Utils::getUid()).arg(Utils::getUserName());
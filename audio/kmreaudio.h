@@ -21,6 +21,7 @@
 #define KMRE_AUDIO_H
 
 #include <QObject>
+#include <QVariantMap>
 
 class AudioServer;
 
@@ -36,6 +37,7 @@ public:
 public slots:
     void start();
     void stop();
+    QVariantMap getStreamStats();
     void onStopApplication(const QString &container);
 
 private:
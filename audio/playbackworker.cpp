@@ -26,6 +26,7 @@
 #define DEFAULT_SAMPLE_RATE 48000
 #define DEFAULT_SAMPLE_FORMAT SND_PCM_FORMAT_S16_LE
 #define DEFAULT_NUM_CHANNELS 2
+#define HANDSHAKE_TIMEOUT_MS 3000
 
 
 
@@ -87,7 +88,8 @@ void PlaybackWorker::start()
                 continue;
             }
 
-            if (!m_stream->readFully(&type, sizeof(type))) {
+            m_stream->attachStats(mStreamStats);
+            if (!m_stream->readFully(&type, sizeof(type), HANDSHAKE_TIMEOUT_MS)) {
 		if (mExit) {
                     syslog(LOG_ERR, "PlaybackWorker: Exit playback now...");
                     break;
@@ -33,6 +33,8 @@ public:
     void start();
     void stop();
     void exitPlayback();
+    /* 统计信息归AudioServer所有，重建worker后继续累计 */
+    void setStreamStats(SocketStreamStats *stats) { mStreamStats = stats; }
 
 public slots:
     void initData();
@@ -52,6 +54,7 @@ private:
 
     QByteArray mPlaybackBuffer;
     SocketStream *m_stream = nullptr;
+    SocketStreamStats *mStreamStats = nullptr;
 
 private:
     bool mExit = false;
@@ -29,6 +29,8 @@
 #define DEFAULT_NUM_CHANNELS 1
 #define READ_TRY_TIMES 500
 #define RECORD_BUFFER_TIME_MAX 500000 // 500ms
+#define HANDSHAKE_TIMEOUT_MS 3000
+#define WRITE_TIMEOUT_MS 2000
 
 
 RecordingWorker::RecordingWorker(QObject *parent) : QObject(parent)
@@ -95,7 +97,8 @@ void RecordingWorker::start()
                 fprintf(stderr, "Error accepting connection, ignoring.\n");
                 continue;
             }
-            if (!m_stream->readFully(&type, sizeof(type))) {
+            m_stream->attachStats(mStreamStats);
+            if (!m_stream->readFully(&type, sizeof(type), HANDSHAKE_TIMEOUT_MS)) {
                 syslog(LOG_ERR, "RecordingWorker: Error reading client type info.");
                 fprintf(stderr,"Error reading client info\n");
                 m_stream->forceStop();
@@ -104,7 +107,7 @@ void RecordingWorker::start()
                 continue;
             }
             if (type == RECORDING) {//录音RECORDING: 从PCM读取数据，发送给android的audio.primary.kmre.so去处理
-                if (!m_stream->readFully(&mClientSampleRate, sizeof(mClientSampleRate))) {
+                if (!m_stream->readFully(&mClientSampleRate, sizeof(mClientSampleRate), HANDSHAKE_TIMEOUT_MS)) {
                     syslog(LOG_ERR, "RecordingWorker: Error reading client samplerate.");
                     fprintf(stderr,"Error reading client samplerate\n");
                     m_stream->forceStop();
@@ -174,6 +177,10 @@ void RecordingWorker::start()
                 continue;
             }
 
+            // 不足一个period的短读先缓存，随下一次完整读取一起发送
+            mWriter.setStream(m_stream);
+            // 容器端停止读取时不再阻塞录音线程
+            mWriter.setTimeout(WRITE_TIMEOUT_MS);
             while (1) {
                 //读取音频
                 int32_t nframe = snd_pcm_readi(mRecoder->pcm, mReadBuffer.data(), mRecoder->period_size);
@@ -220,7 +227,8 @@ void RecordingWorker::start()
                         //syslog(LOG_DEBUG, "RecordingWorker: nframe = %d, inFrame = %d, outFrame = %d, result = %d", 
                         //        nframe, inFrame, outFrame, result);
                         if (result == RESAMPLER_ERR_SUCCESS) {
-                            ret = m_stream->writeFully(speexOutBuffer.constData(), outFrame * mRecoder->sample_bytes);
+                            ret = mWriter.write(speexOutBuffer.constData(), outFrame * mRecoder->sample_bytes,
+                                                (uint32_t)nframe < mRecoder->period_size);
                             if (ret < 0) {
                                 syslog(LOG_ERR, "RecordingWorker: Failed to write data to recording stream.");
                                 fprintf(stderr, "Failed to write data to recording stream.\n");
@@ -229,7 +237,8 @@ void RecordingWorker::start()
                         }
                     } 
                     else {
-                        ret = m_stream->writeFully(mReadBuffer.data(), nframe * mRecoder->sample_bytes);
+                        ret = mWriter.write(mReadBuffer.data(), nframe * mRecoder->sample_bytes,
+                                            (uint32_t)nframe < mRecoder->period_size);
                         if (ret < 0) {
                             syslog(LOG_ERR, "RecordingWorker: Failed to write data to recording stream.");
                             fprintf(stderr, "Failed to write data to recording stream.\n");
@@ -249,6 +258,7 @@ void RecordingWorker::start()
                 }
             }
 
+            mWriter.setStream(nullptr);
             if (m_stream) {
                 m_stream->forceStop();
                 delete m_stream;
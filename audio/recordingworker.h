@@ -27,6 +27,7 @@
 #include <speex/speex_preprocess.h>
 
 #include "audioserver.h"
+#include "socket/SocketWriter.h"
 
 class RecordingWorker : public QObject
 {
@@ -37,6 +38,8 @@ public:
 
     void start();
     void stop();
+    /* 统计信息归AudioServer所有 */
+    void setStreamStats(SocketStreamStats *stats) { mStreamStats = stats; }
 
 signals:
     void requestSendAudioDataToAndroid(QByteArray buffer, int len);
@@ -66,6 +69,8 @@ private:
     snd_pcm_format_t mClientSampleFormat;
 
     SocketStream *m_stream = nullptr;
+    SocketWriter mWriter;
+    SocketStreamStats *mStreamStats = nullptr;
     SpeexResamplerState* mSpeexResampler = nullptr;
     SpeexPreprocessState *mSpeexPreprocesser = nullptr;
 
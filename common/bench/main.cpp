@@ -0,0 +1,208 @@
+/*
+ * Copyright (c) KylinSoft Co., Ltd. 2016-2024.All rights reserved.
+ *
+ * Authors:
+ *  Ma Chao    machao@kylinos.cn
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Measures what SocketWriter saves on the small fixed-size records the gps
+// and sensor daemons send: the same messages go over a local stream socket
+// with one writeFully() each (the old path), through SocketWriter without
+// coalescing, and through SocketWriter with more set for all but every
+// batch-th message, like a trace replay inside its coalescing window.
+//
+// usage: kylin-kmre-socket-bench [-n messages] [-b batch]
+//
+// sendmsg() is wrapped at link time (see socket-bench.pro), so the syscall
+// column counts real calls, including the retries after partial sends.
+
+#include <atomic>
+#include <string>
+#include <thread>
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/socket.h>
+
+#include "socket/SocketWriter.h"
+#include "socket/UnixStream.h"
+
+namespace {
+
+std::atomic<uint64_t> sendmsgCalls(0);
+
+struct Result
+{
+    uint64_t messages;
+    uint64_t syscalls;
+    uint64_t bytes;
+    double elapsedMs;
+};
+
+int64_t nowNs()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000000ll + ts.tv_nsec;
+}
+
+// Drains the peer end until the writer closes it, returns the bytes read.
+uint64_t drain(SocketStream* stream)
+{
+    char buffer[64 * 1024];
+    uint64_t total = 0;
+
+    while (true) {
+        int n = stream->recv(buffer, sizeof(buffer));
+        if (n <= 0) {
+            break;
+        }
+        total += n;
+    }
+    return total;
+}
+
+enum Mode {
+    MODE_WRITE_FULLY,
+    MODE_WRITER,
+    MODE_COALESCED,
+};
+
+Result run(const std::string& path, Mode mode, size_t size, uint64_t messages, int batch)
+{
+    Result result = { messages, 0, 0, 0 };
+    UnixStream server;
+    UnixStream client;
+    uint64_t received = 0;
+
+    if (server.listen(path.c_str()) < 0 || client.connect(path.c_str()) < 0) {
+        fprintf(stderr, "Failed to set up %s: %s\n", path.c_str(), strerror(errno));
+        exit(1);
+    }
+    SocketStream* stream = server.accept();
+    if (!stream) {
+        fprintf(stderr, "Failed to accept on %s: %s\n", path.c_str(), strerror(errno));
+        exit(1);
+    }
+
+    std::thread reader([&client, &received]() { received = drain(&client); });
+
+    std::string message(size, 'x');
+    SocketWriter writer;
+    writer.setStream(stream);
+
+    const uint64_t calls = sendmsgCalls;
+    const int64_t start = nowNs();
+    for (uint64_t i = 0; i < messages; i++) {
+        switch (mode) {
+        case MODE_WRITE_FULLY:
+            stream->writeFully(message.data(), message.size());
+            break;
+        case MODE_WRITER:
+            writer.write(message.data(), message.size());
+            break;
+        case MODE_COALESCED:
+            writer.write(message.data(), message.size(), (i + 1) % batch != 0);
+            break;
+        }
+    }
+    writer.flush();
+    result.elapsedMs = (nowNs() - start) / 1e6;
+    result.syscalls = sendmsgCalls - calls;
+
+    writer.setStream(nullptr);
+    delete stream;
+    reader.join();
+    result.bytes = received;
+
+    if (received != messages * size) {
+        fprintf(stderr, "Lost data: sent %llu bytes, received %llu.\n",
+                (unsigned long long)(messages * size), (unsigned long long)received);
+        exit(1);
+    }
+    return result;
+}
+
+void usage(const char* name)
+{
+    fprintf(stderr, "usage: %s [-n messages] [-b batch]\n", name);
+}
+
+} // namespace
+
+extern "C" ssize_t __real_sendmsg(int fd, const struct msghdr* msg, int flags);
+
+extern "C" ssize_t __wrap_sendmsg(int fd, const struct msghdr* msg, int flags)
+{
+    sendmsgCalls++;
+    return __real_sendmsg(fd, msg, flags);
+}
+
+int main(int argc, char* argv[])
+{
+    uint64_t messages = 1000000;
+    int batch = 16;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "n:b:h")) != -1) {
+        switch (opt) {
+        case 'n':
+            messages = strtoull(optarg, nullptr, 10);
+            break;
+        case 'b':
+            batch = atoi(optarg);
+            break;
+        default:
+            usage(argv[0]);
+            return opt == 'h' ? 0 : 1;
+        }
+    }
+    if (messages == 0 || batch <= 0) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    const std::string path = "/tmp/kylin-kmre-socket-bench-" + std::to_string(getpid()) + ".sock";
+    // the sizes of one gps and one sensor record
+    const struct {
+        const char* name;
+        size_t size;
+    } records[] = { { "gps", 65 }, { "sensor", 128 } };
+    const struct {
+        const char* name;
+        Mode mode;
+    } modes[] = { { "writeFully", MODE_WRITE_FULLY }, { "writer", MODE_WRITER }, { "coalesced", MODE_COALESCED } };
+
+    printf("%llu messages per run, coalesced batches of %d\n\n", (unsigned long long)messages, batch);
+    printf("%-7s %-11s %10s %10s %12s %12s %9s\n", "record", "mode", "syscalls", "ms", "msg/s", "syscalls/s",
+           "msg/call");
+    for (const auto& record : records) {
+        for (const auto& mode : modes) {
+            const Result r = run(path, mode.mode, record.size, messages, batch);
+            const double seconds = r.elapsedMs / 1000;
+            printf("%-7s %-11s %10llu %10.1f %12.0f %12.0f %9.1f\n", record.name, mode.name,
+                   (unsigned long long)r.syscalls, r.elapsedMs, r.messages / seconds, r.syscalls / seconds,
+                   (double)r.messages / r.syscalls);
+            fflush(stdout);
+        }
+    }
+    unlink(path.c_str());
+
+    return 0;
+}
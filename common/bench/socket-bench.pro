@@ -0,0 +1,43 @@
+# Copyright (c) KylinSoft Co., Ltd. 2016-2024.All rights reserved.
+#
+# Authors:
+#  Ma Chao    machao@kylinos.cn
+#
+# This program is free software; you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation; version 3.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+# Syscalls per second of the gps/sensor socket writes, see main.cpp.
+# Built with qmake CONFIG+=kmre_bench from the top level, never installed.
+
+TARGET = kylin-kmre-socket-bench
+TEMPLATE = app
+
+QT -= gui
+QT += core
+
+CONFIG += c++11
+CONFIG -= app_bundle
+
+include(../common.pri)
+
+# count every sendmsg() of SocketStream
+QMAKE_LFLAGS += -Wl,--wrap=sendmsg
+LIBS += -lpthread
+
+DEFINES += QT_DEPRECATED_WARNINGS
+
+SOURCES += main.cpp
+
+unix {
+    MOC_DIR = .moc
+    OBJECTS_DIR = .obj
+}
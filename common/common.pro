@@ -0,0 +1,62 @@
+# Copyright (c) KylinSoft Co., Ltd. 2016-2024.All rights reserved.
+#
+# Authors:
+#  Kobe Lee    lixiang@kylinos.cn
+#
+# This program is free software; you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation; version 3.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+# Runtime shared by the per-user daemons (audio, sensors, gps, filewatcher):
+# socket streams, thread pool, user helpers, trace log, lock files and the
+# hook used when several services share one process.
+# Linked statically, see common.pri.
+
+TARGET = kmre-common
+TEMPLATE = lib
+
+QT -= gui
+QT += core
+CONFIG += c++11 staticlib
+CONFIG -= app_bundle
+
+SOURCES += \
+    socket/SocketStream.cpp \
+    socket/SocketWriter.cpp \
+    socket/UnixStream.cpp \
+    utils/lockfile.cpp \
+    utils/servicehost.cpp \
+    utils/sockets.cpp \
+    utils/trace_log.cpp \
+    threadpool.cpp \
+    utils.cpp
+
+HEADERS += \
+    include/IOStream.h \
+    socket/SocketStream.h \
+    socket/SocketWriter.h \
+    socket/UnixStream.h \
+    utils/lockfile.h \
+    utils/mutex.h \
+    utils/servicehost.h \
+    utils/sockets.h \
+    utils/thread.h \
+    utils/trace_log.h \
+    threadpool.h \
+    utils.h
+
+INCLUDEPATH += $$PWD
+INCLUDEPATH += $$PWD/include
+
+unix {
+    MOC_DIR = .moc
+    OBJECTS_DIR = .obj
+}
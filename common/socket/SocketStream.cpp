@@ -0,0 +1,413 @@
+/*
+* Copyright (C) 2011 The Android Open Source Project
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+#include "SocketStream.h"
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string.h>
+#include <limits.h>
+
+#ifndef _WIN32
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <poll.h>
+#include <time.h>
+#else
+#include <ws2tcpip.h>
+#endif
+
+SocketStream::SocketStream(size_t bufSize) :
+    IOStream(bufSize),
+    m_sock(-1),
+    m_bufsize(bufSize),
+    m_buf(NULL),
+    m_stats(&m_ownStats)
+{
+}
+
+SocketStream::SocketStream(int sock, size_t bufSize) :
+    IOStream(bufSize),
+    m_sock(sock),
+    m_bufsize(bufSize),
+    m_buf(NULL),
+    m_stats(&m_ownStats)
+{
+    m_ownStats.connected = valid();
+}
+
+SocketStream::~SocketStream()
+{
+    m_stats->connected = false;
+    if (m_sock >= 0) {
+        forceStop();
+#ifndef _WIN32
+        if(close(m_sock) < 0)
+          perror("Closing SocketStream failed");
+#endif
+        // DBG("SocketStream::~close  @ %d \n", m_sock);
+        m_sock = -1;
+    }
+    if (m_buf != NULL) {
+        free(m_buf);
+        m_buf = NULL;
+    }
+}
+
+
+void *SocketStream::allocBuffer(size_t minSize)
+{
+    size_t allocSize = (m_bufsize < minSize ? minSize : m_bufsize);
+    if (!m_buf) {
+        m_buf = (unsigned char *)malloc(allocSize);
+    }
+    else if (m_bufsize < allocSize) {
+        unsigned char *p = (unsigned char *)realloc(m_buf, allocSize);
+        if (p != NULL) {
+            m_buf = p;
+            m_bufsize = allocSize;
+        } else {
+            free(m_buf);
+            m_buf = NULL;
+            m_bufsize = 0;
+        }
+    }
+
+    return m_buf;
+};
+
+int SocketStream::commitBuffer(size_t size)
+{
+    return writeFully(m_buf, size);
+}
+
+static int64_t monotonicUs()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static int64_t deadlineFor(int timeoutMs)
+{
+    return timeoutMs < 0 ? -1 : monotonicUs() + (int64_t)timeoutMs * 1000;
+}
+
+static bool isPeerGone(int err)
+{
+    return err == EPIPE || err == ECONNRESET || err == ENOTCONN;
+}
+
+void SocketStream::attachStats(SocketStreamStats *stats)
+{
+    m_stats = stats ? stats : &m_ownStats;
+    m_stats->connected = valid();
+}
+
+void SocketStream::markPeerGone()
+{
+    if (m_stats->connected.exchange(false)) {
+        m_stats->peerDeaths++;
+    }
+}
+
+int SocketStream::waitFor(short events, int64_t deadlineUs)
+{
+    struct pollfd pfd;
+    pfd.fd = m_sock;
+    pfd.events = events;
+
+    int64_t start = monotonicUs();
+    int ret;
+    while (true) {
+        int timeout = -1;
+        if (deadlineUs >= 0) {
+            int64_t left = deadlineUs - monotonicUs();
+            if (left <= 0) {
+                m_stats->timeouts++;
+                errno = ETIMEDOUT;
+                ret = 0;
+                break;
+            }
+            timeout = (int)((left + 999) / 1000);
+        }
+
+        pfd.revents = 0;
+        int n = ::poll(&pfd, 1, timeout);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            ret = -1;
+            break;
+        }
+        if (n == 0) {
+            continue;   // re-check the deadline
+        }
+        if (pfd.revents & POLLNVAL) {
+            errno = EBADF;
+            ret = -1;
+            break;
+        }
+        // POLLHUP/POLLERR: let recv()/send() report what happened
+        ret = 1;
+        break;
+    }
+
+    m_stats->stallUs += monotonicUs() - start;
+    return ret;
+}
+
+bool SocketStream::peerAlive()
+{
+    if (!valid()) return false;
+
+    struct pollfd pfd;
+    pfd.fd = m_sock;
+    pfd.events = POLLIN | POLLRDHUP;
+    pfd.revents = 0;
+
+    int n;
+    do {
+        n = ::poll(&pfd, 1, 0);
+    } while (n < 0 && errno == EINTR);
+
+    if (n <= 0) {
+        return n == 0;
+    }
+    if (pfd.revents & (POLLHUP | POLLRDHUP | POLLERR | POLLNVAL)) {
+        markPeerGone();
+        return false;
+    }
+    return true;
+}
+
+int SocketStream::writeFully(const void* buffer, size_t size)
+{
+    return writeFully(buffer, size, -1);
+}
+
+int SocketStream::writeFully(const void* buffer, size_t size, int timeoutMs)
+{
+    struct iovec iov;
+    iov.iov_base = const_cast<void *>(buffer);
+    iov.iov_len = size;
+    return writeFullyv(&iov, 1, 0, timeoutMs);
+}
+
+int SocketStream::writeFullyv(const struct iovec *iov, int iovcnt, int flags)
+{
+    return writeFullyv(iov, iovcnt, flags, -1);
+}
+
+int SocketStream::writeFullyv(const struct iovec *iov, int iovcnt, int flags, int timeoutMs)
+{
+    if (!valid()) return -1;
+    if (iovcnt <= 0) return 0;
+
+    if (iovcnt > IOV_MAX) {
+        errno = EINVAL;
+        return -1;
+    }
+    // partial writes advance the iovecs, work on a copy kept with the stream
+    m_iov.assign(iov, iov + iovcnt);
+
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = m_iov.data();
+    msg.msg_iovlen = iovcnt;
+
+    int64_t deadline = deadlineFor(timeoutMs);
+    m_stats->writeCalls++;
+
+    while (msg.msg_iovlen > 0) {
+        ssize_t stat = ::sendmsg(m_sock, &msg, flags | MSG_NOSIGNAL | MSG_DONTWAIT);
+        if (stat < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                // socket buffer full: the peer is not reading
+                if (waitFor(POLLOUT, deadline) > 0) {
+                    continue;
+                }
+                return -1;
+            }
+            if (isPeerGone(errno)) {
+                markPeerGone();
+            }
+            return stat;
+        }
+        m_stats->bytesWritten += stat;
+        // skip what was sent, the rest goes out with the next sendmsg()
+        while (msg.msg_iovlen > 0 && (size_t)stat >= msg.msg_iov->iov_len) {
+            stat -= msg.msg_iov->iov_len;
+            msg.msg_iov++;
+            msg.msg_iovlen--;
+        }
+        if (msg.msg_iovlen > 0) {
+            msg.msg_iov->iov_base = (char *)msg.msg_iov->iov_base + stat;
+            msg.msg_iov->iov_len -= stat;
+        }
+    }
+    return 0;
+}
+
+const unsigned char *SocketStream::readFully(void *buf, size_t len)
+{
+    return readFully(buf, len, -1);
+}
+
+const unsigned char *SocketStream::readFully(void *buf, size_t len, int timeoutMs)
+{
+    if (!valid()) return NULL;
+    if (!buf) {
+      return NULL;  // do not allow NULL buf in that implementation
+    }
+
+    int64_t deadline = deadlineFor(timeoutMs);
+    int recvs = 0;
+    m_stats->readCalls++;
+
+    size_t res = len;
+    while (res > 0) {
+        ssize_t stat = ::recv(m_sock, (char *)(buf) + len - res, res, MSG_DONTWAIT);
+        if (stat > 0) {
+            m_stats->bytesRead += stat;
+            res -= stat;
+            recvs++;
+            continue;
+        }
+        if (stat == 0) { // client shutdown
+            markPeerGone();
+            return NULL;
+        }
+        if (errno == EINTR) {
+            continue;
+        }
+        if (errno == EAGAIN || errno == EWOULDBLOCK) {
+            if (waitFor(POLLIN, deadline) > 0) {
+                continue;
+            }
+            return NULL;
+        }
+        if (isPeerGone(errno)) {
+            markPeerGone();
+        }
+        return NULL;
+    }
+
+    if (recvs > 1) {
+        m_stats->partialReads++;
+    }
+    return (const unsigned char *)buf;
+}
+
+const unsigned char *SocketStream::read( void *buf, size_t *inout_len)
+{
+    if (!valid()) return NULL;
+    if (!buf) {
+      return NULL;  // do not allow NULL buf in that implementation
+    }
+
+    int n;
+    do {
+        n = this->recv(buf, *inout_len);
+    } while( n < 0 && errno == EINTR );
+
+
+    if (n > 0) {
+        *inout_len = n;
+        return (const unsigned char *)buf;
+    }
+
+    return NULL;
+}
+
+int SocketStream::recv(void *buf, size_t len)
+{
+    if (!valid()) return int(ERR_INVALID_SOCKET);
+    int res = 0;
+
+    while(true) {
+        res = ::recv(m_sock, (char *)buf, len, 0);
+        if (res < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+        }
+        break;
+    }
+    return res;
+}
+
+void SocketStream::forceStop() {
+    // Shutdown socket to force read/write errors.
+#ifdef _WIN32
+    ::shutdown(m_sock, SD_BOTH);
+    // As documented by programmers on MSDN, shutdown implementation in Windows does
+    // NOT result to unblocking threads that are blocked on a recv on the socket
+    // being shut down. The only way to actually implement this behavior (expected
+    // by this forceStop() implementation) is to rudely close the socket.
+    ::closesocket(m_sock);
+    m_sock = -1;
+#else
+    ::shutdown(m_sock, SHUT_RDWR);
+#endif
+}
+
+int SocketStream::check() {
+    int ret;
+    ret = checkRead();
+    if(ret < 0)
+        return ret;
+
+    return checkWrite();
+}
+
+int SocketStream::checkRead() {
+    int ret;
+    char buf;
+
+    ret = ::recv(m_sock, &buf, 0, MSG_DONTWAIT);
+    if(ret < 0) {
+        if((errno == EAGAIN) || (errno == EWOULDBLOCK) || (errno == EINTR)) {
+            return 0;
+        } else {
+            return -errno;
+        }
+    }
+
+    return 0;
+}
+
+int SocketStream::checkWrite() {
+    int ret;
+    char buf;
+
+    ret = ::send(m_sock, &buf, 0, MSG_DONTWAIT | MSG_NOSIGNAL);
+    if(ret < 0) {
+        if((errno == EAGAIN) || (errno == EWOULDBLOCK) || (errno == EINTR)) {
+            return 0;
+        } else {
+            return -errno;
+        }
+    }
+
+    return 0;
+}
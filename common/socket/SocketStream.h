@@ -0,0 +1,110 @@
+/*
+* Copyright (C) 2011 The Android Open Source Project
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+#ifndef __SOCKET_STREAM_H
+#define __SOCKET_STREAM_H
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <sys/uio.h>
+#include <atomic>
+#include <vector>
+#include "IOStream.h"
+
+#define STREAM_BUFFER_SIZE 16384
+
+// Traffic counters of a stream. Readers may sample them from any thread.
+// A worker that re-accepts its peer can keep one instance and attach it to
+// every new stream, so the numbers cover the whole channel.
+struct SocketStreamStats {
+    std::atomic<uint64_t> bytesRead{0};
+    std::atomic<uint64_t> bytesWritten{0};
+    std::atomic<uint64_t> readCalls{0};
+    std::atomic<uint64_t> writeCalls{0};
+    // reads that needed more than one recv() to complete
+    std::atomic<uint64_t> partialReads{0};
+    // time spent waiting in poll() for the peer, in microseconds
+    std::atomic<uint64_t> stallUs{0};
+    std::atomic<uint64_t> timeouts{0};
+    // peer closed or reset the connection
+    std::atomic<uint64_t> peerDeaths{0};
+    // a live stream is attached: set by attachStats(), cleared when the peer
+    // goes away or the stream is destroyed
+    std::atomic<bool> connected{false};
+};
+
+class SocketStream : public IOStream {
+public:
+    typedef enum { ERR_INVALID_SOCKET = -1000 } SocketStreamError;
+    static const size_t MAX_ADDRSTR_LEN = 4096;
+
+    explicit SocketStream(size_t bufsize = 10000);
+    virtual ~SocketStream();
+
+    virtual int listen(const char* addrstr) = 0;
+    virtual SocketStream *accept() = 0;
+    virtual int connect(const char* addr) = 0;
+
+    virtual void *allocBuffer(size_t minSize);
+    virtual int commitBuffer(size_t size);
+    virtual const unsigned char *readFully(void *buf, size_t len);
+    virtual const unsigned char *read(void *buf, size_t *inout_len);
+
+    bool valid() { return m_sock >= 0; }
+    int check();
+    virtual int recv(void *buf, size_t len);
+    virtual int writeFully(const void *buf, size_t len);
+    // Send all iovecs with sendmsg(), continuing after partial writes.
+    // flags are OR'ed into MSG_NOSIGNAL (e.g. MSG_MORE).
+    virtual int writeFullyv(const struct iovec *iov, int iovcnt, int flags = 0);
+
+    // Deadline-aware variants: give up with errno = ETIMEDOUT when the whole
+    // transfer is not done within timeoutMs. A negative timeout waits forever.
+    const unsigned char *readFully(void *buf, size_t len, int timeoutMs);
+    int writeFully(const void *buf, size_t len, int timeoutMs);
+    int writeFullyv(const struct iovec *iov, int iovcnt, int flags, int timeoutMs);
+
+    // false once the peer has closed, reset or hung up the connection
+    bool peerAlive();
+
+    // Count into stats instead of the stream's own counters; stats must
+    // outlive the stream. NULL switches back to the own counters.
+    void attachStats(SocketStreamStats *stats);
+    const SocketStreamStats &stats() const { return *m_stats; }
+
+    virtual void forceStop();
+
+protected:
+    int            m_sock;
+    size_t         m_bufsize;
+    unsigned char *m_buf;
+    SocketStreamStats  m_ownStats;
+    SocketStreamStats *m_stats;
+    // scratch copy of the iovecs being sent by writeFullyv()
+    std::vector<struct iovec> m_iov;
+
+    // Wait until m_sock has events or deadlineUs (CLOCK_MONOTONIC, -1 for
+    // none) passes. Return 1 when ready, 0 on timeout and -1 on error.
+    int waitFor(short events, int64_t deadlineUs);
+    void markPeerGone();
+
+    int checkRead();
+    int checkWrite();
+    SocketStream(int sock, size_t bufSize);
+private:
+    virtual bool setAddr(const char* addr) = 0;
+};
+
+#endif /* __SOCKET_STREAM_H */
@@ -0,0 +1,146 @@
+/*
+ * Copyright (c) KylinSoft Co., Ltd. 2016-2024.All rights reserved.
+ *
+ * Authors:
+ *  Ma Chao    machao@kylinos.cn
+ * 
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "SocketWriter.h"
+
+#include <errno.h>
+#include <limits.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/syslog.h>
+
+#ifndef MSG_MORE
+#define MSG_MORE 0
+#endif
+
+SocketWriter::SocketWriter(size_t capacity) :
+    m_stream(NULL),
+    m_capacity(capacity),
+    m_timeoutMs(-1),
+    m_bufMessages(0),
+    m_sends(0),
+    m_messages(0),
+    m_bytes(0),
+    m_dropped(0)
+{
+    m_buf.reserve(m_capacity);
+}
+
+SocketWriter::~SocketWriter()
+{
+}
+
+void SocketWriter::setStream(SocketStream *stream)
+{
+    if (!m_buf.empty()) {
+        syslog(LOG_WARNING, "SocketWriter: Dropping %zu buffered messages (%zu bytes) on stream switch.",
+               m_bufMessages, m_buf.size());
+        m_dropped += m_bufMessages;
+    }
+    m_stream = stream;
+    m_buf.clear();
+    m_bufMessages = 0;
+}
+
+void SocketWriter::resetStats()
+{
+    m_sends = 0;
+    m_messages = 0;
+    m_bytes = 0;
+}
+
+int SocketWriter::write(const void *buf, size_t len, bool more)
+{
+    struct iovec iov;
+    iov.iov_base = const_cast<void *>(buf);
+    iov.iov_len = len;
+    return writev(&iov, 1, more);
+}
+
+int SocketWriter::writev(const struct iovec *iov, int iovcnt, bool more)
+{
+    if (!m_stream) return -1;
+    if (iovcnt <= 0) return 0;
+
+    size_t total = 0;
+    for (int i = 0; i < iovcnt; i++) {
+        total += iov[i].iov_len;
+    }
+    m_messages++;
+    m_bytes += total;
+
+    // nothing to coalesce with: send straight from the caller's buffers
+    if (m_buf.empty() && !more) {
+        return send(iov, iovcnt, false);
+    }
+
+    if (m_buf.size() + total <= m_capacity) {
+        for (int i = 0; i < iovcnt; i++) {
+            const unsigned char *p = (const unsigned char *)iov[i].iov_base;
+            m_buf.insert(m_buf.end(), p, p + iov[i].iov_len);
+        }
+        m_bufMessages++;
+        if (more && m_buf.size() < m_capacity) {
+            return 0;
+        }
+        return flush();
+    }
+
+    // Too big to copy: the buffered bytes lead the same sendmsg()
+    if (iovcnt + 1 > IOV_MAX) {
+        int ret = flush();
+        return ret < 0 ? ret : send(iov, iovcnt, more);
+    }
+
+    std::vector<struct iovec> vec;
+    vec.reserve(iovcnt + 1);
+    if (!m_buf.empty()) {
+        struct iovec head;
+        head.iov_base = m_buf.data();
+        head.iov_len = m_buf.size();
+        vec.push_back(head);
+    }
+    vec.insert(vec.end(), iov, iov + iovcnt);
+
+    int ret = send(vec.data(), (int)vec.size(), more);
+    m_buf.clear();
+    m_bufMessages = 0;
+    return ret;
+}
+
+int SocketWriter::flush()
+{
+    if (m_buf.empty()) return 0;
+
+    struct iovec iov;
+    iov.iov_base = m_buf.data();
+    iov.iov_len = m_buf.size();
+    int ret = send(&iov, 1, false);
+    m_buf.clear();
+    m_bufMessages = 0;
+    return ret;
+}
+
+int SocketWriter::send(const struct iovec *iov, int iovcnt, bool more)
+{
+    if (!m_stream) return -1;
+
+    m_sends++;
+    return m_stream->writeFullyv(iov, iovcnt, more ? MSG_MORE : 0, m_timeoutMs);
+}
@@ -0,0 +1,86 @@
+/*
+ * Copyright (c) KylinSoft Co., Ltd. 2016-2024.All rights reserved.
+ *
+ * Authors:
+ *  Ma Chao    machao@kylinos.cn
+ * 
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __SOCKET_WRITER_H
+#define __SOCKET_WRITER_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <sys/uio.h>
+#include <vector>
+
+#include "SocketStream.h"
+
+// Write-side buffer for SocketStream. Small messages are copied into one
+// buffer and go out together at the next flush point; a message that does not
+// fit is sent in the same sendmsg() as the buffered bytes, without copying.
+//
+// write(..., more = true) means the caller has more data due soon, so the
+// message may stay buffered until a later write with more = false, flush() or
+// a full buffer. Large sends issued while more is set carry MSG_MORE, which
+// corks TCP; for AF_UNIX the kernel ignores it and the buffer does the work.
+//
+// Not thread safe: callers serialize writes like they did for writeFully().
+class SocketWriter {
+public:
+    explicit SocketWriter(size_t capacity = STREAM_BUFFER_SIZE);
+    ~SocketWriter();
+
+    // Switch to a new stream (e.g. after a reconnect). Pending data belongs
+    // to the old peer and is dropped; it is logged and counted in
+    // droppedCount(). Call flush() first to send it while the old stream works.
+    void setStream(SocketStream *stream);
+    SocketStream *stream() { return m_stream; }
+
+    // Per-send deadline, see SocketStream::writeFullyv(). -1 (default) blocks.
+    void setTimeout(int timeoutMs) { m_timeoutMs = timeoutMs; }
+
+    int write(const void *buf, size_t len, bool more = false);
+    int writev(const struct iovec *iov, int iovcnt, bool more = false);
+    int flush();
+
+    size_t pending() const { return m_buf.size(); }
+
+    // sendmsg() batches issued and messages queued since the last reset
+    uint64_t sendCount() const { return m_sends; }
+    uint64_t messageCount() const { return m_messages; }
+    uint64_t byteCount() const { return m_bytes; }
+    // messages still buffered when the stream was switched
+    uint64_t droppedCount() const { return m_dropped; }
+    void resetStats();
+
+private:
+    int send(const struct iovec *iov, int iovcnt, bool more);
+
+    SocketStream *m_stream;
+    size_t m_capacity;
+    int m_timeoutMs;
+    std::vector<unsigned char> m_buf;
+    // messages held in m_buf
+    size_t m_bufMessages;
+    uint64_t m_sends;
+    uint64_t m_messages;
+    uint64_t m_bytes;
+    uint64_t m_dropped;
+
+    SocketWriter(const SocketWriter&) = delete;
+    void operator=(const SocketWriter&) = delete;
+};
+
+#endif /* __SOCKET_WRITER_H */
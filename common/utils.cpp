@@ -18,6 +18,7 @@
  */
 
 #include "utils.h"
+#include "socket/SocketStream.h"
 
 #include <sys/types.h>
 #include <pwd.h>
@@ -82,4 +83,19 @@ const QString& Utils::getUid()
     
     userId = QString::number(uid);
     return userId;
-}
\ No newline at end of file
+}
+
+QVariantMap Utils::streamStatsToMap(const SocketStreamStats &stats)
+{
+    QVariantMap map;
+    map.insert("connected", (bool)stats.connected);
+    map.insert("bytesRead", (qulonglong)stats.bytesRead);
+    map.insert("bytesWritten", (qulonglong)stats.bytesWritten);
+    map.insert("readCalls", (qulonglong)stats.readCalls);
+    map.insert("writeCalls", (qulonglong)stats.writeCalls);
+    map.insert("partialReads", (qulonglong)stats.partialReads);
+    map.insert("stallUs", (qulonglong)stats.stallUs);
+    map.insert("timeouts", (qulonglong)stats.timeouts);
+    map.insert("peerDeaths", (qulonglong)stats.peerDeaths);
+    return map;
+}
@@ -21,11 +21,16 @@
 #define UTILS_H
 
 #include <QString>
+#include <QVariantMap>
+
+struct SocketStreamStats;
 
 class Utils {
 public:
     static const QString& getUserName();
     static const QString& getUid();
+    /* 将socket统计信息转换为D-Bus可传递的a{sv} */
+    static QVariantMap streamStatsToMap(const SocketStreamStats &stats);
 };
 
 #endif // UTILS_H
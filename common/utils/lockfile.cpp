@@ -0,0 +1,151 @@
+/*
+ * Copyright (c) KylinSoft Co., Ltd. 2016-2024.All rights reserved.
+ *
+ * Authors:
+ *  Ma Chao    machao@kylinos.cn
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "utils/lockfile.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pwd.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/file.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+
+#define BUF_SIZE 1024
+
+static int open_lock_file(const char *path, mode_t mode)
+{
+    int fd;
+    fd = open(path, O_RDWR | O_CLOEXEC | O_CREAT, mode);
+    if (fd < 0) {
+        return fd;
+    }
+
+    return fd;
+}
+
+static int try_lock_file(int fd)
+{
+    int ret = -1;
+    int count = 0;
+
+    for (count = 0; count < 5; count++) {
+        ret = flock(fd, LOCK_EX | LOCK_NB);
+        if (ret == 0) {
+            break;
+        }
+        if ((EBADF == errno) || (EINVAL == errno) || (EWOULDBLOCK == errno)) {
+            break;
+        }
+        sleep(1);
+    }
+
+    return ret;
+}
+
+void unlock_fd(int fd)
+{
+    if (fd < 0) {
+        return;
+    }
+    flock(fd, LOCK_UN);
+    close(fd);
+}
+
+int do_lock_file(const char *path, int *lockFd)
+{
+    int fd;
+    int ret;
+
+    fd = open_lock_file(path, 0666);
+    if (fd < 0) {
+        return -1;
+    }
+
+    ret = try_lock_file(fd);
+    if (ret < 0) {
+        close(fd);
+        return -1;
+    }
+
+    if (lockFd) {
+        *lockFd = fd;
+    }
+
+    return 0;
+}
+
+int lock_daemon_file(const char *name, int *lockFd)
+{
+    char lockFilePath[BUF_SIZE] = {0};
+    char home_path[BUF_SIZE] = {0};
+    char lock_file_dir[BUF_SIZE] = {0};
+    const char *home_dir = NULL;
+
+    if (!name || strlen(name) == 0) {
+        return -1;
+    }
+
+    home_dir = getenv("HOME");
+    if (!home_dir) {
+        struct passwd pwd;
+        struct passwd *result = NULL;
+        char buf[BUF_SIZE] = {0};
+
+        (void)getpwuid_r(getuid(), &pwd, buf, sizeof(buf), &result);
+        if (result && pwd.pw_name) {
+            snprintf(home_path, sizeof(home_path), "/home/%s", pwd.pw_name);
+        } else {
+            snprintf(home_path, sizeof(home_path), "/home/%u", getuid());
+        }
+        home_dir = home_path;
+    }
+
+    snprintf(lock_file_dir, sizeof(lock_file_dir), "%s/.kmre", home_dir);
+    snprintf(lockFilePath, sizeof(lockFilePath), "%s/%s.lock", lock_file_dir, name);
+
+    mkdir(lock_file_dir, 0777);
+    chmod(lock_file_dir, 0777);
+
+    return do_lock_file(lockFilePath, lockFd);
+}
+
+bool test_lockfile(const char *path)
+{
+    int fd;
+    int ret;
+
+    fd = open_lock_file(path, 0644);
+    if (fd < 0) {
+        return false;
+    }
+
+    fchmod(fd, 0644);
+
+    ret = flock(fd, LOCK_EX | LOCK_NB);
+    if (ret < 0) {
+        close(fd);
+        return false;
+    }
+
+    return true;
+}
@@ -0,0 +1,38 @@
+/*
+ * Copyright (c) KylinSoft Co., Ltd. 2016-2024.All rights reserved.
+ *
+ * Authors:
+ *  Ma Chao    machao@kylinos.cn
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef KMRE_LOCKFILE_H
+#define KMRE_LOCKFILE_H
+
+// Single-instance locks shared by the per-user kmre daemons.
+
+// Take an exclusive flock on path, retrying for a few seconds while a previous
+// instance is still exiting. On success return 0 and the held fd in lockFd.
+int do_lock_file(const char* path, int* lockFd);
+
+// Release a lock taken by do_lock_file() or lock_daemon_file().
+void unlock_fd(int fd);
+
+// Lock $HOME/.kmre/<name>.lock, creating the directory if needed.
+int lock_daemon_file(const char* name, int* lockFd);
+
+// One-shot variant used by kylin-kmre-filewatcher: the lock is held until exit.
+bool test_lockfile(const char* path);
+
+#endif // KMRE_LOCKFILE_H
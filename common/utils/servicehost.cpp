@@ -2,7 +2,7 @@
  * Copyright (c) KylinSoft Co., Ltd. 2016-2024.All rights reserved.
  *
  * Authors:
- *  Ma Chao    machao@kylinos.cn
+ *  Kobe Lee    lixiang@kylinos.cn
  *
  * Licensed under the Apache License, Version 2.0 (the "License");
  * you may not use this file except in compliance with the License.
@@ -17,54 +17,46 @@
  * limitations under the License.
  */
 
-#include "lock-file.h"
+#include "utils/servicehost.h"
 
-#include <sys/types.h>
-#include <sys/stat.h>
-#include <stdlib.h>
-#include <string.h>
-#include <sys/file.h>
-#include <error.h>
-#include <stdio.h>
-#include <unistd.h>
+#include <mutex>
 
-static int open_lockfile(const char* path)
-{
-    int fd;
-    fd = open(path, O_RDWR | O_CREAT | O_CLOEXEC, 0644);
-    if (fd < 0) {
-        return fd;
-    }
+namespace kmre {
 
-    fchmod(fd, 0644);
+namespace {
 
-    return fd;
-}
+std::mutex sLock;
+ServiceHost::StopHandler sStopHandler;
 
-static int try_lockfile(int fd)
-{
-    int ret;
+} // namespace
 
-    ret = flock(fd, LOCK_EX | LOCK_NB);
+void ServiceHost::setStopHandler(const StopHandler& handler)
+{
+    std::lock_guard<std::mutex> _l(sLock);
+    sStopHandler = handler;
+}
 
-    return ret;
+bool ServiceHost::isHosted()
+{
+    std::lock_guard<std::mutex> _l(sLock);
+    return (bool)sStopHandler;
 }
 
-bool test_lockfile(const char *path)
+bool ServiceHost::handleStop(const char* service)
 {
-    int fd;
-    int ret;
+    StopHandler handler;
 
-    fd = open_lockfile(path);
-    if (fd < 0) {
-        return false;
+    {
+        std::lock_guard<std::mutex> _l(sLock);
+        handler = sStopHandler;
     }
 
-    ret = try_lockfile(fd);
-    if (ret < 0) {
-        close(fd);
+    if (!handler) {
         return false;
     }
 
+    handler(service ? service : "");
     return true;
 }
+
+} // namespace kmre
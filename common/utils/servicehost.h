@@ -0,0 +1,47 @@
+/*
+ * Copyright (c) KylinSoft Co., Ltd. 2016-2024.All rights reserved.
+ *
+ * Authors:
+ *  Kobe Lee    lixiang@kylinos.cn
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef KMRE_SERVICEHOST_H
+#define KMRE_SERVICEHOST_H
+
+#include <functional>
+#include <string>
+
+namespace kmre {
+
+// Lets the audio/sensor/gps services run either as their own daemon or as
+// modules of kylin-kmre-services. The multi-service host installs a stop
+// handler; a service's stop() then only drops that service, and the host
+// (not every module) watches for the container being stopped.
+class ServiceHost
+{
+public:
+    typedef std::function<void(const std::string& service)> StopHandler;
+
+    static void setStopHandler(const StopHandler& handler);
+    static bool isHosted();
+
+    // Return true if the host took care of stopping service; false means the
+    // caller runs standalone and should exit as before.
+    static bool handleStop(const char* service);
+};
+
+} // namespace kmre
+
+#endif // KMRE_SERVICEHOST_H
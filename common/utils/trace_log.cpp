@@ -0,0 +1,400 @@
+/*
+ * Copyright (c) KylinSoft Co., Ltd. 2016-2024.All rights reserved.
+ *
+ * Authors:
+ *  Yuan ShanShan    yuanshanshan@kylinos.cn
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "utils/trace_log.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+
+namespace kmre {
+
+namespace {
+
+const char kTraceMagic[8] = { 'K', 'M', 'R', 'E', 'T', 'R', 'C', '\0' };
+const uint16_t kTraceVersion = 1;
+const size_t kTraceHeaderSize = 16;
+// Never sleep longer than this in one go so stop() is honoured promptly.
+const int64_t kMaxSleepNs = 50 * 1000 * 1000;
+
+void putU16(unsigned char* p, uint16_t v)
+{
+    p[0] = v & 0xff;
+    p[1] = (v >> 8) & 0xff;
+}
+
+uint16_t getU16(const unsigned char* p)
+{
+    return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+void putVarint(std::vector<unsigned char>& out, uint64_t v)
+{
+    while (v >= 0x80) {
+        out.push_back((unsigned char)(v | 0x80));
+        v >>= 7;
+    }
+    out.push_back((unsigned char)v);
+}
+
+// Return false if the varint runs past end (truncated record).
+bool getVarint(const unsigned char*& p, const unsigned char* end, uint64_t& v)
+{
+    int shift = 0;
+    v = 0;
+    while (p < end && shift < 64) {
+        unsigned char b = *p++;
+        v |= (uint64_t)(b & 0x7f) << shift;
+        if (!(b & 0x80)) {
+            return true;
+        }
+        shift += 7;
+    }
+    return false;
+}
+
+int writeAll(int fd, const void* buf, size_t len)
+{
+    const char* p = (const char*)buf;
+    while (len > 0) {
+        ssize_t n = ::write(fd, p, len);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return -errno;
+        }
+        p += n;
+        len -= n;
+    }
+    return 0;
+}
+
+uint64_t monotonicUs()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+struct timespec timespecAddNs(const struct timespec& ts, int64_t ns)
+{
+    struct timespec r;
+    int64_t total = (int64_t)ts.tv_nsec + ns;
+    r.tv_sec = ts.tv_sec + total / 1000000000;
+    r.tv_nsec = total % 1000000000;
+    if (r.tv_nsec < 0) {
+        r.tv_nsec += 1000000000;
+        r.tv_sec -= 1;
+    }
+    return r;
+}
+
+int64_t timespecDiffNs(const struct timespec& a, const struct timespec& b)
+{
+    return (int64_t)(a.tv_sec - b.tv_sec) * 1000000000 + (a.tv_nsec - b.tv_nsec);
+}
+
+} // namespace
+
+TraceRecorder::TraceRecorder()
+    : mFd(-1),
+      mHasLast(false),
+      mLastUs(0),
+      mCount(0)
+{
+}
+
+TraceRecorder::~TraceRecorder()
+{
+    close();
+}
+
+int TraceRecorder::open(const char* path, uint16_t kind)
+{
+    unsigned char header[kTraceHeaderSize] = {0};
+    int ret;
+
+    if (!path || strlen(path) == 0) {
+        return -EINVAL;
+    }
+
+    std::lock_guard<std::mutex> _l(mLock);
+
+    if (mFd >= 0) {
+        ::close(mFd);
+        mFd = -1;
+    }
+
+    int fd = ::open(path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        return -errno;
+    }
+
+    memcpy(header, kTraceMagic, sizeof(kTraceMagic));
+    putU16(header + 8, kTraceVersion);
+    putU16(header + 10, kind);
+    ret = writeAll(fd, header, sizeof(header));
+    if (ret < 0) {
+        ::close(fd);
+        return ret;
+    }
+
+    mFd = fd;
+    mHasLast = false;
+    mLastUs = 0;
+    mCount = 0;
+
+    return 0;
+}
+
+int TraceRecorder::append(const void* data, size_t len)
+{
+    std::lock_guard<std::mutex> _l(mLock);
+
+    if (mFd < 0) {
+        return -EBADF;
+    }
+
+    uint64_t now = monotonicUs();
+    uint64_t delta = mHasLast ? now - mLastUs : 0;
+
+    // One write() per record keeps a crashed recording readable up to the
+    // last complete sample.
+    mRecord.clear();
+    putVarint(mRecord, delta);
+    putVarint(mRecord, len);
+    mRecord.insert(mRecord.end(), (const unsigned char*)data, (const unsigned char*)data + len);
+
+    int ret = writeAll(mFd, mRecord.data(), mRecord.size());
+    if (ret < 0) {
+        return ret;
+    }
+
+    mHasLast = true;
+    mLastUs = now;
+    mCount++;
+
+    return 0;
+}
+
+void TraceRecorder::close()
+{
+    std::lock_guard<std::mutex> _l(mLock);
+
+    if (mFd >= 0) {
+        ::close(mFd);
+        mFd = -1;
+    }
+}
+
+bool TraceRecorder::isOpen()
+{
+    std::lock_guard<std::mutex> _l(mLock);
+    return mFd >= 0;
+}
+
+uint64_t TraceRecorder::sampleCount()
+{
+    std::lock_guard<std::mutex> _l(mLock);
+    return mCount;
+}
+
+TracePlayer::TracePlayer()
+    : mStop(false),
+      mRunning(false),
+      mWindowUs(0)
+{
+}
+
+TracePlayer::~TracePlayer()
+{
+    stop();
+}
+
+int TracePlayer::load(const char* path, uint16_t kind)
+{
+    struct stat sb;
+    std::vector<char> data;
+    std::vector<Sample> samples;
+
+    if (mRunning) {
+        return -EBUSY;
+    }
+
+    int fd = ::open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return -errno;
+    }
+
+    if (fstat(fd, &sb) != 0) {
+        int err = -errno;
+        ::close(fd);
+        return err;
+    }
+
+    data.resize(sb.st_size);
+    size_t total = 0;
+    while (total < data.size()) {
+        ssize_t n = ::read(fd, data.data() + total, data.size() - total);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            break;
+        }
+        total += n;
+    }
+    ::close(fd);
+    data.resize(total);
+
+    const unsigned char* p = (const unsigned char*)data.data();
+    const unsigned char* end = p + data.size();
+
+    if (data.size() < kTraceHeaderSize ||
+        memcmp(p, kTraceMagic, sizeof(kTraceMagic)) != 0 ||
+        getU16(p + 8) != kTraceVersion ||
+        getU16(p + 10) != kind) {
+        return -EINVAL;
+    }
+    p += kTraceHeaderSize;
+
+    uint64_t offset = 0;
+    while (p < end) {
+        uint64_t delta = 0;
+        uint64_t len = 0;
+        if (!getVarint(p, end, delta) || !getVarint(p, end, len) || len > (uint64_t)(end - p)) {
+            // Truncated tail of an interrupted recording, keep what we have.
+            break;
+        }
+        offset += delta;
+        samples.push_back({ offset, (size_t)(p - (const unsigned char*)data.data()), (size_t)len });
+        p += len;
+    }
+
+    mData.swap(data);
+    mSamples.swap(samples);
+
+    return (int)mSamples.size();
+}
+
+int TracePlayer::start(double speed, bool loop, const SampleHandler& handler)
+{
+    if (mRunning) {
+        return -EBUSY;
+    }
+
+    if (mSamples.empty() || !handler) {
+        return -ENODATA;
+    }
+
+    if (!(speed > 0)) {
+        speed = 1.0;
+    }
+
+    if (mThread.joinable()) {
+        mThread.join();
+    }
+
+    mStop = false;
+    mRunning = true;
+    mThread = std::thread(&TracePlayer::run, this, speed, loop, handler);
+
+    return 0;
+}
+
+void TracePlayer::stop()
+{
+    mStop = true;
+    if (mThread.joinable()) {
+        mThread.join();
+    }
+}
+
+bool TracePlayer::isRunning()
+{
+    return mRunning;
+}
+
+void TracePlayer::setCoalesceWindow(uint32_t windowUs)
+{
+    mWindowUs = windowUs;
+}
+
+bool TracePlayer::sleepUntil(const struct timespec& deadline)
+{
+    struct timespec now;
+
+    while (!mStop) {
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        int64_t remaining = timespecDiffNs(deadline, now);
+        if (remaining <= 0) {
+            return true;
+        }
+
+        // Absolute deadlines: time spent in the handler or in a late wakeup is
+        // never accumulated across samples.
+        struct timespec target = deadline;
+        if (remaining > kMaxSleepNs) {
+            target = timespecAddNs(now, kMaxSleepNs);
+        }
+        clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &target, NULL);
+    }
+
+    return false;
+}
+
+void TracePlayer::run(double speed, bool loop, SampleHandler handler)
+{
+    struct timespec base;
+    clock_gettime(CLOCK_MONOTONIC, &base);
+
+    do {
+        int64_t lastNs = 0;
+        for (size_t i = 0; i < mSamples.size(); i++) {
+            const Sample& sample = mSamples[i];
+            lastNs = (int64_t)(sample.offsetUs * 1000 / speed);
+            if (!sleepUntil(timespecAddNs(base, lastNs))) {
+                goto out;
+            }
+
+            // The last sample of a lap always flushes, even when looping.
+            bool more = false;
+            int64_t windowNs = (int64_t)mWindowUs * 1000;
+            if (windowNs > 0 && i + 1 < mSamples.size()) {
+                int64_t nextNs = (int64_t)(mSamples[i + 1].offsetUs * 1000 / speed);
+                more = nextNs - lastNs < windowNs;
+            }
+            handler(mData.data() + sample.pos, sample.len, more);
+        }
+
+        // Next lap starts where this one ended; at least 1ms apart so a log
+        // without any delays cannot spin.
+        base = timespecAddNs(base, lastNs > 1000000 ? lastNs : 1000000);
+    } while (loop && !mStop);
+
+out:
+    mRunning = false;
+}
+
+} // namespace kmre
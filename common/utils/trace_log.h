@@ -0,0 +1,124 @@
+/*
+ * Copyright (c) KylinSoft Co., Ltd. 2016-2024.All rights reserved.
+ *
+ * Authors:
+ *  Yuan ShanShan    yuanshanshan@kylinos.cn
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef KMRE_TRACE_LOG_H
+#define KMRE_TRACE_LOG_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include <atomic>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Compact binary log of timestamped samples (GPS fixes, sensor readings)
+// used to record real movement once and replay it into the container later.
+//
+// File layout:
+//   header : "KMRETRC\0" | u16 version | u16 kind | u32 reserved   (little endian)
+//   record : varint delta_us | varint length | payload[length]
+//
+// delta_us is the time since the previous record (0 for the first one), so a
+// steady 1 Hz GPS stream costs about 3 bytes of framing per fix.
+
+namespace kmre {
+
+enum TraceKind
+{
+    TRACE_KIND_GPS = 1,
+    TRACE_KIND_SENSOR = 2,
+};
+
+class TraceRecorder
+{
+public:
+    TraceRecorder();
+    ~TraceRecorder();
+
+    // Create (truncate) the log at path. Return 0 on success, -errno on failure.
+    int open(const char* path, uint16_t kind);
+    // Append one sample stamped with the current monotonic time.
+    int append(const void* data, size_t len);
+    void close();
+
+    bool isOpen();
+    uint64_t sampleCount();
+
+private:
+    std::mutex mLock;
+    int mFd;
+    bool mHasLast;
+    uint64_t mLastUs;
+    uint64_t mCount;
+    std::vector<unsigned char> mRecord;
+
+    TraceRecorder(const TraceRecorder&) = delete;
+    void operator=(const TraceRecorder&) = delete;
+};
+
+class TracePlayer
+{
+public:
+    // more is set when the next sample is due within the coalescing window, so
+    // the handler may hold this one back and send both together.
+    typedef std::function<void(const char* data, size_t len, bool more)> SampleHandler;
+
+    TracePlayer();
+    ~TracePlayer();
+
+    // Read and validate a whole log. Return the number of samples, or -errno.
+    int load(const char* path, uint16_t kind);
+    // Stream the loaded samples to handler on a private thread. speed scales the
+    // recorded timing (2.0 replays twice as fast); loop restarts at the end.
+    int start(double speed, bool loop, const SampleHandler& handler);
+    void stop();
+
+    bool isRunning();
+
+    // Samples closer together than windowUs (in replay time) are reported with
+    // more = true. 0, the default, disables coalescing.
+    void setCoalesceWindow(uint32_t windowUs);
+
+private:
+    struct Sample
+    {
+        uint64_t offsetUs;
+        size_t pos;
+        size_t len;
+    };
+
+    void run(double speed, bool loop, SampleHandler handler);
+    bool sleepUntil(const struct timespec& deadline);
+
+    std::vector<char> mData;
+    std::vector<Sample> mSamples;
+    std::thread mThread;
+    std::atomic<bool> mStop;
+    std::atomic<bool> mRunning;
+    std::atomic<uint32_t> mWindowUs;
+
+    TracePlayer(const TracePlayer&) = delete;
+    void operator=(const TracePlayer&) = delete;
+};
+
+} // namespace kmre
+
+#endif // KMRE_TRACE_LOG_H
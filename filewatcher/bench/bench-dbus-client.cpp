@@ -0,0 +1,126 @@
+/*
+ * Copyright (c) KylinSoft Co., Ltd. 2016-2024.All rights reserved.
+ *
+ * Authors:
+ *  Ma Chao    machao@kylinos.cn
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Link time replacement of file-inotify/dbus-client.cpp: same batching,
+// but batches go to the benchmark sink instead of the session bus, and are
+// answered as taken right away.
+
+#include "dbus-client.h"
+#include "bench-sink.h"
+
+namespace kmre {
+
+DBusClient::DBusClient()
+    : mServiceNameOwned(true),
+      mQueryInterface(nullptr),
+      mNotifyInterface(nullptr)
+{
+}
+
+DBusClient::~DBusClient()
+{
+    flush();
+}
+
+void DBusClient::setReplyHandler(const ReplyHandler& handler)
+{
+    mReplyHandler = handler;
+}
+
+bool DBusClient::queryService()
+{
+    return mServiceNameOwned;
+}
+
+static void dropRecords(FileRecordList& records, const QString& path)
+{
+    for (int i = records.size() - 1; i >= 0; i--) {
+        if (records.at(i).path == path) {
+            records.removeAt(i);
+        }
+    }
+}
+
+void DBusClient::notifyFile(QString path, QString mimeType)
+{
+    dropRecords(mPendingRemovals, path);
+
+    if (mPendingRecords.isEmpty() && mPendingRemovals.isEmpty()) {
+        mPendingTimer.start();
+    }
+
+    mPendingRecords.append({ path, mimeType });
+    if (mPendingRecords.size() >= RECORD_BATCH_SIZE) {
+        flush();
+    }
+}
+
+void DBusClient::removeFile(QString path, QString mimeType)
+{
+    dropRecords(mPendingRecords, path);
+    for (const FileRecord& record : mPendingRemovals) {
+        if (record.path == path) {
+            return;
+        }
+    }
+
+    if (mPendingRecords.isEmpty() && mPendingRemovals.isEmpty()) {
+        mPendingTimer.start();
+    }
+
+    mPendingRemovals.append({ path, mimeType });
+    if (mPendingRemovals.size() >= RECORD_BATCH_SIZE) {
+        flush();
+    }
+}
+
+int DBusClient::flushIfDue()
+{
+    if (mPendingRecords.isEmpty() && mPendingRemovals.isEmpty()) {
+        return -1;
+    }
+
+    qint64 elapsed = mPendingTimer.elapsed();
+    if (elapsed < RECORD_BATCH_DELAY_MS) {
+        return (int)(RECORD_BATCH_DELAY_MS - elapsed);
+    }
+
+    flush();
+    return -1;
+}
+
+void DBusClient::flush()
+{
+    if (!mPendingRemovals.isEmpty()) {
+        bench::deliverRemovals(mPendingRemovals);
+        mPendingRemovals.clear();
+    }
+
+    if (mPendingRecords.isEmpty()) {
+        return;
+    }
+
+    bench::deliverRecords(mPendingRecords);
+    if (mReplyHandler) {
+        mReplyHandler(mPendingRecords, QDBusError());
+    }
+    mPendingRecords.clear();
+}
+
+} // namespace kmre
@@ -17,29 +17,20 @@
  * limitations under the License.
  */
 
-#ifndef STORAGECHECKWORKER_H
-#define STORAGECHECKWORKER_H
-
-#include <QObject>
+#ifndef BENCHSINK_H
+#define BENCHSINK_H
 
+#include "dbus-client.h"
 
 namespace kmre {
+namespace bench {
 
-class StorageCheckWorker : public QObject
-{
-    Q_OBJECT
-public:
-    explicit StorageCheckWorker(const QString &path);
-
-signals:
-    void statusChanged(const QString &path);
-
-public slots:
-    void doCheck(const QString &path, bool fuseMounted);
-
-private:
-    QString mPath;
-};
+// Receives every batch the stub DBusClient would have sent to the manager.
+void deliverRecords(const FileRecordList& records);
+// Receives every batch of removals, only counted.
+void deliverRemovals(const FileRecordList& records);
 
+} // namespace bench
 } // namespace kmre
-#endif // STORAGECHECKWORKER_H
+
+#endif // BENCHSINK_H
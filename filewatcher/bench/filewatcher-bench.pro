@@ -0,0 +1,72 @@
+# Copyright (c) KylinSoft Co., Ltd. 2016-2024.All rights reserved.
+#
+# Authors:
+#  Ma Chao    machao@kylinos.cn
+#
+# This program is free software; you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation; version 3.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+# Replays synthetic workloads against FileInotifyService, see main.cpp, and
+# times single watcher parts, see micro-bench.cpp.
+# Built with qmake CONFIG+=kmre_bench from the top level, never installed.
+
+TARGET = kylin-kmre-filewatcher-bench
+TEMPLATE = app
+
+QT -= gui
+QT += dbus core
+
+CONFIG += c++11
+CONFIG -= app_bundle
+
+INCLUDEPATH += ../file-inotify
+
+DEFINES += QT_DEPRECATED_WARNINGS
+
+# bench-dbus-client.cpp stands in for file-inotify/dbus-client.cpp
+SOURCES += main.cpp \
+    bench-dbus-client.cpp \
+    micro-bench.cpp \
+    ../file-inotify/directory-scanner.cpp \
+    ../file-inotify/file-fanotify-watcher.cpp \
+    ../file-inotify/file-inotify-service.cpp \
+    ../file-inotify/file-inotify-watcher.cpp \
+    ../file-inotify/media-index.cpp \
+    ../file-inotify/media-sniffer.cpp \
+    ../file-inotify/path-filter.cpp \
+    ../file-inotify/utils.cpp \
+    ../file-inotify/watch-budget.cpp \
+    ../file-inotify/watch-engine.cpp \
+    ../file-inotify/watch-index.cpp
+
+HEADERS += \
+    bench-sink.h \
+    micro-bench.h \
+    ../file-inotify/dbus-client.h \
+    ../file-inotify/directory-scanner.h \
+    ../file-inotify/file-fanotify-watcher.h \
+    ../file-inotify/file-inotify-service.h \
+    ../file-inotify/file-inotify-watcher.h \
+    ../file-inotify/media-index.h \
+    ../file-inotify/media-sniffer.h \
+    ../file-inotify/mpsc-queue.h \
+    ../file-inotify/path-filter.h \
+    ../file-inotify/timer-wheel.h \
+    ../file-inotify/utils.h \
+    ../file-inotify/watch-budget.h \
+    ../file-inotify/watch-engine.h \
+    ../file-inotify/watch-index.h
+
+unix {
+    MOC_DIR = .moc
+    OBJECTS_DIR = .obj
+}
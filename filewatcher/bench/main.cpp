@@ -0,0 +1,840 @@
+/*
+ * Copyright (c) KylinSoft Co., Ltd. 2016-2024.All rights reserved.
+ *
+ * Authors:
+ *  Ma Chao    machao@kylinos.cn
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Replays scripted file-system workloads against FileInotifyService in a
+// throwaway home directory and reports how the notifications came out:
+// end-to-end latency from the close (or rename) of a media file to the
+// delivery of its record batch, files never reported, files reported more
+// than once, records nobody asked for, reported files that went away
+// without a removal, and the CPU time and RSS of the watcher while the
+// workload ran.
+//
+// usage: kylin-kmre-filewatcher-bench [-s scale] [-w workload,...] [-k]
+//        kylin-kmre-filewatcher-bench -m scan [-f files] [-k]
+//        kylin-kmre-filewatcher-bench -m events [-f files]
+//
+// -m runs a micro benchmark of one watcher part instead, see micro-bench.h.
+//
+// The files are written by a child process forked before any thread
+// exists, so the CPU figures only count the watcher.
+
+#include <QCoreApplication>
+#include <QDir>
+#include <QHash>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QSet>
+#include <QStandardPaths>
+#include <QStringList>
+#include <QVector>
+
+#include <algorithm>
+#include <iterator>
+#include <string>
+#include <vector>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <ftw.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+
+#include "bench-sink.h"
+#include "file-inotify-service.h"
+#include "micro-bench.h"
+
+#define BENCH_HOME_ENV      "KMRE_BENCH_HOME"
+#define QUIET_TIMEOUT_MS    3000
+#define DUPLICATE_WAIT_MS   600
+#define POLL_INTERVAL_MS    20
+
+namespace {
+
+const char* const kWorkloads[] = {
+    "camera-import", "git-clone", "move-in", "mass-delete", "large-writes", "deep-tree",
+    "replace-in-place", "recreate-dir", "move-out",
+};
+
+const unsigned char kJpegMagic[] = { 0xff, 0xd8, 0xff, 0xe0, 0x00, 0x10, 'J', 'F', 'I', 'F', 0x00 };
+const unsigned char kPngMagic[] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n' };
+const unsigned char kMp4Magic[] = { 0x00, 0x00, 0x00, 0x18, 'f', 't', 'y', 'p', 'm', 'p', '4', '2' };
+
+QMutex sinkLock;
+QHash<QString, QVector<qint64>> sinkRecords;
+qint64 sinkLastNs = 0;
+int sinkRemoved = 0;
+// path -> time its latest removal was delivered
+QHash<QString, qint64> sinkRemovedAt;
+QString sinkHome;
+
+qint64 nowNs()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (qint64)ts.tv_sec * 1000000000ll + ts.tv_nsec;
+}
+
+bool writeAll(int fd, const char* data, size_t len)
+{
+    while (len > 0) {
+        ssize_t n = write(fd, data, len);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+        data += n;
+        len -= n;
+    }
+    return true;
+}
+
+bool readLine(int fd, std::string& line)
+{
+    char c;
+
+    line.clear();
+    while (true) {
+        ssize_t n = read(fd, &c, 1);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            return false;
+        }
+        if (c == '\n') {
+            return true;
+        }
+        line += c;
+    }
+}
+
+int removeEntry(const char* path, const struct stat*, int, struct FTW*)
+{
+    return remove(path);
+}
+
+void removeTree(const std::string& path)
+{
+    nftw(path.c_str(), removeEntry, 64, FTW_DEPTH | FTW_PHYS);
+}
+
+void makePath(const std::string& path)
+{
+    for (size_t pos = path.find('/', 1); ; pos = path.find('/', pos + 1)) {
+        mkdir(path.substr(0, pos).c_str(), 0755);
+        if (pos == std::string::npos) {
+            break;
+        }
+    }
+}
+
+// Runs in the forked child: performs one workload per command read from
+// cmdFd and reports every media file it completed as "<ns> <path>", and
+// every reported file it took away as "R <ns> <path>".
+class Generator
+{
+public:
+    Generator(const std::string& home, int scale, int reportFd)
+        : mHome(home),
+          mScale(scale),
+          mReportFd(reportFd),
+          mChunk(1 << 20, '\0')
+    {
+    }
+
+    void run(const std::string& workload)
+    {
+        if (workload == "camera-import") {
+            cameraImport();
+        } else if (workload == "git-clone") {
+            gitClone();
+        } else if (workload == "move-in") {
+            moveIn();
+        } else if (workload == "mass-delete") {
+            massDelete();
+        } else if (workload == "large-writes") {
+            largeWrites();
+        } else if (workload == "deep-tree") {
+            deepTree();
+        } else if (workload == "replace-in-place") {
+            replaceInPlace();
+        } else if (workload == "recreate-dir") {
+            recreateDir();
+        } else if (workload == "move-out") {
+            moveOut();
+        }
+        writeAll(mReportFd, "D\n", 2);
+    }
+
+private:
+    void report(const std::string& path, qint64 ns)
+    {
+        char prefix[32];
+        int len = snprintf(prefix, sizeof(prefix), "%lld ", (long long)ns);
+        writeAll(mReportFd, prefix, len);
+        writeAll(mReportFd, path.c_str(), path.size());
+        writeAll(mReportFd, "\n", 1);
+    }
+
+    void reportRemoval(const std::string& path, qint64 ns)
+    {
+        writeAll(mReportFd, "R ", 2);
+        report(path, ns);
+    }
+
+    // returns the close time, 0 on failure
+    qint64 writeFile(const std::string& path, const unsigned char* magic, size_t magicLen,
+                     size_t size, size_t chunk, int pauseUs)
+    {
+        int fd = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+        if (fd < 0) {
+            return 0;
+        }
+
+        bool ok = writeAll(fd, (const char*)magic, magicLen);
+        for (size_t done = magicLen; ok && done < size; done += chunk) {
+            ok = writeAll(fd, mChunk.data(), std::min(chunk, size - done));
+            if (pauseUs > 0) {
+                usleep(pauseUs);
+            }
+        }
+        close(fd);
+
+        return ok ? nowNs() : 0;
+    }
+
+    // a burst of photos copied into a new folder
+    void cameraImport()
+    {
+        const std::string dir = mHome + "/Pictures/import";
+        char name[64];
+
+        mkdir(dir.c_str(), 0755);
+        for (int i = 0; i < 500 * mScale; i++) {
+            snprintf(name, sizeof(name), "/IMG_%05d.jpg", i);
+            qint64 ns = writeFile(dir + name, kJpegMagic, sizeof(kJpegMagic), 256 << 10, 64 << 10, 0);
+            if (ns) {
+                report(dir + name, ns);
+            }
+        }
+    }
+
+    // many new directories full of source files with a few images
+    void gitClone()
+    {
+        const std::string root = mHome + "/Documents/project";
+        const std::string source(4096, 'x');
+        char name[64];
+
+        for (int d = 0; d < 200 * mScale; d++) {
+            std::string dir = root;
+            for (int level = 0; level <= d % 6; level++) {
+                snprintf(name, sizeof(name), "/m%d", (d + level) % 17);
+                dir += name;
+            }
+            snprintf(name, sizeof(name), "/pkg%d", d);
+            dir += name;
+            makePath(dir);
+
+            for (int f = 0; f < 20; f++) {
+                snprintf(name, sizeof(name), "/src_%d.c", f);
+                int fd = open((dir + name).c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+                if (fd >= 0) {
+                    writeAll(fd, source.data(), source.size());
+                    close(fd);
+                }
+            }
+
+            qint64 ns = writeFile(dir + "/figure.png", kPngMagic, sizeof(kPngMagic), 16 << 10, 16 << 10, 0);
+            if (ns) {
+                report(dir + "/figure.png", ns);
+            }
+        }
+    }
+
+    // clips written elsewhere, then renamed into Videos
+    void moveIn()
+    {
+        const std::string staging = mHome + "/.staging";
+        char name[64];
+
+        mkdir(staging.c_str(), 0755);
+        for (int i = 0; i < 300 * mScale; i++) {
+            snprintf(name, sizeof(name), "/clip_%05d.mp4", i);
+            if (writeFile(staging + name, kMp4Magic, sizeof(kMp4Magic), 64 << 10, 64 << 10, 0) == 0) {
+                continue;
+            }
+            const std::string dest = mHome + "/Videos" + name;
+            if (rename((staging + name).c_str(), dest.c_str()) == 0) {
+                report(dest, nowNs());
+            }
+        }
+        rmdir(staging.c_str());
+    }
+
+    // nothing may be reported while the earlier workloads are removed
+    void massDelete()
+    {
+        removeTree(mHome + "/Pictures/import");
+        removeTree(mHome + "/Documents/project");
+    }
+
+    // big videos written slowly, reported once closed
+    void largeWrites()
+    {
+        char name[64];
+
+        for (int i = 0; i < 4 * mScale; i++) {
+            snprintf(name, sizeof(name), "/big_%d.mp4", i);
+            const std::string path = mHome + "/Videos" + name;
+            qint64 ns = writeFile(path, kMp4Magic, sizeof(kMp4Magic), 64 << 20, 1 << 20, 2000);
+            if (ns) {
+                report(path, ns);
+            }
+        }
+    }
+
+    // an image at the bottom of freshly created 64 level trees
+    void deepTree()
+    {
+        char name[64];
+
+        for (int b = 0; b < 20 * mScale; b++) {
+            snprintf(name, sizeof(name), "/Downloads/deep_%d", b);
+            std::string dir = mHome + name;
+            for (int level = 0; level < 64; level++) {
+                snprintf(name, sizeof(name), "/d%d", level);
+                dir += name;
+            }
+            makePath(dir);
+
+            qint64 ns = writeFile(dir + "/photo.jpg", kJpegMagic, sizeof(kJpegMagic), 32 << 10, 32 << 10, 0);
+            if (ns) {
+                report(dir + "/photo.jpg", ns);
+            }
+        }
+    }
+
+    // saved the way editors and cameras do: unlink, then write the same
+    // name again, both in one inotify read
+    void replaceInPlace()
+    {
+        const std::string dir = mHome + "/Pictures/edit";
+        char name[64];
+
+        mkdir(dir.c_str(), 0755);
+        for (int i = 0; i < 100 * mScale; i++) {
+            snprintf(name, sizeof(name), "/edit_%04d.jpg", i);
+            writeFile(dir + name, kJpegMagic, sizeof(kJpegMagic), 16 << 10, 16 << 10, 0);
+        }
+        // let the first versions be reported
+        usleep(2000 * 1000);
+
+        for (int i = 0; i < 100 * mScale; i++) {
+            snprintf(name, sizeof(name), "/edit_%04d.jpg", i);
+            unlink((dir + name).c_str());
+            qint64 ns = writeFile(dir + name, kJpegMagic, sizeof(kJpegMagic), 16 << 10, 16 << 10, 0);
+            if (ns) {
+                report(dir + name, ns);
+            }
+        }
+    }
+
+    // watched folders deleted and made again under the same name, the new
+    // one usually before the IN_IGNORED of the old watch is handled
+    void recreateDir()
+    {
+        const std::string root = mHome + "/Pictures/recreate";
+        char name[64];
+
+        mkdir(root.c_str(), 0755);
+        for (int i = 0; i < 20 * mScale; i++) {
+            snprintf(name, sizeof(name), "/album_%d", i);
+            mkdir((root + name).c_str(), 0755);
+            writeFile(root + name + "/old.jpg", kJpegMagic, sizeof(kJpegMagic), 16 << 10, 16 << 10, 0);
+        }
+        // let the first folders be watched
+        usleep(1000 * 1000);
+
+        for (int i = 0; i < 20 * mScale; i++) {
+            snprintf(name, sizeof(name), "/album_%d", i);
+            const std::string dir = root + name;
+            removeTree(dir);
+            mkdir(dir.c_str(), 0755);
+        }
+        // files written into the new folders only show up through their watches
+        usleep(500 * 1000);
+        for (int i = 0; i < 20 * mScale; i++) {
+            snprintf(name, sizeof(name), "/album_%d/new.jpg", i);
+            qint64 ns = writeFile(root + name, kJpegMagic, sizeof(kJpegMagic), 16 << 10, 16 << 10, 0);
+            if (ns) {
+                report(root + name, ns);
+            }
+        }
+    }
+
+    // albums moved out of the watched folders, Android must drop their files
+    void moveOut()
+    {
+        const std::string outside = mHome + "/.outside";
+        char name[64];
+
+        mkdir(outside.c_str(), 0755);
+        for (int a = 0; a < 5 * mScale; a++) {
+            snprintf(name, sizeof(name), "/Pictures/album_%d/trip", a);
+            makePath(mHome + name);
+            for (int i = 0; i < 20; i++) {
+                snprintf(name, sizeof(name), "/Pictures/album_%d/%s%d.jpg", a, i % 2 ? "trip/" : "", i);
+                writeFile(mHome + name, kJpegMagic, sizeof(kJpegMagic), 16 << 10, 16 << 10, 0);
+            }
+        }
+        // let the files be reported
+        usleep(2000 * 1000);
+
+        for (int a = 0; a < 5 * mScale; a++) {
+            snprintf(name, sizeof(name), "/album_%d", a);
+            if (rename((mHome + "/Pictures" + name).c_str(), (outside + name).c_str()) != 0) {
+                continue;
+            }
+            const qint64 ns = nowNs();
+            for (int i = 0; i < 20; i++) {
+                snprintf(name, sizeof(name), "/Pictures/album_%d/%s%d.jpg", a, i % 2 ? "trip/" : "", i);
+                reportRemoval(mHome + name, ns);
+            }
+        }
+    }
+
+    std::string mHome;
+    int mScale;
+    int mReportFd;
+    std::vector<char> mChunk;
+};
+
+void runGenerator(const std::string& home, int scale, int cmdFd, int reportFd)
+{
+    Generator generator(home, scale, reportFd);
+    std::string command;
+
+    while (readLine(cmdFd, command) && command != "Q") {
+        generator.run(command);
+    }
+    _exit(0);
+}
+
+struct Result
+{
+    int files;
+    int received;
+    int dropped;
+    int duplicates;
+    int unexpected;
+    int removed;
+    // taken away but never removed
+    int stale;
+    double p50;
+    double p90;
+    double p99;
+    double max;
+    double cpuMs;
+    long rssKb;
+    long peakRssKb;
+};
+
+double cpuMs()
+{
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return (usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) * 1000.0 +
+           (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1000.0;
+}
+
+void readRss(long& rssKb, long& peakRssKb)
+{
+    char line[256];
+    FILE* fp = fopen("/proc/self/status", "r");
+
+    rssKb = peakRssKb = 0;
+    if (!fp) {
+        return;
+    }
+    while (fgets(line, sizeof(line), fp)) {
+        sscanf(line, "VmRSS: %ld", &rssKb);
+        sscanf(line, "VmHWM: %ld", &peakRssKb);
+    }
+    fclose(fp);
+}
+
+double percentile(const std::vector<double>& sorted, double p)
+{
+    if (sorted.empty()) {
+        return 0;
+    }
+    size_t index = (size_t)(p * (sorted.size() - 1) + 0.5);
+    return sorted[std::min(index, sorted.size() - 1)];
+}
+
+// Records delivered for path since the file was written at ns, or 0 when a
+// removal came after the last of them. Called with sinkLock held.
+int countRecords(const QString& path, qint64 ns, qint64* first = nullptr)
+{
+    auto received = sinkRecords.constFind(path);
+    if (received == sinkRecords.constEnd() ||
+        sinkRemovedAt.value(path, 0) > received.value().last()) {
+        return 0;
+    }
+
+    int count = 0;
+    for (qint64 at : received.value()) {
+        if (at >= ns) {
+            if (count++ == 0 && first) {
+                *first = at;
+            }
+        }
+    }
+    return count;
+}
+
+Result runWorkload(const char* workload, int cmdFd, int reportFd)
+{
+    Result result = {};
+    QHash<QString, qint64> expected;
+    QHash<QString, qint64> expectedRemovals;
+    std::string line;
+
+    {
+        QMutexLocker _l(&sinkLock);
+        sinkRecords.clear();
+        sinkRemoved = 0;
+        sinkRemovedAt.clear();
+    }
+
+    const double cpuStart = cpuMs();
+    writeAll(cmdFd, workload, strlen(workload));
+    writeAll(cmdFd, "\n", 1);
+    while (readLine(reportFd, line) && line != "D") {
+        const bool removal = line.compare(0, 2, "R ") == 0;
+        if (removal) {
+            line.erase(0, 2);
+        }
+        size_t space = line.find(' ');
+        if (space != std::string::npos) {
+            (removal ? expectedRemovals : expected).insert(QString::fromStdString(line.substr(space + 1)),
+                                                           strtoll(line.c_str(), nullptr, 10));
+        }
+    }
+
+    // until every file came in, or nothing arrived for a while
+    const qint64 generatedNs = nowNs();
+    qint64 doneNs = 0;
+    while (true) {
+        int missing = 0;
+        qint64 lastNs;
+        {
+            QMutexLocker _l(&sinkLock);
+            for (auto it = expected.constBegin(); it != expected.constEnd(); ++it) {
+                if (countRecords(it.key(), it.value()) == 0) {
+                    missing++;
+                }
+            }
+            for (auto it = expectedRemovals.constBegin(); it != expectedRemovals.constEnd(); ++it) {
+                if (sinkRemovedAt.value(it.key(), 0) < it.value()) {
+                    missing++;
+                }
+            }
+            lastNs = sinkLastNs;
+        }
+
+        const qint64 now = nowNs();
+        if (missing == 0 && doneNs == 0) {
+            doneNs = now;
+        }
+        if (doneNs != 0 && now - doneNs >= DUPLICATE_WAIT_MS * 1000000ll) {
+            break;
+        }
+        if (doneNs == 0 && now - std::max(lastNs, generatedNs) >= QUIET_TIMEOUT_MS * 1000000ll) {
+            break;
+        }
+        usleep(POLL_INTERVAL_MS * 1000);
+    }
+    result.cpuMs = cpuMs() - cpuStart;
+    readRss(result.rssKb, result.peakRssKb);
+
+    std::vector<double> latencies;
+    QMutexLocker _l(&sinkLock);
+    result.files = expected.size();
+    result.removed = sinkRemoved;
+    for (auto it = expected.constBegin(); it != expected.constEnd(); ++it) {
+        qint64 first = 0;
+        const int count = countRecords(it.key(), it.value(), &first);
+        if (count == 0) {
+            result.dropped++;
+            continue;
+        }
+        result.received++;
+        result.duplicates += count - 1;
+        latencies.push_back((first - it.value()) / 1e6);
+    }
+    for (auto it = sinkRecords.constBegin(); it != sinkRecords.constEnd(); ++it) {
+        if (!expected.contains(it.key())) {
+            result.unexpected += it.value().size();
+        }
+    }
+    for (auto it = expectedRemovals.constBegin(); it != expectedRemovals.constEnd(); ++it) {
+        if (sinkRemovedAt.value(it.key(), 0) < it.value()) {
+            result.stale++;
+        }
+    }
+
+    std::sort(latencies.begin(), latencies.end());
+    result.p50 = percentile(latencies, 0.50);
+    result.p90 = percentile(latencies, 0.90);
+    result.p99 = percentile(latencies, 0.99);
+    result.max = latencies.empty() ? 0 : latencies.back();
+
+    return result;
+}
+
+// FileInotifyService reads $HOME while static objects are built, so the
+// temporary home has to be in place before the process starts.
+void reexecWithHome(char** argv)
+{
+    char tmpl[] = "/tmp/kmre-filewatcher-bench-XXXXXX";
+
+    if (!mkdtemp(tmpl)) {
+        perror("mkdtemp");
+        exit(1);
+    }
+    setenv("HOME", tmpl, 1);
+    setenv(BENCH_HOME_ENV, tmpl, 1);
+    // user-dirs.dirs of the real session must not relocate the folders
+    unsetenv("XDG_CONFIG_HOME");
+    unsetenv("XDG_DATA_HOME");
+    unsetenv("XDG_CACHE_HOME");
+
+    execv("/proc/self/exe", argv);
+    perror("execv");
+    exit(1);
+}
+
+void usage(const char* name)
+{
+    fprintf(stderr, "usage: %s [-s scale] [-w workload,...] [-k]\n", name);
+    fprintf(stderr, "       %s -m scan [-f files] [-k]\n", name);
+    fprintf(stderr, "       %s -m events [-f files]\n", name);
+    fprintf(stderr, "workloads:");
+    for (const char* workload : kWorkloads) {
+        fprintf(stderr, " %s", workload);
+    }
+    fprintf(stderr, "\n");
+}
+
+} // namespace
+
+namespace kmre {
+namespace bench {
+
+void deliverRecords(const FileRecordList& records)
+{
+    static const QString androidPrefix = "/storage/emulated/0/0-麒麟文件/";
+    const qint64 now = nowNs();
+
+    QMutexLocker _l(&sinkLock);
+    for (const FileRecord& record : records) {
+        QString path = record.path;
+        if (path.startsWith(androidPrefix)) {
+            path.replace(0, androidPrefix.length(), sinkHome);
+        }
+        sinkRecords[path].append(now);
+    }
+    sinkLastNs = now;
+}
+
+void deliverRemovals(const FileRecordList& records)
+{
+    static const QString androidPrefix = "/storage/emulated/0/0-麒麟文件/";
+    const qint64 now = nowNs();
+
+    QMutexLocker _l(&sinkLock);
+    sinkRemoved += records.size();
+    for (const FileRecord& record : records) {
+        QString path = record.path;
+        if (path.startsWith(androidPrefix)) {
+            path.replace(0, androidPrefix.length(), sinkHome);
+        }
+        sinkRemovedAt[path] = now;
+    }
+}
+
+} // namespace bench
+} // namespace kmre
+
+int main(int argc, char** argv)
+{
+    QStringList workloads;
+    bool keep = false;
+    int scale = 1;
+    const char* micro = nullptr;
+    // -f, 0 leaves each micro benchmark its own default
+    int files = 0;
+    int opt;
+
+    for (const char* workload : kWorkloads) {
+        workloads << workload;
+    }
+
+    while ((opt = getopt(argc, argv, "s:w:m:f:kh")) != -1) {
+        switch (opt) {
+        case 's':
+            scale = std::max(1, atoi(optarg));
+            break;
+        case 'w':
+            workloads = QString(optarg).split(',', QString::SkipEmptyParts);
+            break;
+        case 'm':
+            micro = optarg;
+            break;
+        case 'f':
+            files = std::max(1, atoi(optarg));
+            break;
+        case 'k':
+            keep = true;
+            break;
+        default:
+            usage(argv[0]);
+            return opt == 'h' ? 0 : 1;
+        }
+    }
+
+    if (micro) {
+        if (strcmp(micro, "scan") == 0) {
+            return kmre::bench::runScanBench(files > 0 ? files : 1000000, keep);
+        }
+        if (strcmp(micro, "events") == 0) {
+            return kmre::bench::runEventBench(files > 0 ? files : 100000);
+        }
+        usage(argv[0]);
+        return 1;
+    }
+
+    if (!getenv(BENCH_HOME_ENV)) {
+        reexecWithHome(argv);
+    }
+
+    const std::string home = getenv(BENCH_HOME_ENV);
+    for (const char* dir : { "Desktop", "Documents", "Downloads", "Music", "Pictures", "Videos" }) {
+        mkdir((home + "/" + dir).c_str(), 0755);
+    }
+
+    int cmdPipe[2];
+    int reportPipe[2];
+    if (pipe(cmdPipe) != 0 || pipe(reportPipe) != 0) {
+        perror("pipe");
+        return 1;
+    }
+
+    pid_t child = fork();
+    if (child < 0) {
+        perror("fork");
+        return 1;
+    }
+    if (child == 0) {
+        close(cmdPipe[1]);
+        close(reportPipe[0]);
+        runGenerator(home, scale, cmdPipe[0], reportPipe[1]);
+    }
+    close(cmdPipe[0]);
+    close(reportPipe[1]);
+
+    QCoreApplication app(argc, argv);
+    sinkHome = QString::fromStdString(home);
+
+    const double startCpu = cpuMs();
+    const qint64 startNs = nowNs();
+    kmre::FileInotifyService* service = kmre::FileInotifyService::getInstance();
+    if (service->initialize() < 0) {
+        fprintf(stderr, "Failed to initialize the watcher.\n");
+        return 1;
+    }
+    service->addWatchRecursively(QStandardPaths::writableLocation(QStandardPaths::DocumentsLocation));
+    service->addWatchRecursively(QStandardPaths::writableLocation(QStandardPaths::DownloadLocation));
+    service->addWatchRecursively(QStandardPaths::writableLocation(QStandardPaths::PicturesLocation));
+    service->addWatchRecursively(QStandardPaths::writableLocation(QStandardPaths::MoviesLocation));
+    service->addWatchRecursively(QStandardPaths::writableLocation(QStandardPaths::MusicLocation));
+    service->addWatchRecursively(QStandardPaths::writableLocation(QStandardPaths::DesktopLocation));
+    service->start();
+
+    long rssKb = 0;
+    long peakRssKb = 0;
+    readRss(rssKb, peakRssKb);
+    printf("home %s, scale %d, startup %.1f ms, %.1f ms cpu, rss %ld KB\n\n", home.c_str(), scale,
+           (nowNs() - startNs) / 1e6, cpuMs() - startCpu, rssKb);
+    printf("%-14s %6s %6s %5s %4s %5s %5s %5s %8s %8s %8s %8s %8s %8s %8s\n", "workload", "files", "recv",
+           "drop", "dup", "extra", "rm", "stale", "p50 ms", "p90 ms", "p99 ms", "max ms", "cpu ms", "rss KB",
+           "peak KB");
+
+    int failed = 0;
+    for (const QString& workload : workloads) {
+        const QByteArray name = workload.toLocal8Bit();
+        if (std::find_if(std::begin(kWorkloads), std::end(kWorkloads), [&name](const char* known) {
+                return name == known;
+            }) == std::end(kWorkloads)) {
+            fprintf(stderr, "unknown workload %s\n", name.constData());
+            continue;
+        }
+
+        const Result r = runWorkload(name.constData(), cmdPipe[1], reportPipe[0]);
+        printf("%-14s %6d %6d %5d %4d %5d %5d %5d %8.1f %8.1f %8.1f %8.1f %8.1f %8ld %8ld\n", name.constData(),
+               r.files, r.received, r.dropped, r.duplicates, r.unexpected, r.removed, r.stale, r.p50, r.p90, r.p99,
+               r.max, r.cpuMs, r.rssKb, r.peakRssKb);
+        fflush(stdout);
+        // files saved in place must end up with a record
+        if (workload == "replace-in-place" && r.dropped > 0) {
+            fprintf(stderr, "FAIL: %d of %d files replaced in place lost their record\n", r.dropped, r.files);
+            failed++;
+        }
+        // a folder made again must be watched again
+        if (workload == "recreate-dir" && r.dropped > 0) {
+            fprintf(stderr, "FAIL: %d of %d files in recreated folders were not reported\n", r.dropped, r.files);
+            failed++;
+        }
+        // every file of a folder moved out must be withdrawn
+        if (r.stale > 0) {
+            fprintf(stderr, "FAIL: %d files moved out of the watched folders kept their record\n", r.stale);
+            failed++;
+        }
+    }
+
+    writeAll(cmdPipe[1], "Q\n", 2);
+    waitpid(child, nullptr, 0);
+
+    if (!keep) {
+        removeTree(home);
+    }
+
+    return failed > 0 ? 1 : 0;
+}
@@ -0,0 +1,364 @@
+/*
+ * Copyright (c) KylinSoft Co., Ltd. 2016-2024.All rights reserved.
+ *
+ * Authors:
+ *  Ma Chao    machao@kylinos.cn
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Micro benchmarks of single watcher parts, without the service around
+// them. They reproduce the figures quoted when the parts were rewritten.
+
+#include "micro-bench.h"
+
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <QMultiMap>
+#include <QString>
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <ftw.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+
+#include "directory-scanner.h"
+#include "file-inotify-watcher.h"
+#include "utils.h"
+
+#define SCAN_LEAF_DIRS 1000
+#define EVENT_DIRS 1000
+
+namespace kmre {
+namespace bench {
+
+namespace {
+
+int64_t monotonicNs()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000000ll + ts.tv_nsec;
+}
+
+int removeEntry(const char* path, const struct stat* sb, int type, struct FTW* ftw)
+{
+    (void)sb;
+    (void)type;
+    (void)ftw;
+    remove(path);
+    return 0;
+}
+
+void removeTree(const std::string& path)
+{
+    nftw(path.c_str(), removeEntry, 64, FTW_DEPTH | FTW_PHYS);
+}
+
+// 10 x 10 x 10 directories below root, the files spread over the leaves
+bool makeTree(const std::string& root, int files)
+{
+    char name[PATH_MAX];
+    const int perLeaf = (files + SCAN_LEAF_DIRS - 1) / SCAN_LEAF_DIRS;
+    int made = 0;
+
+    for (int leaf = 0; leaf < SCAN_LEAF_DIRS && made < files; leaf++) {
+        snprintf(name, sizeof(name), "%s/d%d", root.c_str(), leaf / 100);
+        mkdir(name, 0755);
+        snprintf(name, sizeof(name), "%s/d%d/d%d", root.c_str(), leaf / 100, leaf / 10 % 10);
+        mkdir(name, 0755);
+        snprintf(name, sizeof(name), "%s/d%d/d%d/d%d", root.c_str(), leaf / 100, leaf / 10 % 10, leaf % 10);
+        if (mkdir(name, 0755) != 0) {
+            return false;
+        }
+
+        int dirFd = open(name, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+        if (dirFd < 0) {
+            return false;
+        }
+        for (int i = 0; i < perLeaf && made < files; i++, made++) {
+            char file[32];
+            snprintf(file, sizeof(file), "IMG_%06d.jpg", i);
+            int fd = openat(dirFd, file, O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, 0644);
+            if (fd < 0) {
+                close(dirFd);
+                return false;
+            }
+            close(fd);
+        }
+        close(dirFd);
+    }
+
+    return true;
+}
+
+// The walk DirectoryScanner replaced: recursive, realpath() and snprintf()
+// per entry, then a stat() to tell directories from files.
+void legacyWalk(const char* path, uint64_t& dirs, uint64_t& files)
+{
+    char resolvedPath[PATH_MAX] = {0};
+    char entryPath[PATH_MAX];
+
+    if (!realpath(path, resolvedPath)) {
+        return;
+    }
+
+    DIR* d = opendir(resolvedPath);
+    if (!d) {
+        return;
+    }
+    dirs++;
+
+    struct dirent* entry = nullptr;
+    while ((entry = readdir(d)) != nullptr) {
+        if (entry->d_name[0] == '.') {
+            continue;
+        }
+        snprintf(entryPath, sizeof(entryPath), "%s/%s", resolvedPath, entry->d_name);
+        if (isPathDir(entryPath)) {
+            legacyWalk(entryPath, dirs, files);
+        } else if (isPathRegularFile(entryPath)) {
+            files++;
+        }
+    }
+    closedir(d);
+}
+
+void printScan(const char* name, uint64_t dirs, uint64_t files, int64_t ns)
+{
+    const double ms = ns / 1e6;
+    printf("%-14s %8llu %9llu %10.1f %12.0f\n", name, (unsigned long long)dirs, (unsigned long long)files, ms,
+           files / (ms / 1000));
+    fflush(stdout);
+}
+
+// What FileInotifyWatcher did per event before WatchIndex: walk every path
+// kept for the wd and stat() each to find the one still a directory.
+bool legacyPathFromWd(const QMultiMap<int, QString>& paths, int wd, QString& path)
+{
+    for (auto it = paths.constFind(wd); it != paths.constEnd() && it.key() == wd; ++it) {
+        if (isPathDir(it.value().toStdString().c_str())) {
+            path = it.value();
+            return true;
+        }
+    }
+    return false;
+}
+
+void printEvents(const char* name, uint64_t events, int64_t ns)
+{
+    printf("%-24s %9llu %10.1f %12.0f\n", name, (unsigned long long)events, ns / 1e6, events / (ns / 1e9));
+    fflush(stdout);
+}
+
+} // namespace
+
+int runScanBench(int files, bool keep)
+{
+    char root[] = "/tmp/kmre-scan-bench-XXXXXX";
+    if (!mkdtemp(root)) {
+        perror("mkdtemp");
+        return 1;
+    }
+
+    printf("building %d files in %d leaf directories below %s\n", files, SCAN_LEAF_DIRS, root);
+    fflush(stdout);
+    int64_t start = monotonicNs();
+    if (!makeTree(root, files)) {
+        perror("create");
+        removeTree(root);
+        return 1;
+    }
+    printf("built in %.1f s\n\n", (monotonicNs() - start) / 1e9);
+
+    uint64_t dirs = 0;
+    uint64_t found = 0;
+    // warm the dentry and inode caches, every walk below starts alike
+    legacyWalk(root, dirs, found);
+
+    printf("%-14s %8s %9s %10s %12s\n", "walk", "dirs", "files", "ms", "files/s");
+    dirs = 0;
+    found = 0;
+    start = monotonicNs();
+    legacyWalk(root, dirs, found);
+    printScan("recursive", dirs, found, monotonicNs() - start);
+
+    for (int threads : { 1, 0 }) {
+        std::atomic<uint64_t> handedDirs(0);
+        std::atomic<uint64_t> handedFiles(0);
+        DirectoryScanner scanner(threads);
+        // the service adds a watch per directory and records every file
+        DirectoryScanner::Stats stats = scanner.scan(root,
+            [&handedDirs](const std::vector<std::string>& batch) { handedDirs += batch.size(); },
+            [&handedFiles](const std::vector<std::string>& batch) { handedFiles += batch.size(); });
+        char name[32];
+        snprintf(name, sizeof(name), "scanner x%ld", threads == 1 ? 1l : (long)sysconf(_SC_NPROCESSORS_ONLN));
+        printScan(name, handedDirs, handedFiles, (int64_t)stats.elapsedUs * 1000);
+    }
+
+    if (keep) {
+        printf("\nkept %s\n", root);
+    } else {
+        removeTree(root);
+    }
+
+    return 0;
+}
+
+int runEventBench(int files)
+{
+    char root[] = "/tmp/kmre-event-bench-XXXXXX";
+    if (!mkdtemp(root)) {
+        perror("mkdtemp");
+        return 1;
+    }
+
+    FileInotifyWatcher watcher;
+    if (watcher.initialize() < 0) {
+        fprintf(stderr, "Failed to initialize inotify.\n");
+        removeTree(root);
+        return 1;
+    }
+
+    QMultiMap<int, QString> legacyPaths;
+    std::vector<std::string> dirs;
+    char name[PATH_MAX];
+    for (int i = 0; i < EVENT_DIRS; i++) {
+        snprintf(name, sizeof(name), "%s/d%03d", root, i);
+        mkdir(name, 0755);
+        int wd = watcher.addWatch(QString(name), IN_CREATE | IN_CLOSE_WRITE, WATCH_ROLE_MEDIA);
+        if (wd < 0) {
+            fprintf(stderr, "Failed to watch %s: %s\n", name, strerror(-wd));
+            removeTree(root);
+            return 1;
+        }
+        legacyPaths.insert(wd, QString(name));
+        dirs.push_back(name);
+    }
+
+    // the burst comes from another thread while this one drains the queue
+    std::atomic<bool> done(false);
+    std::thread creator([&dirs, &done, files]() {
+        char path[PATH_MAX];
+        for (int i = 0; i < files; i++) {
+            snprintf(path, sizeof(path), "%s/IMG_%06d.jpg", dirs[i % dirs.size()].c_str(), i);
+            int fd = open(path, O_WRONLY | O_CREAT | O_CLOEXEC, 0644);
+            if (fd >= 0) {
+                close(fd);
+            }
+        }
+        done = true;
+    });
+
+    std::vector<struct inotify_event*> events;
+    std::string path;
+    std::string entryPath;
+    QString legacyPath;
+    uint64_t handled = 0;
+    uint64_t overflows = 0;
+    uint64_t resolved = 0;
+    int64_t indexLookupNs = 0;
+    int64_t legacyLookupNs = 0;
+    int64_t indexFullNs = 0;
+    int64_t legacyFullNs = 0;
+
+    while (true) {
+        int n = watcher.readEvents(200, events);
+        if (n < 0) {
+            break;
+        }
+        if (n == 0) {
+            if (done) {
+                break;
+            }
+            continue;
+        }
+
+        for (const struct inotify_event* event : events) {
+            if (event->mask & IN_Q_OVERFLOW) {
+                overflows++;
+            }
+        }
+        handled += n;
+
+        // wd -> path only
+        int64_t start = monotonicNs();
+        for (const struct inotify_event* event : events) {
+            resolved += watcher.watchedPathFromWd(event->wd, path);
+        }
+        indexLookupNs += monotonicNs() - start;
+
+        start = monotonicNs();
+        for (const struct inotify_event* event : events) {
+            legacyPathFromWd(legacyPaths, event->wd, legacyPath);
+        }
+        legacyLookupNs += monotonicNs() - start;
+
+        // what the service does with a creation: the entry path and the
+        // check that it is a regular file; the old code also stat()ed
+        // for a directory first
+        start = monotonicNs();
+        for (const struct inotify_event* event : events) {
+            if (event->len > 0 && watcher.watchedPathFromWd(event->wd, path)) {
+                entryPath = path;
+                entryPath += '/';
+                entryPath += event->name;
+                if (!(event->mask & IN_ISDIR)) {
+                    isPathRegularFile(entryPath.c_str());
+                }
+            }
+        }
+        indexFullNs += monotonicNs() - start;
+
+        start = monotonicNs();
+        for (const struct inotify_event* event : events) {
+            if (event->len > 0 && legacyPathFromWd(legacyPaths, event->wd, legacyPath)) {
+                snprintf(name, sizeof(name), "%s/%s", legacyPath.toStdString().c_str(), event->name);
+                if (!isPathDir(name)) {
+                    isPathRegularFile(name);
+                }
+            }
+        }
+        legacyFullNs += monotonicNs() - start;
+    }
+    creator.join();
+
+    printf("%d files created in %d watched directories, %llu events after coalescing, %llu overflows\n\n",
+           files, EVENT_DIRS, (unsigned long long)handled, (unsigned long long)overflows);
+    printf("%-24s %9s %10s %12s\n", "resolve", "events", "ms", "events/s");
+    printEvents("lookup, path maps", handled, legacyLookupNs);
+    printEvents("lookup, WatchIndex", handled, indexLookupNs);
+    printEvents("handling, path maps", handled, legacyFullNs);
+    printEvents("handling, WatchIndex", handled, indexFullNs);
+    if (resolved + overflows < handled) {
+        fprintf(stderr, "%llu events did not resolve\n", (unsigned long long)(handled - resolved - overflows));
+    }
+
+    watcher.cleanup();
+    removeTree(root);
+
+    return 0;
+}
+
+} // namespace bench
+} // namespace kmre
@@ -17,9 +17,22 @@
  * limitations under the License.
  */
 
-#ifndef KYLIN_KMRE_LOCKFILE_H
-#define KYLIN_KMRE_LOCKFILE_H
+#ifndef MICROBENCH_H
+#define MICROBENCH_H
 
-bool test_lockfile(const char* path);
+namespace kmre {
+namespace bench {
 
-#endif // LOCKFILE_H
+// Builds a synthetic tree of files regular files in 1000 leaf directories
+// and times the old recursive walk and DirectoryScanner over it. Returns
+// the exit status.
+int runScanBench(int files, bool keep);
+// Watches 1000 directories, creates files files in them from another
+// thread and times resolving the events, by the old path maps and by
+// WatchIndex. Returns the exit status.
+int runEventBench(int files);
+
+} // namespace bench
+} // namespace kmre
+
+#endif // MICROBENCH_H
@@ -25,11 +25,184 @@
 #include <gio/gio.h>
 #include <QFile>
 
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+
 #include <sys/syslog.h>
 
 #include "custom.h"
 
-static int file_set_attribute(const char *file_path, const char* attribute, const char* value);
+// wait this long after the first request so that a burst becomes one batch
+#define ATTRIBUTE_BATCH_DELAY_MS 100
+#define ATTRIBUTE_RETRY_MS 1000
+#define ATTRIBUTE_MAX_ATTEMPTS 3
+
+static int file_set_attribute(const char *file_path, const char* attribute, const char* value, bool *retry);
+
+// /etc/lsb-release does not change while we run, read it once
+static bool is_pro_os()
+{
+    static const bool pro_os = []() {
+        QFile lsb_release("/etc/lsb-release");
+        if (!lsb_release.open(QIODevice::ReadOnly)) {
+            return false;
+        }
+        QByteArray data = lsb_release.readAll();
+        return data.contains("V10 Professional") || data.contains("V10 SP1") || data.contains("V10 SP2");
+    }();
+
+    return pro_os;
+}
+
+/* gvfs元数据写入放到单独线程批量执行，失败时稍后重试，不阻塞调用者 */
+class AttributeWorker
+{
+public:
+    AttributeWorker()
+        : mStop(false),
+          mBusy(false)
+    {
+    }
+
+    ~AttributeWorker()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mLock);
+            mStop = true;
+        }
+        mCond.notify_all();
+        if (mThread.joinable()) {
+            mThread.join();
+        }
+    }
+
+    void post(const char *file_path, const char *attribute, const char *value)
+    {
+        std::lock_guard<std::mutex> lock(mLock);
+
+        // a newer value for the same file replaces one still waiting
+        for (Request& request : mQueue) {
+            if (request.path == file_path && request.attribute == attribute) {
+                request.value = value;
+                request.attempts = 0;
+                return;
+            }
+        }
+
+        mQueue.push_back({ file_path, attribute, value, 0, Clock::now() + std::chrono::milliseconds(ATTRIBUTE_BATCH_DELAY_MS) });
+        if (!mThread.joinable()) {
+            mThread = std::thread(&AttributeWorker::run, this);
+        }
+        mCond.notify_one();
+    }
+
+    void flush()
+    {
+        std::unique_lock<std::mutex> lock(mLock);
+        for (Request& request : mQueue) {
+            request.due = Clock::now();
+        }
+        mCond.notify_one();
+        mIdleCond.wait(lock, [this]() { return (mQueue.empty() && !mBusy) || !mThread.joinable(); });
+    }
+
+private:
+    typedef std::chrono::steady_clock Clock;
+
+    struct Request
+    {
+        std::string path;
+        std::string attribute;
+        std::string value;
+        int attempts;
+        Clock::time_point due;
+    };
+
+    void run()
+    {
+        std::deque<Request> batch;
+        std::deque<Request> retries;
+        std::unique_lock<std::mutex> lock(mLock);
+
+        while (true) {
+            const Clock::time_point now = Clock::now();
+            Clock::time_point next = Clock::time_point::max();
+
+            batch.clear();
+            for (auto it = mQueue.begin(); it != mQueue.end();) {
+                // on exit everything is applied once more without waiting
+                if (mStop || it->due <= now) {
+                    batch.push_back(std::move(*it));
+                    it = mQueue.erase(it);
+                } else {
+                    if (it->due < next) {
+                        next = it->due;
+                    }
+                    ++it;
+                }
+            }
+
+            if (batch.empty()) {
+                mIdleCond.notify_all();
+                if (mStop) {
+                    break;
+                }
+                if (next == Clock::time_point::max()) {
+                    mCond.wait(lock);
+                } else {
+                    mCond.wait_until(lock, next);
+                }
+                continue;
+            }
+
+            mBusy = true;
+            lock.unlock();
+            retries.clear();
+            for (Request& request : batch) {
+                bool retry = false;
+                if (file_set_attribute(request.path.c_str(), request.attribute.c_str(), request.value.c_str(), &retry) == 0 ||
+                    !retry || ++request.attempts >= ATTRIBUTE_MAX_ATTEMPTS) {
+                    continue;
+                }
+                request.due = Clock::now() + std::chrono::milliseconds(ATTRIBUTE_RETRY_MS * request.attempts);
+                retries.push_back(std::move(request));
+            }
+            lock.lock();
+            mBusy = false;
+
+            for (Request& request : retries) {
+                if (!mStop && !isQueued(request)) {
+                    mQueue.push_back(std::move(request));
+                }
+            }
+        }
+    }
+
+    // a newer value was posted while request was being applied
+    bool isQueued(const Request& request) const
+    {
+        for (const Request& queued : mQueue) {
+            if (queued.path == request.path && queued.attribute == request.attribute) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    std::mutex mLock;
+    std::condition_variable mCond;
+    std::condition_variable mIdleCond;
+    std::deque<Request> mQueue;
+    std::thread mThread;
+    bool mStop;
+    bool mBusy;
+};
+
+static AttributeWorker attribute_worker;
 
 int file_set_custom_icon(const char *file_path, const char *icon_path)
 {
@@ -38,17 +211,7 @@ int file_set_custom_icon(const char *file_path, const char *icon_path)
         return -1;
     }
 
-    int pro_os = 0;
-    QFile lsb_release("/etc/lsb-release");
-    if (lsb_release.open(QIODevice::ReadOnly)) {
-        QByteArray data = lsb_release.readAll();
-        if (data.contains("V10 Professional") || data.contains("V10 SP1") || data.contains("V10 SP2")) {
-            pro_os = 1;
-        }
-        lsb_release.close();
-    }
-
-    if (pro_os > 0) {
+    if (is_pro_os()) {
         // For V10 Pro
         snprintf(normal_icon_path, sizeof(normal_icon_path), "%s", icon_path);
     } else {
@@ -60,11 +223,17 @@ int file_set_custom_icon(const char *file_path, const char *icon_path)
         }
     }
 
-    return file_set_attribute(file_path, "metadata::custom-icon", normal_icon_path);
+    attribute_worker.post(file_path, "metadata::custom-icon", normal_icon_path);
+    return 0;
+}
+
+void file_attributes_flush()
+{
+    attribute_worker.flush();
 }
 
 
-int file_set_attribute(const char *file_path, const char *attribute, const char *value)
+int file_set_attribute(const char *file_path, const char *attribute, const char *value, bool *retry)
 {
     GFile* f = NULL;
     GError* error = NULL;
@@ -74,6 +243,8 @@ int file_set_attribute(const char *file_path, const char *attribute, const char
     if (!g_file_set_attribute_string(f, attribute, value, G_FILE_QUERY_INFO_NOFOLLOW_SYMLINKS, NULL, &error)) {
         fprintf(stderr, "error code: %d (%s)\n", error->code, error->message);
         syslog(LOG_WARNING, "Failed to set attribute string for file %s: %s.", file_path, error->message);
+        // the file went away, nothing to retry; gvfsd-metadata may just be starting
+        *retry = !g_error_matches(error, G_IO_ERROR, G_IO_ERROR_NOT_FOUND);
         g_error_free(error);
         ret = -1;
     }
@@ -20,6 +20,10 @@
 #ifndef CUSTOM_H
 #define CUSTOM_H
 
+// Queues the icon, a worker thread writes the gvfs metadata in batches and
+// retries failures. Returns -1 only for bad arguments.
 int file_set_custom_icon(const char* file_path, const char* icon_path);
+// Blocks until every queued attribute was written or given up.
+void file_attributes_flush();
 
 #endif // CUSTOM_H
@@ -1,59 +0,0 @@
-/*
- * Copyright (c) KylinSoft Co., Ltd. 2016-2024.All rights reserved.
- *
- * Authors:
- *  Ma Chao    machao@kylinos.cn
- *
- * Licensed under the Apache License, Version 2.0 (the "License");
- * you may not use this file except in compliance with the License.
- * You may obtain a copy of the License at
- *
- * http://www.apache.org/licenses/LICENSE-2.0
- *
- * Unless required by applicable law or agreed to in writing, software
- * distributed under the License is distributed on an "AS IS" BASIS,
- * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
- * See the License for the specific language governing permissions and
- * limitations under the License.
- */
-
-#include "directory-check-worker.h"
-#include <QDebug>
-#include <unistd.h>
-
-namespace kmre {
-DirectoryCheckWorker::DirectoryCheckWorker(const QString& path)
-    : mPath(path)
-{
-}
-
-void DirectoryCheckWorker::doCheck(const QString& path, int checkType)
-{
-    if (path != mPath) {
-        return;
-    }
-
-    while (true) {
-        QFileInfo info(mPath);
-        if (info.exists()) {
-            break;
-        }
-        usleep(1000000);
-    }
-
-    if (checkType == CHECK_TYPE_PENDING) {
-        emit pendingAddPath(path);
-    } else if (checkType == CHECK_TYPE_NORMAL){
-        emit addPath(path);
-    } else if (checkType == CHECK_TYPE_DEPEND) {
-        emit dependAddPath(path);
-    } else if (checkType == CHECK_TYPE_LINK) {
-        emit linkAddPath(path);
-    }
-}
-
-DirectoryCheckWorker::~DirectoryCheckWorker()
-{
-}
-
-} // namespace kmre
@@ -19,6 +19,13 @@
 
 #include "dbus-client.h"
 
+#include <QtDBus/QDBusMetaType>
+#include <QtDBus/QDBusPendingCallWatcher>
+#include <QtDBus/QDBusPendingReply>
+#include <QCoreApplication>
+
+#include <sys/syslog.h>
+
 namespace kmre {
 
 DBusClient::DBusClient()
@@ -28,10 +35,15 @@ DBusClient::DBusClient()
 {
     mQueryInterface = new QDBusInterface("org.freedesktop.DBus", "/org/freedesktop/DBus", "org.freedesktop.DBus", QDBusConnection::sessionBus());
     mNotifyInterface = new QDBusInterface("cn.kylinos.Kmre.Manager", "/cn/kylinos/Kmre/Manager", "cn.kylinos.Kmre.Manager", QDBusConnection::sessionBus());
+
+    qDBusRegisterMetaType<FileRecord>();
+    qDBusRegisterMetaType<FileRecordList>();
 }
 
 DBusClient::~DBusClient()
 {
+    flush();
+
     if (mQueryInterface) {
         delete mQueryInterface;
     }
@@ -41,6 +53,11 @@ DBusClient::~DBusClient()
     }
 }
 
+void DBusClient::setReplyHandler(const ReplyHandler& handler)
+{
+    mReplyHandler = handler;
+}
+
 bool DBusClient::queryService()
 {
     bool owned = false;
@@ -59,9 +76,112 @@ bool DBusClient::queryService()
     return mServiceNameOwned;
 }
 
+static void dropRecords(FileRecordList& records, const QString& path)
+{
+    for (int i = records.size() - 1; i >= 0; i--) {
+        if (records.at(i).path == path) {
+            records.removeAt(i);
+        }
+    }
+}
+
 void DBusClient::notifyFile(QString path, QString mimeType)
 {
-    mNotifyInterface->call("addOneRecord", path, mimeType);
+    dropRecords(mPendingRemovals, path);
+
+    if (mPendingRecords.isEmpty() && mPendingRemovals.isEmpty()) {
+        mPendingTimer.start();
+    }
+
+    mPendingRecords.append({ path, mimeType });
+    if (mPendingRecords.size() >= RECORD_BATCH_SIZE) {
+        flush();
+    }
+}
+
+void DBusClient::removeFile(QString path, QString mimeType)
+{
+    /* 同一路径的记录尚未发出时直接撤销，但旧记录可能已在android中，墓碑仍需发送 */
+    dropRecords(mPendingRecords, path);
+    for (const FileRecord& record : mPendingRemovals) {
+        if (record.path == path) {
+            return;
+        }
+    }
+
+    if (mPendingRecords.isEmpty() && mPendingRemovals.isEmpty()) {
+        mPendingTimer.start();
+    }
+
+    mPendingRemovals.append({ path, mimeType });
+    if (mPendingRemovals.size() >= RECORD_BATCH_SIZE) {
+        flush();
+    }
+}
+
+int DBusClient::flushIfDue()
+{
+    if (mPendingRecords.isEmpty() && mPendingRemovals.isEmpty()) {
+        return -1;
+    }
+
+    qint64 elapsed = mPendingTimer.elapsed();
+    if (elapsed < RECORD_BATCH_DELAY_MS) {
+        return (int)(RECORD_BATCH_DELAY_MS - elapsed);
+    }
+
+    flush();
+    return -1;
+}
+
+void DBusClient::flush()
+{
+    // the two batches never share a path, their order does not matter
+    if (!mPendingRemovals.isEmpty()) {
+        QDBusMessage message = QDBusMessage::createMethodCall(mNotifyInterface->service(), mNotifyInterface->path(),
+                                                              mNotifyInterface->interface(), "removeRecords");
+        message << QVariant::fromValue(mPendingRemovals);
+        if (!mNotifyInterface->connection().send(message)) {
+            syslog(LOG_WARNING, "DBusClient: Failed to send %d removals.", mPendingRemovals.size());
+        }
+        mPendingRemovals.clear();
+    }
+
+    if (mPendingRecords.isEmpty()) {
+        return;
+    }
+
+    /* 批量异步发送，不等待manager处理完成；应答在主线程的事件循环中处理 */
+    QDBusMessage message = QDBusMessage::createMethodCall(mNotifyInterface->service(), mNotifyInterface->path(),
+                                                          mNotifyInterface->interface(), "addRecords");
+    message << QVariant::fromValue(mPendingRecords);
+    QDBusPendingCall call = mNotifyInterface->connection().asyncCall(message);
+
+    QCoreApplication* app = QCoreApplication::instance();
+    if (app) {
+        // this thread runs no event loop, the watcher has to live in one
+        QDBusPendingCallWatcher* watcher = new QDBusPendingCallWatcher(call);
+        watcher->moveToThread(app->thread());
+        const FileRecordList records = mPendingRecords;
+        const ReplyHandler handler = mReplyHandler;
+        QObject::connect(watcher, &QDBusPendingCallWatcher::finished, watcher,
+                         [this, records, handler](QDBusPendingCallWatcher* w) {
+            QDBusPendingReply<> reply = *w;
+            if (reply.isError()) {
+                syslog(LOG_WARNING, "DBusClient: Failed to send %d records: %s", records.size(),
+                       reply.error().message().toStdString().c_str());
+                if (reply.error().type() == QDBusError::ServiceUnknown) {
+                    mServiceNameOwned = false;
+                }
+            }
+            if (handler) {
+                handler(records, reply.error());
+            }
+            w->deleteLater();
+        });
+    }
+
+    mPendingRecords.clear();
 }
 
 } // namespace kmre
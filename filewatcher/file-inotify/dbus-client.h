@@ -23,24 +23,82 @@
 #include <QtDBus/QDBusConnection>
 #include <QtDBus/QDBusMessage>
 #include <QtDBus/QDBusInterface>
+#include <QtDBus/QDBusArgument>
+#include <QtDBus/QDBusError>
+#include <QElapsedTimer>
+#include <QList>
+
+#include <atomic>
+#include <functional>
+
+// flush thresholds of the addRecords/removeRecords batches
+#define RECORD_BATCH_SIZE       256
+#define RECORD_BATCH_DELAY_MS   200
 
 namespace kmre {
 
+// one entry of cn.kylinos.Kmre.Manager.addRecords/removeRecords, marshalled as (ss)
+struct FileRecord
+{
+    QString path;
+    QString mimeType;
+
+    friend QDBusArgument& operator<<(QDBusArgument& arg, const FileRecord& record) {
+        arg.beginStructure();
+        arg << record.path << record.mimeType;
+        arg.endStructure();
+        return arg;
+    }
+
+    friend const QDBusArgument& operator>>(const QDBusArgument& arg, FileRecord& record) {
+        arg.beginStructure();
+        arg >> record.path >> record.mimeType;
+        arg.endStructure();
+        return arg;
+    }
+};
+
+typedef QList<FileRecord> FileRecordList;
+
+// Not thread safe, only the notify thread of FileInotifyService uses it.
 class DBusClient
 {
 public:
+    // Called in the main thread once the manager answered an addRecords
+    // batch; error is not valid when the records were taken.
+    typedef std::function<void(const FileRecordList& records, const QDBusError& error)> ReplyHandler;
+
     DBusClient();
     ~DBusClient();
 
+    void setReplyHandler(const ReplyHandler& handler);
+
     bool queryService();
+    // Queue a record; the batch goes out once it is full or has waited long enough.
     void notifyFile(QString path, QString mimeType);
+    // Queue a tombstone for a file that was deleted or moved away. It cancels
+    // a queued record of the same path, and a later record cancels it, so a
+    // path is never in both batches.
+    void removeFile(QString path, QString mimeType);
+
+    // Send the batches now if they are due. Return ms until they will be, -1 if empty.
+    int flushIfDue();
+    void flush();
 
 private:
-    bool mServiceNameOwned;
+    // cleared from the main thread when a batch found no manager
+    std::atomic<bool> mServiceNameOwned;
     QDBusInterface* mQueryInterface;
     QDBusInterface* mNotifyInterface;
+    FileRecordList mPendingRecords;
+    FileRecordList mPendingRemovals;
+    QElapsedTimer mPendingTimer;
+    ReplyHandler mReplyHandler;
 };
 
 } // namespace kmre
 
+Q_DECLARE_METATYPE(kmre::FileRecord)
+Q_DECLARE_METATYPE(kmre::FileRecordList)
+
 #endif // DBUSCLIENT_H
@@ -0,0 +1,300 @@
+/*
+ * Copyright (c) KylinSoft Co., Ltd. 2016-2024.All rights reserved.
+ *
+ * Authors:
+ *  Ma Chao    machao@kylinos.cn
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "directory-scanner.h"
+#include "path-filter.h"
+
+#include <thread>
+
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <sys/types.h>
+#include <dirent.h>
+#include <fcntl.h>
+#include <sched.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#define DENTS_BUFFER_SIZE (32 * 1024)
+
+namespace kmre {
+
+struct linux_dirent64
+{
+    ino64_t        d_ino;
+    off64_t        d_off;
+    unsigned short d_reclen;
+    unsigned char  d_type;
+    char           d_name[];
+};
+
+static uint64_t monotonicUs()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+DirectoryScanner::DirectoryScanner(int threads, size_t batchSize)
+    : mThreads(threads),
+      mBatchSize(batchSize > 0 ? batchSize : 1),
+      mPending(0),
+      mDirs(0),
+      mFiles(0),
+      mSteals(0),
+      mCached(0),
+      mDirCache(nullptr),
+      mFilter(nullptr),
+      mStop(nullptr)
+{
+    if (mThreads <= 0) {
+        mThreads = (int)std::thread::hardware_concurrency();
+        if (mThreads <= 0) {
+            mThreads = 1;
+        }
+    }
+}
+
+DirectoryScanner::~DirectoryScanner()
+{
+}
+
+DirectoryScanner::Stats DirectoryScanner::scan(const std::string& root, const BatchHandler& dirHandler, const BatchHandler& fileHandler)
+{
+    Stats stats = { 0, 0, 0, 0, 0 };
+    uint64_t start = monotonicUs();
+
+    mDirHandler = dirHandler;
+    mFileHandler = fileHandler;
+    mDirs = 0;
+    mFiles = 0;
+    mSteals = 0;
+    mCached = 0;
+
+    mQueues.clear();
+    for (int i = 0; i < mThreads; i++) {
+        mQueues.emplace_back(new WorkQueue);
+    }
+
+    mPending = 1;
+    mQueues[0]->dirs.push_back(root);
+
+    if (mThreads == 1) {
+        work(0);
+    } else {
+        std::vector<std::thread> workers;
+        for (int i = 1; i < mThreads; i++) {
+            workers.emplace_back(&DirectoryScanner::work, this, (size_t)i);
+        }
+        work(0);
+        for (std::thread& worker : workers) {
+            worker.join();
+        }
+    }
+
+    mDirHandler = nullptr;
+    mFileHandler = nullptr;
+
+    stats.dirs = mDirs;
+    stats.files = mFiles;
+    stats.steals = mSteals;
+    stats.cached = mCached;
+    stats.elapsedUs = monotonicUs() - start;
+    return stats;
+}
+
+void DirectoryScanner::pushDir(size_t index, std::string&& dir)
+{
+    mPending++;
+    WorkQueue& queue = *mQueues[index];
+    std::lock_guard<std::mutex> _l(queue.lock);
+    queue.dirs.push_back(std::move(dir));
+}
+
+bool DirectoryScanner::nextDir(size_t index, std::string& dir)
+{
+    unsigned int idle = 0;
+
+    while (mPending > 0) {
+        if (mStop && *mStop) {
+            return false;
+        }
+
+        {
+            WorkQueue& own = *mQueues[index];
+            std::lock_guard<std::mutex> _l(own.lock);
+            if (!own.dirs.empty()) {
+                dir = std::move(own.dirs.back());
+                own.dirs.pop_back();
+                return true;
+            }
+        }
+
+        // steal the oldest (largest, closest to the root) directory
+        for (size_t i = 1; i < mQueues.size(); i++) {
+            WorkQueue& victim = *mQueues[(index + i) % mQueues.size()];
+            std::lock_guard<std::mutex> _l(victim.lock);
+            if (!victim.dirs.empty()) {
+                dir = std::move(victim.dirs.front());
+                victim.dirs.pop_front();
+                mSteals++;
+                return true;
+            }
+        }
+
+        // others are still reading and may push more work
+        if (++idle < 64) {
+            sched_yield();
+        } else {
+            usleep(100);
+        }
+    }
+
+    return false;
+}
+
+void DirectoryScanner::work(size_t index)
+{
+    Batch batch;
+    std::string dir;
+
+    while (nextDir(index, dir)) {
+        readDir(index, dir, batch);
+        flush(batch, false);
+        mPending--;
+    }
+
+    flush(batch, true);
+}
+
+void DirectoryScanner::readDir(size_t index, const std::string& dir, Batch& batch)
+{
+    char buffer[DENTS_BUFFER_SIZE];
+    std::vector<std::string> subdirs;
+    std::vector<std::string> files;
+    // the cache keeps the full listing, the filter may change between runs
+    const PathFilter* filter = (mFilter && mFilter->hasExcludes()) ? mFilter : nullptr;
+
+    int fd = openat(AT_FDCWD, dir.c_str(), O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC);
+    if (fd < 0) {
+        return;
+    }
+
+    mDirs++;
+    if (mDirHandler) {
+        // hand out before reading, so with small batches a watch is in
+        // place before the entries are listed
+        batch.dirs.push_back(dir);
+        flush(batch, false);
+    }
+
+    if (mDirCache && mDirCache->unchanged(dir, fd, subdirs)) {
+        mCached++;
+        for (const std::string& name : subdirs) {
+            std::string path = dir + "/" + name;
+            if (!filter || !filter->isEntryExcluded(path)) {
+                pushDir(index, std::move(path));
+            }
+        }
+        close(fd);
+        return;
+    }
+
+    while (true) {
+        long n = syscall(SYS_getdents64, fd, buffer, sizeof(buffer));
+        if (n <= 0) {
+            break;
+        }
+
+        for (long pos = 0; pos < n;) {
+            struct linux_dirent64* entry = (struct linux_dirent64*)(buffer + pos);
+            pos += entry->d_reclen;
+
+            // also skips "." and ".."
+            if (entry->d_name[0] == '.' || entry->d_name[0] == '\0') {
+                continue;
+            }
+
+            unsigned char type = entry->d_type;
+            if (type == DT_UNKNOWN) {
+                struct stat sb;
+                if (fstatat(fd, entry->d_name, &sb, AT_SYMLINK_NOFOLLOW) != 0) {
+                    continue;
+                }
+                type = S_ISDIR(sb.st_mode) ? DT_DIR : (S_ISREG(sb.st_mode) ? DT_REG : DT_UNKNOWN);
+            }
+
+            if (type == DT_DIR) {
+                std::string path;
+                path.reserve(dir.size() + 1 + strlen(entry->d_name));
+                path.append(dir).append("/").append(entry->d_name);
+                if (mDirCache) {
+                    subdirs.push_back(entry->d_name);
+                }
+                if (!filter || !filter->isEntryExcluded(path)) {
+                    pushDir(index, std::move(path));
+                }
+            } else if (type == DT_REG) {
+                if (mDirCache) {
+                    files.push_back(entry->d_name);
+                }
+                if (!filter && !mFileHandler) {
+                    mFiles++;
+                    continue;
+                }
+                std::string path = dir + "/" + entry->d_name;
+                if (filter && filter->isEntryExcluded(path)) {
+                    continue;
+                }
+                mFiles++;
+                if (mFileHandler) {
+                    batch.files.push_back(std::move(path));
+                }
+            }
+        }
+    }
+
+    if (mDirCache) {
+        mDirCache->listed(dir, fd, subdirs, files);
+    }
+
+    close(fd);
+}
+
+void DirectoryScanner::flush(Batch& batch, bool force)
+{
+    bool dirsReady = !batch.dirs.empty() && (force || batch.dirs.size() >= mBatchSize);
+    bool filesReady = !batch.files.empty() && (force || batch.files.size() >= mBatchSize);
+    if (!dirsReady && !filesReady) {
+        return;
+    }
+
+    std::lock_guard<std::mutex> _l(mHandlerLock);
+    if (dirsReady) {
+        mDirHandler(batch.dirs);
+        batch.dirs.clear();
+    }
+    if (filesReady) {
+        mFileHandler(batch.files);
+        batch.files.clear();
+    }
+}
+
+} // namespace kmre
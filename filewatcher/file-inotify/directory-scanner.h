@@ -0,0 +1,138 @@
+/*
+ * Copyright (c) KylinSoft Co., Ltd. 2016-2024.All rights reserved.
+ *
+ * Authors:
+ *  Ma Chao    machao@kylinos.cn
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef DIRECTORYSCANNER_H
+#define DIRECTORYSCANNER_H
+
+#include <stdint.h>
+
+#include <atomic>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "utils.h"
+
+namespace kmre {
+
+class PathFilter;
+
+// Iterative, parallel walk of a directory tree.
+//
+// Each worker owns a deque of directories: it pushes and pops at the back
+// (depth first, good locality) and idle workers steal from the front of the
+// others. Entries are read with getdents64() and classified by d_type, so no
+// stat() is needed except on filesystems that report DT_UNKNOWN. Hidden
+// entries and symlinks are skipped, as the old recursive walk did.
+//
+// Results are handed out in batches. Handler calls are serialized, so they
+// may touch state that the thread calling scan() protects with its locks.
+class DirectoryScanner
+{
+public:
+    typedef std::function<void(const std::vector<std::string>& paths)> BatchHandler;
+
+    // Remembers directory listings between scans. Called from the worker
+    // threads, so implementations must be thread safe.
+    class DirCache
+    {
+    public:
+        virtual ~DirCache() {}
+        // Return true and fill subdirs (names) if dir, open as fd, is known
+        // unchanged; it is then not listed and its files are not reported.
+        virtual bool unchanged(const std::string& dir, int fd, std::vector<std::string>& subdirs) = 0;
+        // dir was listed, with these subdirectory and regular file names.
+        virtual void listed(const std::string& dir, int fd, const std::vector<std::string>& subdirs,
+                            const std::vector<std::string>& files) = 0;
+    };
+
+    struct Stats
+    {
+        uint64_t dirs;
+        uint64_t files;
+        uint64_t steals;
+        // directories taken from the DirCache without listing
+        uint64_t cached;
+        uint64_t elapsedUs;
+    };
+
+    // threads <= 0 uses one worker per online CPU; 1 walks in the calling thread.
+    explicit DirectoryScanner(int threads = 0, size_t batchSize = 256);
+    ~DirectoryScanner();
+
+    // Walk root (which must be a directory). dirHandler receives every
+    // directory including root, fileHandler every regular file; either may
+    // be empty. Blocks until the whole tree has been visited.
+    Stats scan(const std::string& root, const BatchHandler& dirHandler, const BatchHandler& fileHandler);
+
+    // Consult cache for every directory of the following scans, nullptr to stop.
+    void setDirCache(DirCache* cache) { mDirCache = cache; }
+    // Skip the entries filter excludes, and everything below them.
+    void setFilter(const PathFilter* filter) { mFilter = filter; }
+    // Give up the walk once *stop is set: the workers finish the directory
+    // they are reading and scan() returns. nullptr walks to the end.
+    void setStopFlag(const std::atomic<bool>* stop) { mStop = stop; }
+
+private:
+    struct WorkQueue
+    {
+        std::mutex lock;
+        std::deque<std::string> dirs;
+    };
+
+    struct Batch
+    {
+        std::vector<std::string> dirs;
+        std::vector<std::string> files;
+    };
+
+    void work(size_t index);
+    bool nextDir(size_t index, std::string& dir);
+    void pushDir(size_t index, std::string&& dir);
+    void readDir(size_t index, const std::string& dir, Batch& batch);
+    void flush(Batch& batch, bool force);
+
+    int mThreads;
+    size_t mBatchSize;
+
+    std::vector<std::unique_ptr<WorkQueue>> mQueues;
+    // directories queued or being read; 0 means the walk is finished
+    std::atomic<long> mPending;
+    std::atomic<uint64_t> mDirs;
+    std::atomic<uint64_t> mFiles;
+    std::atomic<uint64_t> mSteals;
+    std::atomic<uint64_t> mCached;
+
+    DirCache* mDirCache;
+    const PathFilter* mFilter;
+    const std::atomic<bool>* mStop;
+
+    std::mutex mHandlerLock;
+    BatchHandler mDirHandler;
+    BatchHandler mFileHandler;
+
+    DISALLOW_COPY_AND_ASSIGN(DirectoryScanner);
+};
+
+} // namespace kmre
+
+#endif // DIRECTORYSCANNER_H
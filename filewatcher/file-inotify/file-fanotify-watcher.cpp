@@ -0,0 +1,278 @@
+/*
+ * Copyright (c) KylinSoft Co., Ltd. 2016-2024.All rights reserved.
+ *
+ * Authors:
+ *  Ma Chao    machao@kylinos.cn
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "file-fanotify-watcher.h"
+
+#include <QMutexLocker>
+
+#include <sys/fanotify.h>
+#include <sys/statfs.h>
+#include <sys/syslog.h>
+#include <sys/poll.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <errno.h>
+
+#ifndef FAN_REPORT_DIR_FID
+#define FAN_REPORT_DIR_FID  0x00000400
+#endif
+#ifndef FAN_REPORT_NAME
+#define FAN_REPORT_NAME     0x00000800
+#endif
+#ifndef FAN_REPORT_DFID_NAME
+#define FAN_REPORT_DFID_NAME (FAN_REPORT_DIR_FID | FAN_REPORT_NAME)
+#endif
+#ifndef FAN_EVENT_INFO_TYPE_DFID_NAME
+#define FAN_EVENT_INFO_TYPE_DFID_NAME 2
+#endif
+
+#define FANOTIFY_EVENT_MASK (FAN_CREATE | FAN_MOVED_TO | FAN_DELETE | FAN_MOVED_FROM | FAN_ONDIR)
+
+namespace kmre {
+
+static unsigned long long fsidKey(const int val[2])
+{
+    return ((unsigned long long)(unsigned int)val[0] << 32) | (unsigned int)val[1];
+}
+
+FileFanotifyWatcher::FileFanotifyWatcher()
+    : mFanotifyFd(-1),
+      mInitialized(false),
+      mOverflow(false),
+      mLock(QMutex::Recursive)
+{
+}
+
+FileFanotifyWatcher::~FileFanotifyWatcher()
+{
+    cleanup();
+}
+
+int FileFanotifyWatcher::initialize()
+{
+    if (mInitialized) {
+        return 0;
+    }
+
+    mFanotifyFd = fanotify_init(FAN_CLASS_NOTIF | FAN_CLOEXEC | FAN_NONBLOCK | FAN_REPORT_DFID_NAME,
+                                O_RDONLY | O_CLOEXEC | O_LARGEFILE);
+    if (mFanotifyFd < 0) {
+        int err = errno;
+        syslog(LOG_INFO, "FileFanotifyWatcher: fanotify unavailable: %s", strerror(err));
+        return -err;
+    }
+
+    mInitialized = true;
+    return 0;
+}
+
+void FileFanotifyWatcher::cleanup()
+{
+    QMutexLocker lock(&mLock);
+
+    for (int fd : mMountFds) {
+        close(fd);
+    }
+    mMountFds.clear();
+    mRoots.clear();
+
+    if (mFanotifyFd != -1) {
+        close(mFanotifyFd);
+        mFanotifyFd = -1;
+    }
+
+    mInitialized = false;
+}
+
+bool FileFanotifyWatcher::isInitialized()
+{
+    return mInitialized;
+}
+
+int FileFanotifyWatcher::addRoot(const QString &path)
+{
+    char resolvedPath[PATH_MAX] = {0};
+    struct statfs sfs;
+
+    if (!mInitialized) {
+        return -ENODEV;
+    }
+
+    if (!realpath(path.toStdString().c_str(), resolvedPath)) {
+        return -errno;
+    }
+
+    if (statfs(resolvedPath, &sfs) != 0) {
+        return -errno;
+    }
+
+    QMutexLocker lock(&mLock);
+
+    unsigned long long fsid = fsidKey((const int*)&sfs.f_fsid);
+    if (!mMountFds.contains(fsid)) {
+        if (fanotify_mark(mFanotifyFd, FAN_MARK_ADD | FAN_MARK_FILESYSTEM,
+                          FANOTIFY_EVENT_MASK, AT_FDCWD, resolvedPath) != 0) {
+            int err = errno;
+            syslog(LOG_INFO, "FileFanotifyWatcher: Failed to mark filesystem of %s: %s", resolvedPath, strerror(err));
+            return -err;
+        }
+
+        int fd = open(resolvedPath, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+        if (fd < 0) {
+            return -errno;
+        }
+        mMountFds.insert(fsid, fd);
+    }
+
+    QString root = QString::fromLocal8Bit(resolvedPath);
+    if (!mRoots.contains(root)) {
+        mRoots.append(root);
+    }
+
+    return 0;
+}
+
+int FileFanotifyWatcher::markCount()
+{
+    QMutexLocker lock(&mLock);
+    return mMountFds.size();
+}
+
+int FileFanotifyWatcher::rootCount()
+{
+    QMutexLocker lock(&mLock);
+    return mRoots.size();
+}
+
+bool FileFanotifyWatcher::takeOverflow()
+{
+    return mOverflow.exchange(false);
+}
+
+int FileFanotifyWatcher::mountFdFor(unsigned long long fsid)
+{
+    auto it = mMountFds.find(fsid);
+    if (it == mMountFds.end()) {
+        return -1;
+    }
+    return it.value();
+}
+
+bool FileFanotifyWatcher::isUnderRoot(const QString &path)
+{
+    for (const QString& root : mRoots) {
+        if (path.startsWith(root) && (path.length() == root.length() || path.at(root.length()) == '/')) {
+            return true;
+        }
+    }
+    return false;
+}
+
+int FileFanotifyWatcher::readEvents(int timeout, QList<Event> &events)
+{
+    struct pollfd pollfds[1];
+    int count = 0;
+
+    if (!mInitialized) {
+        return -1;
+    }
+
+    pollfds[0].fd = mFanotifyFd;
+    pollfds[0].events = POLLIN;
+
+    if (poll(pollfds, 1, timeout) <= 0) {
+        return 0;
+    }
+
+    ssize_t len = read(mFanotifyFd, mEventBuffer, FANOTIFY_BUFFER_SIZE);
+    if (len <= 0) {
+        return (len < 0 && errno != EAGAIN && errno != EINTR) ? -1 : 0;
+    }
+
+    QMutexLocker lock(&mLock);
+
+    struct fanotify_event_metadata* metadata = (struct fanotify_event_metadata*)mEventBuffer;
+    for (; FAN_EVENT_OK(metadata, len); metadata = FAN_EVENT_NEXT(metadata, len)) {
+        if (metadata->vers != FANOTIFY_METADATA_VERSION) {
+            syslog(LOG_ERR, "FileFanotifyWatcher: Unexpected metadata version %d", metadata->vers);
+            break;
+        }
+
+        if (metadata->fd >= 0) {
+            close(metadata->fd);
+        }
+
+        if (metadata->mask & FAN_Q_OVERFLOW) {
+            mOverflow = true;
+            continue;
+        }
+
+        struct fanotify_event_info_fid* fid = (struct fanotify_event_info_fid*)(metadata + 1);
+        if ((unsigned char*)fid + sizeof(*fid) > (unsigned char*)metadata + metadata->event_len) {
+            continue;
+        }
+        if (fid->hdr.info_type != FAN_EVENT_INFO_TYPE_DFID_NAME) {
+            continue;
+        }
+
+        struct file_handle* handle = (struct file_handle*)fid->handle;
+        const char* name = (const char*)(handle->f_handle + handle->handle_bytes);
+        if (name[0] == '\0' || strcmp(name, ".") == 0) {
+            continue;
+        }
+
+        int mountFd = mountFdFor(fsidKey((const int*)&fid->fsid));
+        if (mountFd < 0) {
+            continue;
+        }
+
+        // the directory may already be gone again (ESTALE)
+        int dirFd = open_by_handle_at(mountFd, handle, O_PATH | O_CLOEXEC);
+        if (dirFd < 0) {
+            continue;
+        }
+
+        char procPath[64];
+        char dirPath[PATH_MAX];
+        snprintf(procPath, sizeof(procPath), "/proc/self/fd/%d", dirFd);
+        ssize_t n = readlink(procPath, dirPath, sizeof(dirPath) - 1);
+        close(dirFd);
+        if (n <= 0) {
+            continue;
+        }
+        dirPath[n] = '\0';
+
+        QString path = QString::fromLocal8Bit(dirPath) + "/" + QString::fromLocal8Bit(name);
+        if (!isUnderRoot(path)) {
+            continue;
+        }
+
+        events.append({ path, (metadata->mask & FAN_ONDIR) != 0, (metadata->mask & FAN_MOVED_TO) != 0,
+                        (metadata->mask & (FAN_DELETE | FAN_MOVED_FROM)) != 0 });
+        count++;
+    }
+
+    return count;
+}
+
+} // namespace kmre
@@ -0,0 +1,98 @@
+/*
+ * Copyright (c) KylinSoft Co., Ltd. 2016-2024.All rights reserved.
+ *
+ * Authors:
+ *  Ma Chao    machao@kylinos.cn
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef FILEFANOTIFYWATCHER_H
+#define FILEFANOTIFYWATCHER_H
+
+#include <atomic>
+
+#include <QMutex>
+#include <QMap>
+#include <QList>
+#include <QString>
+#include <QStringList>
+
+#include "utils.h"
+
+#define FANOTIFY_BUFFER_SIZE (64 * 1024)
+
+namespace kmre {
+
+// Whole-filesystem watcher built on fanotify(7) with FAN_REPORT_DFID_NAME.
+// One filesystem mark covers every directory below the watched roots, so no
+// recursion and no per-directory watch is needed. Filesystem marks require
+// CAP_SYS_ADMIN and resolving the reported directory handles requires
+// CAP_DAC_READ_SEARCH; without them addRoot() fails and the caller falls
+// back to FileInotifyWatcher.
+class FileFanotifyWatcher
+{
+public:
+    struct Event
+    {
+        QString path;
+        bool isDir;
+        // renamed into place, so already complete
+        bool moved;
+        // deleted or renamed away, path no longer exists
+        bool removed;
+    };
+
+    FileFanotifyWatcher();
+    ~FileFanotifyWatcher();
+
+    // Return 0 on success, -errno if fanotify is unavailable.
+    int initialize();
+    void cleanup();
+    bool isInitialized();
+
+    // Report entries created, deleted or moved below path. Return 0 or -errno.
+    int addRoot(const QString& path);
+
+    int markCount();
+    int rootCount();
+
+    // Wait up to timeout ms, then decode one read() worth of events below
+    // the roots into events. Return the number appended, or -1.
+    int readEvents(int timeout, QList<Event>& events);
+
+    // True once since the last call if the kernel queue overflowed.
+    bool takeOverflow();
+
+private:
+    int mountFdFor(unsigned long long fsid);
+    bool isUnderRoot(const QString& path);
+
+    int mFanotifyFd;
+    std::atomic<bool> mInitialized;
+    std::atomic<bool> mOverflow;
+
+    QMutex mLock;
+    QStringList mRoots;
+    // filesystem id -> fd of a directory on that filesystem, used with
+    // open_by_handle_at() and as the marked filesystem set
+    QMap<unsigned long long, int> mMountFds;
+
+    unsigned char mEventBuffer[FANOTIFY_BUFFER_SIZE];
+
+    DISALLOW_COPY_AND_ASSIGN(FileFanotifyWatcher);
+};
+
+} // namespace kmre
+
+#endif // FILEFANOTIFYWATCHER_H
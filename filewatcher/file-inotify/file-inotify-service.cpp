@@ -19,10 +19,17 @@
 
 #include "file-inotify-service.h"
 #include "dbus-client.h"
+#include "directory-scanner.h"
 
 #include <QMutexLocker>
 #include <QStandardPaths>
+#include <QRunnable>
+#include <QThread>
 
+#include <algorithm>
+
+#include <errno.h>
+#include <fcntl.h>
 #include <unistd.h>
 #include <sys/inotify.h>
 #include <dirent.h>
@@ -31,10 +38,23 @@
 #include <stdio.h>
 #include <sys/stat.h>
 #include <sys/types.h>
+#include <sys/syslog.h>
 
 
 #include <QDebug>
 
+#define FILE_SETTLE_MS  500
+#define NOTIFY_RETRY_MS 1000
+#define SNIFF_MAX_THREADS 4
+// share of fs.inotify.max_user_watches the media tree may take
+#define WATCH_BUDGET_PERCENT 50
+#define POLL_INTERVAL_MS 30000
+// after ENOSPC, try the full budget again this much later
+#define BUDGET_RETRY_S 600
+// engine events waiting for the poll thread, beyond that they are dropped
+// and the changed directories rescanned
+#define WATCH_QUEUE_MAX 65536
+
 namespace kmre {
 
 static QString homeDirPath = QStandardPaths::writableLocation(QStandardPaths::HomeLocation);
@@ -43,6 +63,115 @@ FileInotifyService::Garbo FileInotifyService::garbo;
 QMutex FileInotifyService::lock(QMutex::Recursive);
 FileInotifyService* FileInotifyService::m_pInstance = nullptr;
 
+static int64_t timespecNs(const struct timespec& ts)
+{
+    return (int64_t)ts.tv_sec * 1000000000ll + ts.tv_nsec;
+}
+
+#define ANDROID_HOME_PATH "/storage/emulated/0/0-麒麟文件/"
+
+static QString androidPathOf(const QString& path)
+{
+    QString androidPath = path;
+    androidPath.replace(0, homeDirPath.length(), ANDROID_HOME_PATH);
+    return androidPath;
+}
+
+static QString hostPathOf(const QString& androidPath)
+{
+    static const QString androidHome = ANDROID_HOME_PATH;
+    QString path = androidPath;
+    path.replace(0, androidHome.length(), homeDirPath);
+    return path;
+}
+
+// Startup walks skip directories whose mtime matches the index, and report
+// files that appeared in the others while the watcher was not running.
+class IndexDirCache : public DirectoryScanner::DirCache
+{
+public:
+    explicit IndexDirCache(FileInotifyService* service)
+        : mService(service)
+    {
+    }
+
+    bool unchanged(const std::string& dir, int fd, std::vector<std::string>& subdirs) override
+    {
+        struct stat sb;
+        MediaIndex::Entry entry;
+
+        if (fstat(fd, &sb) != 0 || !mService->mIndex.find(MediaIndex::hashPath(dir), entry)) {
+            return false;
+        }
+
+        if (entry.type != MediaIndex::ENTRY_DIR || entry.ino != (uint64_t)sb.st_ino ||
+            entry.mtimeNs != timespecNs(sb.st_mtim)) {
+            return false;
+        }
+
+        subdirs = entry.children;
+        return true;
+    }
+
+    void listed(const std::string& dir, int fd, const std::vector<std::string>& subdirs,
+                const std::vector<std::string>& files) override
+    {
+        struct stat sb;
+        MediaIndex::Entry entry;
+        const uint64_t hash = MediaIndex::hashPath(dir);
+
+        if (fstat(fd, &sb) != 0) {
+            return;
+        }
+
+        /* 目录在上次扫描后有变化，上报期间新出现的文件 */
+        if (mService->mIndex.find(hash, entry) && entry.type == MediaIndex::ENTRY_DIR) {
+            const int64_t since = entry.mtimeNs;
+            for (const std::string& name : files) {
+                struct stat fileSb;
+                if (fstatat(fd, name.c_str(), &fileSb, AT_SYMLINK_NOFOLLOW) == 0 &&
+                    timespecNs(fileSb.st_ctim) > since) {
+                    mService->addNotifyFileLocked(QString::fromStdString(dir + "/" + name));
+                }
+            }
+        }
+
+        entry.type = MediaIndex::ENTRY_DIR;
+        entry.flags = 0;
+        entry.ino = sb.st_ino;
+        entry.mtimeNs = timespecNs(sb.st_mtim);
+        entry.size = 0;
+        entry.children = subdirs;
+        entry.parent = 0;
+        entry.name.clear();
+        mService->mIndex.put(hash, entry);
+    }
+
+private:
+    FileInotifyService* mService;
+};
+
+class SniffTask : public QRunnable
+{
+public:
+    SniffTask(FileInotifyService* service, const QString& path, const QString& replacedPath)
+        : mService(service),
+          mPath(path),
+          mReplacedPath(replacedPath)
+    {
+    }
+
+    void run() override
+    {
+        mService->sniffFile(mPath, mReplacedPath);
+    }
+
+private:
+    FileInotifyService* mService;
+    QString mPath;
+    QString mReplacedPath;
+};
+
 FileInotifyService* FileInotifyService::getInstance()
 {
     if (nullptr == m_pInstance) {
@@ -57,23 +186,57 @@ FileInotifyService* FileInotifyService::getInstance()
 
 FileInotifyService::FileInotifyService()
     : mWatcherLock(QMutex::Recursive),
-      mListLock(QMutex::Recursive),
       mInitialized(false),
       mIsRunning(false),
       mIsThreadRunning(false),
       mStopWatcher(false),
       mStopList(false),
-      mDBusClient(nullptr)
+      mEngine(WatchEngine::getInstance()),
+      mLastBatch(0),
+      mBatchSeq(0),
+      mTouchedAt(0),
+      mWatchLimit(WatchBudget::systemLimit()),
+      mBudgetShrunkAt(0),
+      mUseFanotify(false),
+      mDBusClient(nullptr),
+      mListSleeping(false),
+      mListLock(QMutex::NonRecursive),
+      mWatchQueued(0),
+      mWatchDropped(false),
+      mPollSleeping(false)
 {
     mDBusClient = new DBusClient;
+    mDBusClient->setReplyHandler([this](const FileRecordList& records, const QDBusError& error) {
+        ListEvent::Type type = ListEvent::DELIVERED;
+        if (error.isValid()) {
+            /* 旧版manager没有addRecords，重发无用，记录保持未确认，文件再次变化时重新上报 */
+            if (error.type() == QDBusError::UnknownMethod || error.type() == QDBusError::UnknownInterface ||
+                error.type() == QDBusError::UnknownObject) {
+                return;
+            }
+            type = ListEvent::UNDELIVERED;
+        }
+        for (const FileRecord& record : records) {
+            postListEvent(type, hostPathOf(record.path), record.mimeType);
+        }
+    });
+    mListClock.start();
+    mSniffPool.setMaxThreadCount(qBound(1, QThread::idealThreadCount(), SNIFF_MAX_THREADS));
+    mFilter.addMimeType("image/*");
+    mFilter.addMimeType("video/*");
+    mBudget.setBudget(mWatchLimit * WATCH_BUDGET_PERCENT / 100);
 }
 
 FileInotifyService::~FileInotifyService()
 {
     stop();
     wait();
+    mSniffPool.clear();
+    mSniffPool.waitForDone();
+    mIndex.close();
 
-    mWatcher.cleanup();
+    mEngine->setHandler(WATCH_ROLE_MEDIA, nullptr);
+    mFanotify.cleanup();
 
     delete mDBusClient;
 }
@@ -87,12 +250,19 @@ void FileInotifyService::wait()
     if (mWatcherThread.joinable()) {
         mWatcherThread.join();
     }
+
+    if (mPollThread.joinable()) {
+        mPollThread.join();
+    }
 }
 
 void FileInotifyService::stop()
 {
     mStopList = true;
+    QMutexLocker _l(&mListLock);
     mStopWatcher = true;
+    mListCond.wakeAll();
+    mPollCond.wakeAll();
 }
 
 void FileInotifyService::start()
@@ -110,11 +280,48 @@ void FileInotifyService::start()
     mStopWatcher = false;
 
     mListThread = std::thread(&FileInotifyService::loopList, this);
-    mWatcherThread = std::thread(&FileInotifyService::run, this);
+    if (mUseFanotify) {
+        mWatcherThread = std::thread(&FileInotifyService::runFanotify, this);
+        while (!mIsThreadRunning) {
+            usleep(50 * 1000);
+        }
+    } else {
+        mLastBatch = time(nullptr);
+        mEngine->setHandler(WATCH_ROLE_MEDIA, this);
+        mEngine->start();
+        mPollThread = std::thread(&FileInotifyService::loopPoll, this);
+    }
+
+    mIndex.flush();
 
-    while (!mIsThreadRunning) {
-        usleep(50 * 1000);
+    WatchStats stats = watchStats();
+    syslog(LOG_INFO, "FileInotifyService: %s backend, %d roots, %d %s, %d polled dirs, startup took %lld ms.",
+           mUseFanotify ? "fanotify" : "inotify", mRoots.size(), stats.watched,
+           mUseFanotify ? "filesystem marks" : "watches", stats.polled, (long long)mStartupTimer.elapsed());
+}
+
+int FileInotifyService::watchCount()
+{
+    QMutexLocker _l(&mWatcherLock);
+    if (mUseFanotify) {
+        return mFanotify.markCount();
     }
+    return (int)mBudget.watchedCount();
+}
+
+FileInotifyService::WatchStats FileInotifyService::watchStats()
+{
+    WatchStats stats;
+
+    QMutexLocker _l(&mWatcherLock);
+    stats.fanotify = mUseFanotify;
+    stats.watched = watchCount();
+    stats.polled = (int)mBudget.polledCount();
+    stats.budget = (int)mBudget.budget();
+    stats.limit = (int)mWatchLimit;
+    stats.total = mUseFanotify ? 0 : (int)mEngine->watchCount();
+
+    return stats;
 }
 
 int FileInotifyService::initialize()
@@ -123,7 +330,17 @@ int FileInotifyService::initialize()
         return 0;
     }
 
-    if (mWatcher.initialize() < 0) {
+    mStartupTimer.start();
+
+    const std::string indexPath = (homeDirPath + "/.kmre/kylin-kmre-filewatcher.index").toStdString();
+    int ret = mIndex.open(indexPath);
+    if (ret < 0) {
+        syslog(LOG_WARNING, "FileInotifyService: Failed to open index %s: %s", indexPath.c_str(), strerror(-ret));
+    }
+
+    if (mFanotify.initialize() == 0) {
+        mUseFanotify = true;
+    } else if (mEngine->initialize() < 0) {
         return -1;
     }
 
@@ -132,6 +349,42 @@ int FileInotifyService::initialize()
     return 0;
 }
 
+void FileInotifyService::fallBackToInotifyLocked()
+{
+    syslog(LOG_INFO, "FileInotifyService: fanotify marks not permitted, falling back to inotify.");
+
+    mFanotify.cleanup();
+    mUseFanotify = false;
+    if (mEngine->initialize() < 0) {
+        return;
+    }
+
+    // roots accepted by fanotify so far need their watches too
+    for (const QString& root : mRoots) {
+        watchAndNotifyDirectoryRecursivelyLocked(root, false, true, 0);
+    }
+}
+
+void FileInotifyService::setFilter(const QStringList& excludes, const QStringList& mimeTypes)
+{
+    QMutexLocker _l(&mWatcherLock);
+
+    mFilter.clear();
+    for (const QString& exclude : excludes) {
+        if (!mFilter.addExclude(exclude.toStdString())) {
+            syslog(LOG_WARNING, "FileInotifyService: Ignoring exclude rule '%s'.", exclude.toStdString().c_str());
+        }
+    }
+    for (const QString& mimeType : mimeTypes) {
+        mFilter.addMimeType(mimeType.toStdString());
+    }
+}
+
+bool FileInotifyService::isWantedMimeType(const QString& mimeTypeName) const
+{
+    return mFilter.allowsMimeType(mimeTypeName.toStdString());
+}
+
 int FileInotifyService::addWatch(const QString &path)
 {
     if (!mInitialized) {
@@ -142,16 +395,126 @@ int FileInotifyService::addWatch(const QString &path)
     return addWatchLocked(path);
 }
 
-int FileInotifyService::addWatchLocked(const QString &path)
+int FileInotifyService::addWatchLocked(const QString &path, quint64 lastActive)
 {
-    if (mWatcher.addWatch(path, IN_CREATE | IN_MOVED_TO | IN_MOVE_SELF | IN_DELETE_SELF | IN_EXCL_UNLINK | IN_DONT_FOLLOW) < 0) {
-        return -1;
+    if (mUseFanotify) {
+        return mFanotify.addRoot(path) < 0 ? -1 : 0;
+    }
+
+    const std::string dir = path.toStdString();
+    std::string evicted;
+    if (!mBudget.admit(dir, lastActive, evicted)) {
+        pollDirectoryLocked(dir);
+        return 0;
+    }
+    if (!evicted.empty()) {
+        mEngine->removeWatch(QString::fromStdString(evicted), WATCH_ROLE_MEDIA);
+        pollDirectoryLocked(evicted);
     }
 
+    int wd = mEngine->addWatch(path, WATCH_ROLE_MEDIA, IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO | IN_CLOSE_WRITE | IN_MOVE_SELF | IN_DELETE_SELF | IN_EXCL_UNLINK | IN_DONT_FOLLOW);
+    if (wd < 0) {
+        mBudget.release(dir);
+        if (wd != -ENOSPC) {
+            return -1;
+        }
+        /* 其他程序占用了剩余的监控数，预算收缩到当前用量 */
+        if (mBudgetShrunkAt == 0) {
+            syslog(LOG_WARNING, "FileInotifyService: Out of inotify watches, polling directories beyond %u.",
+                   (unsigned)mBudget.watchedCount());
+        }
+        mBudget.shrinkToUsage();
+        mBudgetShrunkAt = time(nullptr);
+        pollDirectoryLocked(dir);
+        return 0;
+    }
+
+    mBudget.removePolled(dir);
     return 0;
 }
 
-int FileInotifyService::addWatchRecursively(const QString &path, bool shouldNotifyFile)
+void FileInotifyService::pollDirectoryLocked(const std::string& path)
+{
+    struct stat sb;
+
+    if (lstat(path.c_str(), &sb) != 0 || !S_ISDIR(sb.st_mode)) {
+        return;
+    }
+
+    mBudget.addPolled(path, timespecNs(sb.st_mtim));
+}
+
+void FileInotifyService::pollDirectoriesLocked()
+{
+    struct stat sb;
+    int changed = 0;
+    std::vector<std::pair<std::string, int64_t>> dirs;
+
+    if (mBudgetShrunkAt != 0 && time(nullptr) - mBudgetShrunkAt >= BUDGET_RETRY_S) {
+        // other programs may have given their watches back meanwhile
+        mBudget.setBudget(mWatchLimit * WATCH_BUDGET_PERCENT / 100);
+        mBudgetShrunkAt = 0;
+    }
+
+    mBudget.polledDirs(dirs);
+    for (const auto& dir : dirs) {
+        if (lstat(dir.first.c_str(), &sb) != 0 || !S_ISDIR(sb.st_mode)) {
+            forgetPathLocked(dir.first, true);
+            continue;
+        }
+
+        const int64_t mtimeNs = timespecNs(sb.st_mtim);
+        if (mtimeNs == dir.second) {
+            continue;
+        }
+        changed++;
+
+        mBudget.setPolledMtime(dir.first, mtimeNs);
+        rescanDirectoryLocked(dir.first, dir.second);
+        /* 有变化的目录重新争取inotify监控 */
+        addWatchLocked(QString::fromStdString(dir.first), activeTime());
+    }
+
+    if (changed > 0) {
+        syslog(LOG_DEBUG, "FileInotifyService: %d of %d polled directories changed.", changed, (int)dirs.size());
+    }
+}
+
+void FileInotifyService::loopPoll()
+{
+    QElapsedTimer sincePoll;
+    sincePoll.start();
+
+    QMutexLocker _l(&mListLock);
+
+    while (!mStopList) {
+        mPollSleeping = true;
+        if (mWatchQueue.empty() && !mStopList) {
+            const qint64 timeout = POLL_INTERVAL_MS - sincePoll.elapsed();
+            if (timeout > 0) {
+                mPollCond.wait(&mListLock, (unsigned long)timeout);
+            }
+        }
+        mPollSleeping = false;
+        if (mStopList) {
+            break;
+        }
+
+        // never sleep on mListLock with mWatcherLock held
+        _l.unlock();
+        {
+            QMutexLocker _w(&mWatcherLock);
+            takeWatchWorkLocked();
+            if (sincePoll.elapsed() >= POLL_INTERVAL_MS) {
+                pollDirectoriesLocked();
+                sincePoll.restart();
+            }
+        }
+        _l.relock();
+    }
+}
+
+int FileInotifyService::addWatchRecursively(const QString &path, bool shouldNotifyFile, const std::atomic<bool>* stop)
 {
     if (!mInitialized) {
         return -1;
@@ -161,160 +524,757 @@ int FileInotifyService::addWatchRecursively(const QString &path, bool shouldNoti
         return -1;
     }
 
+    if (mFilter.isExcluded(path.toStdString())) {
+        syslog(LOG_INFO, "FileInotifyService: %s is excluded, not watched.", path.toStdString().c_str());
+        return -1;
+    }
+
+    // fanotify may still fall back to inotify, which needs a walk of every
+    // root added so far; that is only done before the service runs
+    Q_ASSERT(!mIsRunning || !mUseFanotify);
+
     QMutexLocker _l(&mWatcherLock);
-    watchAndNotifyDirectoryRecursivelyLocked(path.toStdString().c_str(), shouldNotifyFile);
+    if (mUseFanotify) {
+        // one filesystem mark covers the whole tree, only files need a walk
+        if (mFanotify.addRoot(path) < 0) {
+            fallBackToInotifyLocked();
+        } else {
+            mRoots.append(path);
+            if (shouldNotifyFile) {
+                watchAndNotifyDirectoryRecursivelyLocked(path, true, false, 0, stop);
+            }
+            return 0;
+        }
+    }
+
+    mRoots.append(path);
+    watchAndNotifyDirectoryRecursivelyLocked(path, shouldNotifyFile, true, 0, stop);
 
     return 0;
 }
 
-void FileInotifyService::watchAndNotifyDirectoryRecursivelyLocked(const QString& path, bool shouldNotifyFile)
+void FileInotifyService::watchAndNotifyDirectoryRecursivelyLocked(const QString& path, bool shouldNotifyFile, bool shouldWatch, int threads,
+                                                                  const std::atomic<bool>* stop)
 {
-    struct dirent* entry = nullptr;
-    DIR* dp = nullptr;
-
     char resolvedPath[PATH_MAX] = {0};
 
+    if (!shouldWatch && !shouldNotifyFile) {
+        return;
+    }
+
     if (!realpath(path.toStdString().c_str(), resolvedPath)) {
         return;
     }
 
-    addWatchLocked(resolvedPath);
+    // The scanner serializes the handlers, and this thread holds
+    // mWatcherLock until the walk is over.
+    DirectoryScanner::BatchHandler dirHandler;
+    DirectoryScanner::BatchHandler fileHandler;
+    if (shouldWatch) {
+        dirHandler = [this](const std::vector<std::string>& dirs) {
+            for (const std::string& dir : dirs) {
+                addWatchLocked(QString::fromStdString(dir));
+            }
+        };
+    }
+    if (shouldNotifyFile) {
+        fileHandler = [this](const std::vector<std::string>& files) {
+            for (const std::string& file : files) {
+                addNotifyFileLocked(QString::fromStdString(file));
+            }
+        };
+    }
+
+    DirectoryScanner scanner(threads);
+    scanner.setFilter(&mFilter);
+    scanner.setStopFlag(stop);
+    // only plain watch walks may skip listings; a notifying walk needs every file
+    IndexDirCache dirCache(this);
+    if (shouldWatch && !shouldNotifyFile && mIndex.isOpen()) {
+        scanner.setDirCache(&dirCache);
+    }
 
-    dp = opendir(resolvedPath);
-    if (!dp) {
+    DirectoryScanner::Stats stats = scanner.scan(resolvedPath, dirHandler, fileHandler);
+    if (threads != 1) {
+        syslog(LOG_DEBUG, "FileInotifyService: Scanned %s: %llu dirs (%llu unchanged), %llu files in %llu ms.",
+               resolvedPath, (unsigned long long)stats.dirs, (unsigned long long)stats.cached,
+               (unsigned long long)stats.files, (unsigned long long)(stats.elapsedUs / 1000));
+    }
+}
+
+void FileInotifyService::onWatchEvent(int role, const std::string& path, const struct inotify_event* event)
+{
+    (void)role;
+
+    // a watch the kernel dropped must still leave the budget
+    const bool self = (event->mask & (IN_MOVE_SELF | IN_DELETE_SELF | IN_IGNORED)) != 0;
+    if (!self && mWatchQueued >= WATCH_QUEUE_MAX) {
+        mWatchDropped = true;
         return;
     }
 
-    while ((entry = readdir(dp)) != nullptr) {
-        char filePath[PATH_MAX + NAME_MAX + 1] = {0};
-        if (strlen(entry->d_name) == 0) {
-            continue;
+    WatchWork work(WatchWork::EVENT);
+    work.wd = event->wd;
+    work.mask = event->mask;
+    work.cookie = event->cookie;
+    work.path = path;
+    if (event->len > 0) {
+        work.name = event->name;
+    }
+    postWatchWork(std::move(work));
+}
+
+void FileInotifyService::onWatchOverflow(int role)
+{
+    (void)role;
+
+    postWatchWork(WatchWork(WatchWork::RESCAN));
+}
+
+void FileInotifyService::onWatchBatchEnd(int role)
+{
+    (void)role;
+
+    if (mWatchDropped.exchange(false)) {
+        postWatchWork(WatchWork(WatchWork::RESCAN));
+    }
+    postWatchWork(WatchWork(WatchWork::BATCH_END));
+}
+
+void FileInotifyService::postWatchWork(WatchWork&& work)
+{
+    mWatchQueued++;
+    mWatchQueue.push(std::move(work));
+
+    // same handshake as postListEvent()
+    if (mPollSleeping) {
+        QMutexLocker _l(&mListLock);
+        mPollCond.wakeOne();
+    }
+}
+
+void FileInotifyService::takeWatchWorkLocked()
+{
+    WatchWork work;
+
+    while (mWatchQueue.pop(work)) {
+        mWatchQueued--;
+        switch (work.type) {
+        case WatchWork::EVENT:
+            handleWatchEventLocked(work);
+            break;
+        case WatchWork::RESCAN:
+            /* 事件队列溢出，只重新扫描溢出期间有变化的目录 */
+            rescanChangedDirectoriesLocked(mLastBatch - 1);
+            break;
+        case WatchWork::BATCH_END:
+            handleWatchBatchEndLocked();
+            break;
         }
+    }
+}
 
-        if (entry->d_name[0] == '.') {
+void FileInotifyService::handleWatchEventLocked(const WatchWork& work)
+{
+    const bool hasName = !work.name.empty();
+
+    if (!(work.mask & IN_IGNORED) && (mTouchedAt != activeTime() || mTouchedPath != work.path)) {
+        mTouchedPath = work.path;
+        mTouchedAt = activeTime();
+        mBudget.touch(work.path, mTouchedAt);
+    }
+
+    if ((work.mask & IN_MOVED_FROM) && hasName) {
+        // wait for the other half, it comes in this batch or the next one
+        MovedFrom& from = mMovedFrom[work.cookie];
+        from.path = work.path;
+        from.path += '/';
+        from.path += work.name;
+        from.isDir = (work.mask & IN_ISDIR) != 0;
+        from.batch = mBatchSeq;
+    } else if ((work.mask & IN_DELETE) && hasName) {
+        mEventPath = work.path;
+        mEventPath += '/';
+        mEventPath += work.name;
+        forgetPathLocked(mEventPath, (work.mask & IN_ISDIR) != 0);
+    } else if ((work.mask & (IN_CREATE | IN_MOVED_TO | IN_CLOSE_WRITE)) && hasName) {
+        mEventPath = work.path;
+        mEventPath += '/';
+        mEventPath += work.name;
+        auto from = (work.mask & IN_MOVED_TO) ? mMovedFrom.find(work.cookie) : mMovedFrom.end();
+        if (from != mMovedFrom.end()) {
+            renameLocked(from->second.path, mEventPath, (work.mask & IN_ISDIR) != 0);
+            mMovedFrom.erase(from);
+        } else if (mFilter.isEntryExcluded(mEventPath)) {
+            // excluded names are neither watched nor reported
+            return;
+        } else if (work.mask & IN_ISDIR) {
+            /* 内核已在mask中标明是否为目录，无需再stat */
+            watchAndNotifyDirectoryRecursivelyLocked(QString::fromStdString(mEventPath), true);
+        } else if (!(work.mask & (IN_CREATE | IN_MOVED_TO))) {
+            // closed after writing, only of interest if still pending
+            markFileWritten(QString::fromStdString(mEventPath));
+        } else if (isPathRegularFile(mEventPath.c_str())) {
+            addNotifyFileLocked(QString::fromStdString(mEventPath),
+                                (work.mask & (IN_MOVED_TO | IN_CLOSE_WRITE)) != 0);
+        }
+    } else if ((work.mask & IN_MOVE_SELF) ||
+               (work.mask & IN_DELETE_SELF) ||
+               (work.mask & IN_IGNORED)) {
+        // the engine forgets a wd on IN_IGNORED right away, and by now the
+        // path may be watched again under a new wd
+        const int wd = mEngine->wdFromWatchedPath(QString::fromStdString(work.path));
+        if (wd == work.wd) {
+            mEngine->removeWatch(work.wd);
+        }
+        if (wd < 0 || wd == work.wd) {
+            mBudget.release(work.path);
+        }
+    }
+}
+
+void FileInotifyService::handleWatchBatchEndLocked()
+{
+    /* 上一批的IN_MOVED_FROM仍未配对，说明已被移出监控范围 */
+    for (auto it = mMovedFrom.begin(); it != mMovedFrom.end();) {
+        if (it->second.batch == mBatchSeq) {
+            ++it;
             continue;
         }
+        forgetPathLocked(it->second.path, it->second.isDir);
+        it = mMovedFrom.erase(it);
+    }
+
+    mBatchSeq++;
+    mLastBatch = time(nullptr);
+}
+
+void FileInotifyService::renameLocked(const std::string& from, const std::string& to, bool isDir)
+{
+    const QString oldPath = QString::fromStdString(from);
+    const QString newPath = QString::fromStdString(to);
+
+    /* 移入排除范围视为移出，从排除范围移出视为新建 */
+    if (mFilter.isEntryExcluded(to)) {
+        if (isDir) {
+            // the files can still be listed at their new place
+            DirectoryScanner scanner(1);
+            scanner.scan(to, DirectoryScanner::BatchHandler(), [this, &from, &to](const std::vector<std::string>& files) {
+                for (const std::string& file : files) {
+                    forgetPathLocked(from + file.substr(to.size()), false);
+                }
+            });
+        }
+        forgetPathLocked(from, isDir);
+        return;
+    }
+    if (mFilter.isEntryExcluded(from)) {
+        if (isDir) {
+            watchAndNotifyDirectoryRecursivelyLocked(newPath, true);
+        } else if (isPathRegularFile(to.c_str())) {
+            addNotifyFileLocked(newPath, true);
+        }
+        return;
+    }
 
-        snprintf(filePath, PATH_MAX + NAME_MAX + 1, "%s/%s", resolvedPath, entry->d_name);
-        if (isPathRegularFile(filePath) && shouldNotifyFile) {
-            addNotifyFileLocked(filePath);
-        } else if (isPathDir(filePath)) {
-            watchAndNotifyDirectoryRecursivelyLocked(filePath, shouldNotifyFile);
+    if (!isDir) {
+        renameFileLocked(oldPath, newPath);
+        return;
+    }
+
+    // the watches keep their wds, only the paths below from change
+    if (mEngine->moveWatch(oldPath, newPath)) {
+        mBudget.moveTree(from, to);
+    } else {
+        mEngine->removeWatchTree(oldPath, WATCH_ROLE_MEDIA);
+        mBudget.releaseTree(from);
+        watchAndNotifyDirectoryRecursivelyLocked(newPath, false);
+    }
+    moveIndexTree(from, to);
+
+    /* 目录改名不会产生文件事件，按旧路径逐个更新记录 */
+    DirectoryScanner scanner(1);
+    scanner.setFilter(&mFilter);
+    scanner.scan(to, DirectoryScanner::BatchHandler(), [this, &from, &to](const std::vector<std::string>& files) {
+        for (const std::string& file : files) {
+            renameFileLocked(QString::fromStdString(from + file.substr(to.size())), QString::fromStdString(file));
         }
+    });
+}
+
+void FileInotifyService::renameFileLocked(const QString& from, const QString& to)
+{
+    if (!wasNotified(from)) {
+        addNotifyFileLocked(to, true);
+        return;
     }
 
-    closedir(dp);
+    if (!addNotifyFileLocked(to, true, from)) {
+        // renamed to something not reported, e.g. a different extension
+        forgetFile(from, mMimeDB.mimeTypeForFile(from, QMimeDatabase::MatchExtension).name());
+    }
+}
+
+void FileInotifyService::forgetPathLocked(const std::string& path, bool isDir)
+{
+    const QString oldPath = QString::fromStdString(path);
+
+    if (isDir) {
+        // a deleted directory lost its files one event at a time, one moved
+        // away did not: withdraw what was reported below it
+        std::vector<std::string> dirs;
+        mEngine->removeWatchTree(oldPath, WATCH_ROLE_MEDIA, &dirs);
+        mBudget.releaseTree(path);
+        moveIndexTree(path, std::string(), &dirs);
+        dirs.push_back(path);
+
+        std::sort(dirs.begin(), dirs.end());
+        dirs.erase(std::unique(dirs.begin(), dirs.end()), dirs.end());
+        std::vector<std::string> files;
+        for (const std::string& dir : dirs) {
+            mIndex.removeFiles(dir, files);
+        }
+        for (const std::string& file : files) {
+            const QString filePath = QString::fromStdString(file);
+            postListEvent(ListEvent::REMOVED, filePath,
+                          mMimeDB.mimeTypeForFile(filePath, QMimeDatabase::MatchExtension).name());
+        }
+        return;
+    }
 
+    if (wasNotified(oldPath)) {
+        forgetFile(oldPath, mMimeDB.mimeTypeForFile(oldPath, QMimeDatabase::MatchExtension).name());
+    }
 }
 
-void FileInotifyService::run()
+void FileInotifyService::moveIndexTree(const std::string& from, const std::string& to,
+                                       std::vector<std::string>* dirs)
 {
-    struct inotify_event* event = nullptr;
+    MediaIndex::Entry entry;
+    const uint64_t hash = MediaIndex::hashPath(from);
 
-    if (!mInitialized) {
-        goto out;
+    if (!mIndex.find(hash, entry) || entry.type != MediaIndex::ENTRY_DIR) {
+        return;
+    }
+
+    mIndex.remove(hash);
+    if (!to.empty()) {
+        mIndex.put(MediaIndex::hashPath(to), entry);
+    }
+    if (dirs) {
+        dirs->push_back(from);
     }
 
+    for (const std::string& child : entry.children) {
+        moveIndexTree(from + "/" + child, to.empty() ? to : to + "/" + child, dirs);
+    }
+}
+
+bool FileInotifyService::wasNotified(const QString& path)
+{
+    MediaIndex::Entry entry;
+
+    // only files with a media extension are ever reported
+    if (!path.startsWith(homeDirPath) ||
+        !isWantedMimeType(mMimeDB.mimeTypeForFile(path, QMimeDatabase::MatchExtension).name())) {
+        return false;
+    }
+
+    // without the index there is no telling, assume it was
+    if (!mIndex.isOpen()) {
+        return true;
+    }
+
+    return mIndex.find(MediaIndex::hashPath(path.toStdString()), entry) &&
+           entry.type == MediaIndex::ENTRY_FILE && (entry.flags & (MediaIndex::FLAG_NOTIFIED | MediaIndex::FLAG_SENT));
+}
+
+void FileInotifyService::forgetFile(const QString& path, const QString& mimeTypeName)
+{
+    mIndex.remove(MediaIndex::hashPath(path.toStdString()));
+    postListEvent(ListEvent::REMOVED, path, mimeTypeName);
+}
+
+void FileInotifyService::rescanChangedDirectoriesLocked(time_t since)
+{
+    struct stat sb;
+    int changed = 0;
+    const QStringList paths = mEngine->watchedPaths(WATCH_ROLE_MEDIA);
+
+    // only directories whose entries changed since the last good batch
+    for (const QString& dirPath : paths) {
+        const std::string dir = dirPath.toStdString();
+        if (lstat(dir.c_str(), &sb) != 0 || sb.st_mtime < since) {
+            continue;
+        }
+
+        changed++;
+        rescanDirectoryLocked(dir, (int64_t)since * 1000000000ll);
+    }
+
+    syslog(LOG_INFO, "FileInotifyService: Event queue overflowed, rescanned %d of %d directories.",
+           changed, paths.size());
+}
+
+void FileInotifyService::rescanDirectoryLocked(const std::string& dir, int64_t sinceNs)
+{
+    struct stat sb;
+
+    DIR* d = opendir(dir.c_str());
+    if (!d) {
+        return;
+    }
+
+    struct dirent* entry = nullptr;
+    while ((entry = readdir(d)) != nullptr) {
+        if (entry->d_name[0] == '.') {
+            continue;
+        }
+
+        const std::string path = dir + "/" + entry->d_name;
+        if (mFilter.isEntryExcluded(path) || lstat(path.c_str(), &sb) != 0) {
+            continue;
+        }
+
+        if (S_ISDIR(sb.st_mode)) {
+            if (mEngine->wdFromWatchedPath(QString::fromStdString(path)) < 0 && !mBudget.isPolled(path)) {
+                watchAndNotifyDirectoryRecursivelyLocked(QString::fromStdString(path), true);
+            }
+        } else if (S_ISREG(sb.st_mode) && timespecNs(sb.st_ctim) >= sinceNs) {
+            addNotifyFileLocked(QString::fromStdString(path));
+        }
+    }
+    closedir(d);
+}
+
+void FileInotifyService::runFanotify()
+{
+    QList<FileFanotifyWatcher::Event> events;
+
     mIsThreadRunning = true;
 
     while (!mStopWatcher) {
-        event = mWatcher.readNextEvent(1000);
-        if (event != nullptr) {
-            if ((event->mask & IN_CREATE) ||
-                (event->mask & IN_MOVED_TO)) {
-                if (event->len > 0) {
-                    QString newPath;
-                    QString pathName = mWatcher.watchedPathFromWd(event->wd);
-                    if (pathName.isNull() || pathName.isEmpty()) {
-                        continue;
-                    }
-
-                    newPath = pathName + "/" + QString(event->name);
-                    if (isPathDir(newPath.toStdString().c_str())) {
-                        addWatchRecursively(newPath, true);
-                    } else if (isPathRegularFile(newPath.toStdString().c_str())) {
-                        addNotifyFile(newPath);
-                    }
-                }
-            } else if ((event->mask & IN_MOVE_SELF) ||
-                       (event->mask & IN_DELETE_SELF)) {
-                mWatcher.removeWatch(event->wd);
+        events.clear();
+        if (mFanotify.readEvents(1000, events) < 0) {
+            break;
+        }
+
+        if (mFanotify.takeOverflow()) {
+            syslog(LOG_WARNING, "FileInotifyService: fanotify queue overflowed, some files may be missed.");
+        }
+
+        for (const FileFanotifyWatcher::Event& event : events) {
+            // the marks cover whole filesystems, check every name of the path
+            if (!event.removed && mFilter.isExcluded(event.path.toStdString())) {
+                continue;
+            }
+            if (event.removed) {
+                // renames come as a removal and a creation, there is no cookie
+                QMutexLocker _l(&mWatcherLock);
+                forgetPathLocked(event.path.toStdString(), event.isDir);
+            } else if (event.isDir) {
+                // a directory moved in brings its files without further events
+                QMutexLocker _l(&mWatcherLock);
+                watchAndNotifyDirectoryRecursivelyLocked(event.path, true, false);
+            } else if (isPathRegularFile(event.path.toStdString().c_str())) {
+                addNotifyFile(event.path, event.moved);
             }
         }
     }
 
-out:
     mIsThreadRunning = false;
     mIsRunning = false;
 }
 
-void FileInotifyService::addNotifyFile(const QString &path)
+void FileInotifyService::addNotifyFile(const QString &path, bool complete)
 {
-    QMutexLocker _l(&mWatcherLock);
-    addNotifyFileLocked(path);
+    // the extension check and the list need no watcher state
+    addNotifyFileLocked(path, complete);
 }
 
-void FileInotifyService::addNotifyFileLocked(const QString& path)
+bool FileInotifyService::addNotifyFileLocked(const QString& path, bool complete, const QString& replacedPath)
 {
 
     QMimeType mimeType = mMimeDB.mimeTypeForFile(path, QMimeDatabase::MatchExtension);
     QString mimeTypeName = mimeType.name();
 
     if (path.startsWith(homeDirPath)) {
-        if (mimeTypeName.startsWith("image/") || mimeTypeName.startsWith("video/")) {
-            QMutexLocker _l(&mListLock);
-            mFileList.append( { path, -1 } );
+        if (isWantedMimeType(mimeTypeName)) {
+            postListEvent(complete ? ListEvent::READY : ListEvent::PENDING, path, replacedPath);
+            return true;
         }
     }
+
+    return false;
+}
+
+void FileInotifyService::markFileWritten(const QString& path)
+{
+    postListEvent(ListEvent::WRITTEN, path);
+}
+
+void FileInotifyService::postListEvent(ListEvent::Type type, const QString& path, const QString& detail)
+{
+    mListQueue.push(ListEvent(type, path, detail));
+
+    // the list thread looks at the queue again after setting mListSleeping,
+    // so either it sees this event or it is woken up here
+    if (mListSleeping) {
+        QMutexLocker _l(&mListLock);
+        mListCond.wakeOne();
+    }
 }
 
-bool FileInotifyService::notifyFile(const NotifyFileInfo& info)
+void FileInotifyService::takeListEvents()
 {
-    if (mDBusClient->queryService()) {
-        QString path = info.path;
-        QMimeType mimeType = mMimeDB.mimeTypeForFile(path, QMimeDatabase::MatchContent);
-        QString mimeTypeName = mimeType.name();
-        if (mimeTypeName.startsWith("image/") || mimeTypeName.startsWith("video/")) {
-            path.replace(0, homeDirPath.length(), "/storage/emulated/0/0-麒麟文件/");
-            mDBusClient->notifyFile(path, mimeTypeName);
+    ListEvent event;
+
+    while (mListQueue.pop(event)) {
+        switch (event.type) {
+        case ListEvent::PENDING:
+        case ListEvent::READY:
+            if (!event.detail.isEmpty()) {
+                mRenamedFiles.insert(event.path, event.detail);
+            }
+            if (event.type == ListEvent::READY) {
+                mPendingFiles.remove(event.path);
+                mReadyFiles.insert(event.path);
+            } else if (!mPendingFiles.contains(event.path)) {
+                auto it = mPendingFiles.insert(event.path, { event.path, -1, 0 });
+                scheduleFile(it.value(), FILE_SETTLE_MS);
+            }
+            break;
+        case ListEvent::WRITTEN:
+            if (mPendingFiles.remove(event.path) > 0) {
+                mReadyFiles.insert(event.path);
+            }
+            break;
+        case ListEvent::SNIFFED:
+            mSniffedFiles.append(qMakePair(event.path, event.detail));
+            break;
+        case ListEvent::REMOVED:
+            // removals are sent before the sniffed records, drop a record still waiting
+            for (int i = mSniffedFiles.size() - 1; i >= 0; i--) {
+                if (mSniffedFiles.at(i).first == event.path) {
+                    mSniffedFiles.removeAt(i);
+                }
+            }
+            mRemovedFiles.append(qMakePair(event.path, event.detail));
+            break;
+        case ListEvent::DELIVERED:
+            markDelivered(event.path, true);
+            break;
+        case ListEvent::UNDELIVERED:
+            // sniffed again once due, the index no longer counts it as taken
+            markDelivered(event.path, false);
+            if (!mPendingFiles.contains(event.path) && !mReadyFiles.contains(event.path)) {
+                auto it = mPendingFiles.insert(event.path, { event.path, -1, 0 });
+                scheduleFile(it.value(), NOTIFY_RETRY_MS);
+            }
+            break;
         }
+    }
+}
 
-        return true;
+void FileInotifyService::markDelivered(const QString& path, bool delivered)
+{
+    MediaIndex::Entry entry;
+    const uint64_t hash = MediaIndex::hashPath(path.toStdString());
+
+    if (!mIndex.find(hash, entry) || entry.type != MediaIndex::ENTRY_FILE) {
+        return;
     }
 
-    return false;
+    if (delivered) {
+        entry.flags |= MediaIndex::FLAG_NOTIFIED;
+    } else {
+        entry.flags &= ~MediaIndex::FLAG_NOTIFIED;
+    }
+    mIndex.put(hash, entry);
+}
+
+void FileInotifyService::scheduleFile(NotifyFileInfo& info, quint64 delayMs)
+{
+    info.tick = mSettleWheel.schedule(info.path, mListClock.elapsed(), delayMs);
+}
+
+void FileInotifyService::notifyFile(const QString& path, const QString& mimeTypeName)
+{
+    if (isWantedMimeType(mimeTypeName)) {
+        mDBusClient->notifyFile(androidPathOf(path), mimeTypeName);
+    }
+}
+
+void FileInotifyService::sniffFile(const QString& path, const QString& replacedPath)
+{
+    MediaSniffer::FileKey key;
+    unsigned char magic[MEDIA_MAGIC_SIZE];
+    std::string mimeType;
+    const std::string stdPath = path.toStdString();
+
+    // the old record goes away whatever becomes of the new one
+    auto forgetReplaced = [this, &replacedPath](const QString& mimeTypeName) {
+        if (!replacedPath.isEmpty()) {
+            forgetFile(replacedPath, isWantedMimeType(mimeTypeName) ? mimeTypeName :
+                       mMimeDB.mimeTypeForFile(replacedPath, QMimeDatabase::MatchExtension).name());
+        }
+    };
+
+    int fd = open(stdPath.c_str(), O_RDONLY | O_CLOEXEC | O_NOFOLLOW);
+    if (fd < 0) {
+        forgetReplaced(QString());
+        return;
+    }
+
+    if (!MediaSniffer::fileKey(fd, key)) {
+        close(fd);
+        forgetReplaced(QString());
+        return;
+    }
+
+    /* 先查缓存，再用文件头快速识别常见图片/视频格式，都不命中才交给QMimeDatabase */
+    // already reported in this or an earlier run and unchanged since
+    const uint64_t hash = MediaIndex::hashPath(stdPath);
+    MediaIndex::Entry entry;
+    if (mIndex.find(hash, entry) && entry.type == MediaIndex::ENTRY_FILE &&
+        (entry.flags & MediaIndex::FLAG_NOTIFIED) && entry.ino == key.ino &&
+        entry.mtimeNs == key.mtimeSec * 1000000000ll + key.mtimeNsec && entry.size == key.size) {
+        close(fd);
+        forgetReplaced(QString());
+        return;
+    }
+
+    if (!mSniffer.lookup(key, mimeType)) {
+        ssize_t n = pread(fd, magic, sizeof(magic), 0);
+        const char* type = (n > 0) ? MediaSniffer::classify(magic, (size_t)n) : nullptr;
+        if (type) {
+            mimeType = type;
+        } else {
+            mimeType = mMimeDB.mimeTypeForFile(path, QMimeDatabase::MatchContent).name().toStdString();
+        }
+        mSniffer.store(key, mimeType);
+    }
+    close(fd);
+
+    const QString mimeTypeName = QString::fromStdString(mimeType);
+    forgetReplaced(mimeTypeName);
+    if (isWantedMimeType(mimeTypeName)) {
+        entry.type = MediaIndex::ENTRY_FILE;
+        /* manager确认收到后才置FLAG_NOTIFIED，见markDelivered() */
+        entry.flags = MediaIndex::FLAG_SENT;
+        entry.ino = key.ino;
+        entry.mtimeNs = key.mtimeSec * 1000000000ll + key.mtimeNsec;
+        entry.size = key.size;
+        entry.children.clear();
+        // lets a directory moved away withdraw its files, see removeFiles()
+        const size_t slash = stdPath.rfind('/');
+        entry.parent = MediaIndex::hashPath(stdPath.data(), slash);
+        entry.name = stdPath.substr(slash + 1);
+        mIndex.put(hash, entry);
+    }
+
+    postListEvent(ListEvent::SNIFFED, path, mimeTypeName);
 }
 
 void FileInotifyService::loopList()
 {
     struct stat sb;
+    std::vector<TimerWheel<QString>::Expired> expired;
+    QStringList ready;
 
     while (!mStopList) {
-        usleep(100 * 1000);
+        takeListEvents();
 
-        {
-            QMutexLocker _l(&mListLock);
-            QMutableListIterator<NotifyFileInfo> i(mFileList);
-            while (i.hasNext()) {
-                NotifyFileInfo& info = i.next();
-
-                if (stat(info.path.toStdString().c_str(), &sb) != 0) {
-                    i.remove();
-                    continue;
-                }
+        const quint64 now = mListClock.elapsed();
+
+        expired.clear();
+        mSettleWheel.advance(now, expired);
+        for (const TimerWheel<QString>::Expired& entry : expired) {
+            auto it = mPendingFiles.find(entry.first);
+            if (it == mPendingFiles.end() || it.value().tick != entry.second) {
+                continue;
+            }
+
+            NotifyFileInfo& info = it.value();
+            if (stat(info.path.toStdString().c_str(), &sb) != 0) {
+                mPendingFiles.erase(it);
+                continue;
+            }
 
-                if (sb.st_size != info.size) {
-                    info.size = sb.st_size;
-                    continue;
+            // still growing, check again once it has been quiet for a while
+            if (sb.st_size != info.size) {
+                info.size = sb.st_size;
+                scheduleFile(info, FILE_SETTLE_MS);
+                continue;
+            }
+
+            mReadyFiles.insert(info.path);
+            mPendingFiles.erase(it);
+        }
+
+        // removals first, DBusClient cancels a tombstone by a later record
+        for (const QPair<QString, QString>& file : mRemovedFiles) {
+            mDBusClient->removeFile(androidPathOf(file.first), file.second);
+        }
+        mRemovedFiles.clear();
+
+        for (const QPair<QString, QString>& file : mSniffedFiles) {
+            notifyFile(file.first, file.second);
+        }
+        mSniffedFiles.clear();
+
+        if (!mReadyFiles.isEmpty()) {
+            ready = mReadyFiles.values();
+            mReadyFiles.clear();
+
+            // the first query is a blocking D-Bus call, producers do not wait for it
+            if (mDBusClient->queryService()) {
+                // content sniffing reads the files, keep it off this thread
+                for (const QString& path : ready) {
+                    mSniffPool.start(new SniffTask(this, path, mRenamedFiles.take(path)));
                 }
+                continue;
+            }
 
-                if (notifyFile(info)) {
-                    i.remove();
-                    continue;
+            /* 服务未就绪时稍后重试 */
+            for (const QString& path : ready) {
+                if (!mPendingFiles.contains(path) && !mReadyFiles.contains(path)) {
+                    auto it = mPendingFiles.insert(path, { path, -1, 0 });
+                    scheduleFile(it.value(), NOTIFY_RETRY_MS);
                 }
             }
+            continue;
         }
+
+        // records are sent in batches, wake up again when the batch is due
+        qint64 timeout = mSettleWheel.nextTimeout(mListClock.elapsed());
+        const int flushTimeout = mDBusClient->flushIfDue();
+        if (flushTimeout >= 0 && (timeout < 0 || flushTimeout < timeout)) {
+            timeout = flushTimeout;
+        }
+        // going idle, persist what was reported so far
+        if (timeout < 0) {
+            mIndex.flush();
+        }
+
+        if (timeout == 0) {
+            continue;
+        }
+
+        QMutexLocker _l(&mListLock);
+        mListSleeping = true;
+        if (mListQueue.empty() && !mStopList) {
+            if (timeout < 0) {
+                mListCond.wait(&mListLock);
+            } else {
+                mListCond.wait(&mListLock, (unsigned long)timeout);
+            }
+        }
+        mListSleeping = false;
     }
+
+    mDBusClient->flush();
+    mIndex.flush();
 }
 
 } // namespace kmre
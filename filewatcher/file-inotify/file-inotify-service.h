@@ -24,35 +24,159 @@
 #include <atomic>
 #include <set>
 #include <string>
+#include <unordered_map>
+#include <vector>
 
+#include <stdint.h>
+
+#include <time.h>
 #include <sys/types.h>
 
 #include <QMutex>
+#include <QWaitCondition>
 #include <QMimeDatabase>
 #include <QList>
+#include <QHash>
+#include <QSet>
+#include <QStringList>
+#include <QElapsedTimer>
+#include <QPair>
+#include <QThreadPool>
 
 #include "file-inotify-watcher.h"
+#include "file-fanotify-watcher.h"
+#include "media-index.h"
+#include "media-sniffer.h"
+#include "mpsc-queue.h"
+#include "path-filter.h"
+#include "timer-wheel.h"
+#include "watch-budget.h"
+#include "watch-engine.h"
 #include "utils.h"
 
 
 namespace kmre {
 
 class DBusClient;
+class SniffTask;
+class IndexDirCache;
 
 struct NotifyFileInfo
 {
     QString path;
-    int size;
+    qint64 size;
+    // tick of the latest settle timer, older wheel entries are stale
+    quint64 tick;
+};
+
+// What the watcher, scan and sniff threads hand to the list thread
+struct ListEvent
+{
+    enum Type {
+        // report path once its size settles
+        PENDING,
+        // report path now
+        READY,
+        // path was closed after writing
+        WRITTEN,
+        // detail: MIME type found by content
+        SNIFFED,
+        // detail: MIME type of the record to remove
+        REMOVED,
+        // the manager took the record of path
+        DELIVERED,
+        // the manager did not answer for the record of path, send it again
+        UNDELIVERED,
+    };
+
+    ListEvent()
+        : type(PENDING)
+    {
+    }
+
+    ListEvent(Type t, const QString& p, const QString& d)
+        : type(t),
+          path(p),
+          detail(d)
+    {
+    }
+
+    Type type;
+    QString path;
+    // PENDING/READY: the path the file was renamed from, if any
+    QString detail;
+};
+
+// What the WatchEngine thread hands to the poll thread, which applies it
+// to the watcher state under mWatcherLock
+struct WatchWork
+{
+    enum Type {
+        EVENT,
+        // events were lost, pick up the changes from the directories
+        RESCAN,
+        BATCH_END,
+    };
+
+    WatchWork()
+        : type(EVENT),
+          wd(-1),
+          mask(0),
+          cookie(0)
+    {
+    }
+
+    explicit WatchWork(Type t)
+        : type(t),
+          wd(-1),
+          mask(0),
+          cookie(0)
+    {
+    }
+
+    Type type;
+    // EVENT: the inotify event and the watched path it came for
+    int wd;
+    uint32_t mask;
+    uint32_t cookie;
+    std::string path;
+    std::string name;
 };
 
-class FileInotifyService
+class FileInotifyService : public WatchHandler
 {
 public:
     int initialize();
     void start();
 
     int addWatch(const QString& path);
-    int addWatchRecursively(const QString& path, bool shouldNotifyFile = false);
+    // Settled by the first addWatchRecursively(). Roots added after start()
+    // are only safe with inotify, fanotify may still fall back.
+    bool usesFanotify() const { return mUseFanotify; }
+    // Safe while the inotify backend runs: the walk holds mWatcherLock, and
+    // the queued engine events are applied under it after the walk. stop,
+    // if given, cuts the walk short.
+    int addWatchRecursively(const QString& path, bool shouldNotifyFile = false,
+                            const std::atomic<bool>* stop = nullptr);
+    // Replace the exclusion rules and the MIME allow-list (image/* and
+    // video/* by default). Call before the first addWatch*().
+    void setFilter(const QStringList& excludes, const QStringList& mimeTypes);
+
+    struct WatchStats
+    {
+        bool fanotify;
+        // media directories with an inotify watch (fanotify: marks)
+        int watched;
+        // media directories checked by mtime instead
+        int polled;
+        // watches the media tree may use, 0 if unlimited
+        int budget;
+        // fs.inotify.max_user_watches
+        int limit;
+        // inotify watches of the process, every role
+        int total;
+    };
+    WatchStats watchStats();
 
     static FileInotifyService* getInstance();
 
@@ -60,18 +184,75 @@ private:
     FileInotifyService();
     ~FileInotifyService();
 
-    void addNotifyFile(const QString& path);
-    void addNotifyFileLocked(const QString& path);
+    // complete: the file was moved in or closed after writing and can be
+    // reported at once, otherwise it waits until its size settles
+    void addNotifyFile(const QString& path, bool complete = false);
+    // replacedPath: the file was renamed from there, its record goes away
+    // once the new one is sniffed. Returns false if path is not of interest.
+    bool addNotifyFileLocked(const QString& path, bool complete = false,
+                             const QString& replacedPath = QString());
+    void markFileWritten(const QString& path);
+    // never blocks, wakes the list thread if it sleeps
+    void postListEvent(ListEvent::Type type, const QString& path, const QString& detail = QString());
 
-    bool notifyFile(const NotifyFileInfo& info);
+    // list thread only
+    void takeListEvents();
+    void scheduleFile(NotifyFileInfo& info, quint64 delayMs);
+    void notifyFile(const QString& path, const QString& mimeTypeName);
+    bool isWantedMimeType(const QString& mimeTypeName) const;
+    // drop path from the index and queue the removal of its record
+    void forgetFile(const QString& path, const QString& mimeTypeName);
+    // whether a record of path may exist on the Android side
+    bool wasNotified(const QString& path);
+    // the manager answered for the record of path: keep FLAG_NOTIFIED only
+    // when it took it
+    void markDelivered(const QString& path, bool delivered);
+    // runs on mSniffPool, hands the result back to the list thread
+    void sniffFile(const QString& path, const QString& replacedPath);
 
     void stop();
     void wait();
-    void run();
+    // inotify backend, called on the WatchEngine thread for WATCH_ROLE_MEDIA.
+    // They only queue the event: the engine thread serves the other roles
+    // too and must not wait for a walk holding mWatcherLock.
+    void onWatchEvent(int role, const std::string& path, const struct inotify_event* event) override;
+    void onWatchOverflow(int role) override;
+    void onWatchBatchEnd(int role) override;
+    void postWatchWork(WatchWork&& work);
+    // poll thread, applies the queued engine events in order
+    void takeWatchWorkLocked();
+    void handleWatchEventLocked(const WatchWork& work);
+    void handleWatchBatchEndLocked();
+    void runFanotify();
     void loopList();
+    void loopPoll();
 
-    int addWatchLocked(const QString& path);
-    void watchAndNotifyDirectoryRecursivelyLocked(const QString& path, bool shouldNotifyFile);
+    // lastActive: when the directory last saw changes, 0 for scans. Over
+    // the budget the directory may be polled instead of watched.
+    int addWatchLocked(const QString& path, quint64 lastActive = 0);
+    void pollDirectoryLocked(const std::string& path);
+    void pollDirectoriesLocked();
+    // report files changed since sinceNs in dir, walk new subdirectories
+    void rescanDirectoryLocked(const std::string& dir, int64_t sinceNs);
+    // coarse clock for WatchBudget, in seconds and never 0
+    quint64 activeTime() const { return (quint64)mListClock.elapsed() / 1000 + 1; }
+    // threads: 1 walks in the calling thread (small trees found at runtime),
+    // 0 uses every CPU (initial scan)
+    void watchAndNotifyDirectoryRecursivelyLocked(const QString& path, bool shouldNotifyFile,
+                                                  bool shouldWatch = true, int threads = 1,
+                                                  const std::atomic<bool>* stop = nullptr);
+    void fallBackToInotifyLocked();
+    // after IN_Q_OVERFLOW, pick up what changed in watched dirs since then
+    void rescanChangedDirectoriesLocked(time_t since);
+    // from and to are the two halves of one move inside the watched tree
+    void renameLocked(const std::string& from, const std::string& to, bool isDir);
+    void renameFileLocked(const QString& from, const QString& to);
+    // path was deleted or moved out of the watched tree
+    void forgetPathLocked(const std::string& path, bool isDir);
+    // carry the directory entries below from over to to, or drop them if
+    // to is empty; the old paths are appended to dirs when given
+    void moveIndexTree(const std::string& from, const std::string& to, std::vector<std::string>* dirs = nullptr);
+    int watchCount();
 
     static FileInotifyService* m_pInstance;
 
@@ -91,18 +272,76 @@ private:
     static QMutex lock;
 
     QMutex mWatcherLock;
-    QMutex mListLock;
     std::atomic<bool> mInitialized;
     std::atomic<bool> mIsRunning;
     std::atomic<bool> mIsThreadRunning;
     std::thread mWatcherThread;
     std::thread mListThread;
+    std::thread mPollThread;
     bool mStopWatcher;
-    bool mStopList;
-    FileInotifyWatcher mWatcher;
+    std::atomic<bool> mStopList;
+    /* inotify监控与FileWatcher等共用同一个WatchEngine实例 */
+    WatchEngine* mEngine;
+    // reused for every event, so resolving the parent costs no allocation
+    std::string mEventPath;
+    time_t mLastBatch;
+    struct MovedFrom
+    {
+        std::string path;
+        bool isDir;
+        quint64 batch;
+    };
+    /* 按cookie配对IN_MOVED_FROM/IN_MOVED_TO，只在poll线程访问 */
+    std::unordered_map<uint32_t, MovedFrom> mMovedFrom;
+    quint64 mBatchSeq;
+    // last directory touched in mBudget, saves the lookup for event bursts
+    std::string mTouchedPath;
+    quint64 mTouchedAt;
+    /* inotify监控数超出预算时，冷目录改为定时检查mtime */
+    WatchBudget mBudget;
+    size_t mWatchLimit;
+    time_t mBudgetShrunkAt;
+    /* 优先使用fanotify整盘监控，不具备权限时回退到inotify */
+    FileFanotifyWatcher mFanotify;
+    std::atomic<bool> mUseFanotify;
+    QStringList mRoots;
+    QElapsedTimer mStartupTimer;
     QMimeDatabase mMimeDB;
     DBusClient* mDBusClient;
-    QList<NotifyFileInfo> mFileList;
+    /* 各线程无锁投递事件，由list线程独占处理 */
+    MpscQueue<ListEvent> mListQueue;
+    // set by the list thread before it waits on mListCond
+    std::atomic<bool> mListSleeping;
+    // only guards the sleeps of the list and poll threads
+    QMutex mListLock;
+    QWaitCondition mListCond;
+    QWaitCondition mPollCond;
+    /* 引擎线程投递的media事件，由poll线程持mWatcherLock处理 */
+    MpscQueue<WatchWork> mWatchQueue;
+    std::atomic<int> mWatchQueued;
+    // events were dropped over WATCH_QUEUE_MAX, rescan like on IN_Q_OVERFLOW
+    std::atomic<bool> mWatchDropped;
+    // set by the poll thread before it waits on mPollCond
+    std::atomic<bool> mPollSleeping;
+    QElapsedTimer mListClock;
+    /* 以下由list线程独占：待稳定的文件由时间轮定时检查，写完关闭或移入的文件直接上报 */
+    QHash<QString, NotifyFileInfo> mPendingFiles;
+    QSet<QString> mReadyFiles;
+    TimerWheel<QString> mSettleWheel;
+    QList<QPair<QString, QString>> mSniffedFiles;
+    // new path -> old path of renamed files not handed to a sniffer yet
+    QHash<QString, QString> mRenamedFiles;
+    // (path, mime type) of records to remove
+    QList<QPair<QString, QString>> mRemovedFiles;
+    MediaSniffer mSniffer;
+    /* 持久化索引(~/.kmre)：跳过未变化的目录，避免重复上报 */
+    MediaIndex mIndex;
+    /* 排除规则与MIME白名单，启动前设置，之后只读 */
+    PathFilter mFilter;
+    QThreadPool mSniffPool;
+
+    friend class SniffTask;
+    friend class IndexDirCache;
 
     DISALLOW_COPY_AND_ASSIGN(FileInotifyService);
 };
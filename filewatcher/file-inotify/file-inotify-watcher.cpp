@@ -20,10 +20,14 @@
 #include "file-inotify-watcher.h"
 #include "utils.h"
 
+#include <algorithm>
+#include <iterator>
+
 #include <sys/stat.h>
 #include <sys/types.h>
 #include <sys/syslog.h>
 #include <sys/poll.h>
+#include <stdint.h>
 #include <string.h>
 #include <unistd.h>
 #include <fcntl.h>
@@ -36,11 +40,11 @@ namespace kmre {
 FileInotifyWatcher::FileInotifyWatcher()
     : mInotifyFd(-1),
       mInitialized(false),
+      mLimitReported(false),
       mLock(QMutex::Recursive),
-      mCurrentPosition(0),
-      mTotalRead(0)
+      mPending(0),
+      mPendingOffset(0)
 {
-    memset(mCurrentEvent, 0, CURRENT_EVENT_SIZE);
     memset(mEventBuffer, 0, EVENT_BUFFER_SIZE);
 }
 
@@ -59,7 +63,7 @@ int FileInotifyWatcher::initialize()
         return 0;
     }
 
-    mInotifyFd = inotify_init1(IN_CLOEXEC);
+    mInotifyFd = inotify_init1(IN_CLOEXEC | IN_NONBLOCK);
     if (mInotifyFd < 0) {
         syslog(LOG_WARNING, "FileInotifyWatcher: Failed to init inotify: %s", strerror(errno));
         return -1;
@@ -77,23 +81,21 @@ void FileInotifyWatcher::cleanup()
 
     {
         QMutexLocker lock(&mLock);
-        auto it = mWdToPathMap.begin();
-        while (it != mWdToPathMap.end()) {
-            inotify_rm_watch(mInotifyFd, it.key());
-            it++;
-        }
-
-        mWdToPathMap.clear();
-        mPathToWdMap.clear();
+        mIndex.forEachWd([this](int wd) {
+            inotify_rm_watch(mInotifyFd, wd);
+        });
+        mIndex.clear();
     }
 
     close(mInotifyFd);
     mInotifyFd = -1;
+    mPending = 0;
+    mPendingOffset = 0;
 
     mInitialized = false;
 }
 
-int FileInotifyWatcher::addWatch(const QString &path, int mask)
+int FileInotifyWatcher::addWatch(const QString &path, int mask, int role)
 {
     int wd;
 
@@ -103,27 +105,91 @@ int FileInotifyWatcher::addWatch(const QString &path, int mask)
 
     QMutexLocker lock(&mLock);
 
-    auto it = mPathToWdMap.find(path);
-    if (it != mPathToWdMap.end()) {
-        return 0;
+    const std::string stdPath = path.toStdString();
+    const unsigned roleMask = (unsigned)mask & ~IN_MASK_ADD;
+    WatchIndex::Node* node = mIndex.find(stdPath);
+    if (node && node->wd >= 0 && (node->roles & WATCH_ROLE_BIT(role))) {
+        if (node->masks[role] != roleMask) {
+            node->masks[role] = roleMask;
+            applyMaskLocked(node);
+        }
+        return node->wd;
     }
 
-    wd = inotify_add_watch(mInotifyFd, path.toStdString().c_str(), mask);
+    /* 同一inode可能已被其他角色监控，IN_MASK_ADD保留其原有的事件 */
+    wd = inotify_add_watch(mInotifyFd, stdPath.c_str(), mask | IN_MASK_ADD);
     if (wd < 0) {
-        return -1;
+        const int err = errno;
+        if (err == ENOSPC && !mLimitReported) {
+            mLimitReported = true;
+            syslog(LOG_WARNING, "FileInotifyWatcher: fs.inotify.max_user_watches reached at %u watches.",
+                   (unsigned)mIndex.watchCount());
+        }
+        return -err;
+    }
+
+    if (!node) {
+        node = mIndex.intern(stdPath);
     }
+    if (node->wd != wd) {
+        // the path now names another inode, its old watch is stale
+        if (node->wd >= 0) {
+            int oldWd = node->wd;
+            if (mIndex.unbind(node)) {
+                inotify_rm_watch(mInotifyFd, oldWd);
+            }
+        }
+        mIndex.bind(node, wd);
+    }
+    node->roles |= WATCH_ROLE_BIT(role);
+    node->masks[role] = roleMask;
 
-    mWdToPathMap.insert(wd, path);
-    mPathToWdMap[path] = wd;
+    return wd;
+}
 
-    return 0;
+unsigned FileInotifyWatcher::maskOfLocked(int wd)
+{
+    unsigned mask = 0;
+
+    for (const WatchIndex::Node* node = mIndex.lookup(wd); node; node = node->nextAlias) {
+        for (int role = 0; role < WATCH_ROLE_COUNT; role++) {
+            if (node->roles & WATCH_ROLE_BIT(role)) {
+                mask |= node->masks[role];
+            }
+        }
+    }
+
+    return mask;
+}
+
+void FileInotifyWatcher::applyMaskLocked(WatchIndex::Node* node)
+{
+    std::string path;
+
+    if (!node || node->wd < 0) {
+        return;
+    }
+
+    /* 不带IN_MASK_ADD时内核用新mask替换原有mask，退订的事件不再产生 */
+    const unsigned mask = maskOfLocked(node->wd);
+    if ((mask & IN_ALL_EVENTS) == 0) {
+        return;
+    }
+    WatchIndex::pathOf(node, path);
+    int wd = inotify_add_watch(mInotifyFd, path.c_str(), mask);
+    if (wd >= 0 && wd != node->wd) {
+        // the path names another inode by now, undo what the call did there
+        if (mIndex.lookup(wd)) {
+            inotify_add_watch(mInotifyFd, path.c_str(), maskOfLocked(wd));
+        } else {
+            inotify_rm_watch(mInotifyFd, wd);
+        }
+    }
 }
 
-int FileInotifyWatcher::removeWatch(const QString &path)
+int FileInotifyWatcher::removeWatch(const QString &path, int role)
 {
     int wd = -1;
-    int count = 0;
-    int i = 0;
     int ret = 0;
 
     if (!mInitialized) {
@@ -132,39 +198,36 @@ int FileInotifyWatcher::removeWatch(const QString &path)
 
     QMutexLocker lock(&mLock);
 
-    auto pathIter = mPathToWdMap.find(path);
-    if (pathIter != mPathToWdMap.end()) {
-        wd = pathIter.value();
-        pathIter = mPathToWdMap.erase(pathIter);
-    }
-
-    if (wd == -1) {
+    WatchIndex::Node* node = mIndex.find(path.toStdString());
+    if (!node || node->wd < 0 || !(node->roles & WATCH_ROLE_BIT(role))) {
         return -1;
     }
 
-    count = mWdToPathMap.count(wd);
-    auto wdIter = mWdToPathMap.find(wd);
-    for (i = 0; i < count; i++) {
-        if (strcmp(wdIter.value().toStdString().c_str(), path.toStdString().c_str()) == 0) {
-            wdIter = mWdToPathMap.erase(wdIter);
-        } else {
-            wdIter++;
-        }
+    node->roles &= ~WATCH_ROLE_BIT(role);
+    node->masks[role] = 0;
+    if (node->roles != 0) {
+        applyMaskLocked(node);
+        return 0;
     }
 
-    if (mWdToPathMap.count(wd) == 0) {
+    wd = node->wd;
+    if (mIndex.unbind(node)) {
         ret = inotify_rm_watch(mInotifyFd, wd);
+    } else {
+        // other paths still hold the inode
+        applyMaskLocked(mIndex.lookup(wd));
     }
+    mIndex.prune(node);
 
     return ret;
 }
 
 int FileInotifyWatcher::removeWatch(int wd)
 {
-    QString path;
+    std::string path;
     int ret = 0;
-    int count = 0;
-    int i = 0;
+    bool last = false;
+    bool removed = false;
 
     if (!mInitialized) {
         return -1;
@@ -176,121 +239,312 @@ int FileInotifyWatcher::removeWatch(int wd)
 
     QMutexLocker lock(&mLock);
 
-    count = mWdToPathMap.count(wd);
-    auto wdIter = mWdToPathMap.find(wd);
-
-    for (i = 0; i < count; i++) {
-        path = wdIter.value();
-        if (!isPathDir(path.toStdString().c_str())) {
-            wdIter = mWdToPathMap.erase(wdIter);
-            auto pathIter = mPathToWdMap.find(path);
-            if (pathIter != mPathToWdMap.end()) {
-                pathIter = mPathToWdMap.erase(pathIter);
-            }
-        } else {
-            wdIter++;
+    /* 同一wd可能对应多个路径（如目录被移动到监控树内的新位置），只移除已失效的路径 */
+    WatchIndex::Node* node = mIndex.lookup(wd);
+    while (node) {
+        WatchIndex::Node* next = node->nextAlias;
+        WatchIndex::pathOf(node, path);
+        if (!isPathDir(path.c_str())) {
+            node->roles = 0;
+            last = mIndex.unbind(node);
+            mIndex.prune(node);
+            removed = true;
         }
+        node = next;
     }
 
-    if (mWdToPathMap.count(wd) == 0) {
+    if (last) {
         ret = inotify_rm_watch(mInotifyFd, wd);
+    } else if (removed) {
+        applyMaskLocked(mIndex.lookup(wd));
     }
 
     return ret;
 }
 
-QString FileInotifyWatcher::watchedPathFromWd(int wd)
+void FileInotifyWatcher::forgetWatch(int wd)
 {
-    QString path;
-    int count = 0;
-    int i = 0;
+    if (!mInitialized || wd < 0) {
+        return;
+    }
 
-    if (!mInitialized) {
-        return path;
+    QMutexLocker lock(&mLock);
+
+    /* 目录被删除后可能已按原名重建，wd已失效，不能按路径是否为目录判断 */
+    WatchIndex::Node* node = mIndex.lookup(wd);
+    while (node) {
+        WatchIndex::Node* next = node->nextAlias;
+        node->roles = 0;
+        std::fill(std::begin(node->masks), std::end(node->masks), 0u);
+        mIndex.unbind(node);
+        mIndex.prune(node);
+        node = next;
     }
+}
 
-    if (wd < 0) {
-        return path;
+int FileInotifyWatcher::removeWatchTree(const QString& path, int role, std::vector<std::string>* removed)
+{
+    int ret = 0;
+
+    if (!mInitialized) {
+        return -1;
     }
 
     QMutexLocker lock(&mLock);
 
-    count = mWdToPathMap.count(wd);
-    auto wdIter = mWdToPathMap.find(wd);
+    WatchIndex::Node* root = mIndex.find(path.toStdString());
+    if (!root) {
+        return -1;
+    }
 
-    for (i = 0; i < count; i++) {
-        QString tmp = wdIter.value();
-        if (isPathDir(tmp.toStdString().c_str())) {
-            path = tmp;
-            break;
+    mIndex.forEachNode(root, [this, &ret, role, removed](WatchIndex::Node* node) {
+        if (node->wd < 0 || !(node->roles & WATCH_ROLE_BIT(role))) {
+            return;
+        }
+        if (removed) {
+            removed->emplace_back();
+            WatchIndex::pathOf(node, removed->back());
         }
 
-        wdIter++;
+        node->roles &= ~WATCH_ROLE_BIT(role);
+        node->masks[role] = 0;
+        if (node->roles != 0) {
+            applyMaskLocked(node);
+            return;
+        }
+
+        int wd = node->wd;
+        if (!mIndex.unbind(node)) {
+            applyMaskLocked(mIndex.lookup(wd));
+        } else if (inotify_rm_watch(mInotifyFd, wd) < 0) {
+            ret = -1;
+        }
+    });
+    mIndex.pruneTree(root);
+
+    return ret;
+}
+
+bool FileInotifyWatcher::moveWatch(const QString& path, const QString& newPath)
+{
+    if (!mInitialized) {
+        return false;
     }
 
-    return path;
+    QMutexLocker lock(&mLock);
+
+    /* 目录改名后inode不变，原有的wd继续有效，只需更新路径 */
+    return mIndex.move(mIndex.find(path.toStdString()), newPath.toStdString());
 }
 
-int FileInotifyWatcher::wdFromWatchedPath(const QString &path)
+QString FileInotifyWatcher::watchedPathFromWd(int wd)
 {
-    int wd = -1;
+    std::string path;
+
+    if (!watchedPathFromWd(wd, path)) {
+        return QString();
+    }
+
+    return QString::fromStdString(path);
+}
+
+bool FileInotifyWatcher::watchedPathFromWd(int wd, std::string& path)
+{
+    if (!mInitialized) {
+        return false;
+    }
+
+    if (wd < 0) {
+        return false;
+    }
+
+    QMutexLocker lock(&mLock);
+
+    const WatchIndex::Node* node = mIndex.lookup(wd);
+    if (!node) {
+        return false;
+    }
+
+    WatchIndex::pathOf(node, path);
+    return true;
+}
 
+int FileInotifyWatcher::wdFromWatchedPath(const QString &path)
+{
     if (!mInitialized) {
         return -1;
     }
 
     QMutexLocker lock(&mLock);
 
-    auto pathIter = mPathToWdMap.find(path);
-    if (pathIter != mPathToWdMap.end()) {
-        wd = pathIter.value();
+    const WatchIndex::Node* node = mIndex.find(path.toStdString());
+    return node ? node->wd : -1;
+}
+
+size_t FileInotifyWatcher::watchTargetsFromWd(int wd, std::vector<WatchTarget>& targets)
+{
+    size_t count = 0;
+
+    if (!mInitialized || wd < 0) {
+        return 0;
     }
 
-    return wd;
+    QMutexLocker lock(&mLock);
+
+    for (const WatchIndex::Node* node = mIndex.lookup(wd); node; node = node->nextAlias) {
+        if (count == targets.size()) {
+            targets.emplace_back();
+        }
+        WatchIndex::pathOf(node, targets[count].path);
+        targets[count].roles = node->roles;
+        for (int role = 0; role < WATCH_ROLE_COUNT; role++) {
+            targets[count].masks[role] = (node->roles & WATCH_ROLE_BIT(role)) ? node->masks[role] : 0;
+        }
+        count++;
+    }
+
+    return count;
+}
+
+size_t FileInotifyWatcher::watchCount()
+{
+    QMutexLocker lock(&mLock);
+    return mIndex.watchCount();
 }
 
-struct inotify_event* FileInotifyWatcher::readNextEvent(int timeout)
+QStringList FileInotifyWatcher::watchedPaths(int role)
+{
+    QStringList paths;
+    std::string path;
+
+    QMutexLocker lock(&mLock);
+
+    mIndex.forEachWd([this, &paths, &path, role](int wd) {
+        for (const WatchIndex::Node* node = mIndex.lookup(wd); node; node = node->nextAlias) {
+            if (role >= 0 && !(node->roles & WATCH_ROLE_BIT(role))) {
+                continue;
+            }
+            WatchIndex::pathOf(node, path);
+            paths.append(QString::fromStdString(path));
+        }
+    });
+
+    return paths;
+}
+
+int FileInotifyWatcher::readEvents(int timeout, std::vector<struct inotify_event*>& events)
 {
     struct pollfd pollfds[1];
+    int total = 0;
+    int offset = 0;
     int ret = 0;
-    struct inotify_event* e = nullptr;
+
+    events.clear();
 
     if (!mInitialized) {
-        return nullptr;
+        return -1;
     }
 
-    if (mCurrentPosition == mTotalRead) {
-        // no event in buffer now, read new events.
-        mTotalRead = 0;
-        mCurrentPosition = 0;
+    // the previous batch is released now, move its incomplete tail to the head
+    if (mPending > 0) {
+        memmove(mEventBuffer, mEventBuffer + mPendingOffset, mPending);
+    }
+    total = mPending;
+    mPending = 0;
 
-        pollfds[0].fd = mInotifyFd;
-        pollfds[0].events = POLLIN;
+    pollfds[0].fd = mInotifyFd;
+    pollfds[0].events = POLLIN;
+
+    ret = poll(pollfds, 1, timeout);
+    if (ret <= 0) {
+        return (ret < 0 && errno != EINTR) ? -1 : 0;
+    }
 
-        ret = poll(pollfds, 1, timeout);
+    /* 尽量把队列读空，突发事件（如解压图片包）可在同一批内合并处理 */
+    while (EVENT_BUFFER_SIZE - total >= (int)MAX_EVENT_SIZE) {
+        ret = read(mInotifyFd, mEventBuffer + total, EVENT_BUFFER_SIZE - total);
         if (ret <= 0) {
-            return nullptr;
+            if (ret < 0 && errno == EINTR) {
+                continue;
+            }
+            break;
         }
+        total += ret;
+    }
 
-        mTotalRead = read(mInotifyFd, mEventBuffer, EVENT_BUFFER_SIZE);
-        if (mTotalRead < 0) {
-            mTotalRead = 0;
-            mCurrentPosition = 0;
-            return nullptr;
+    while (offset + (int)EVENT_SIZE <= total) {
+        struct inotify_event* e = (struct inotify_event*)&mEventBuffer[offset];
+        if (offset + (int)(EVENT_SIZE + e->len) > total) {
+            break;
         }
+        events.push_back(e);
+        offset += EVENT_SIZE + e->len;
     }
 
-    e = (struct inotify_event*)&mEventBuffer[mCurrentPosition];
-    if ((int)(mCurrentPosition + EVENT_SIZE + e->len) > mTotalRead) {
-        mCurrentPosition = 0;
-        mTotalRead = 0;
-        return nullptr;
+    coalesce(events);
+
+    // the kernel only hands out whole records, but never drop a tail
+    mPending = total - offset;
+    mPendingOffset = offset;
+
+    return (int)events.size();
+}
+
+void FileInotifyWatcher::coalesce(std::vector<struct inotify_event*>& events)
+{
+    size_t size = 16;
+    size_t kept = 0;
+
+    if (events.size() < 2) {
+        return;
     }
 
-    memcpy(mCurrentEvent, &mEventBuffer[mCurrentPosition], EVENT_SIZE + e->len);
-    mCurrentPosition += (EVENT_SIZE + e->len);
+    while (size < events.size() * 2) {
+        size <<= 1;
+    }
+    mCoalesceSlots.assign(size, -1);
+
+    for (size_t i = 0; i < events.size(); i++) {
+        struct inotify_event* e = events[i];
+        // moves are paired by cookie, keep every half of them
+        if (e->cookie != 0) {
+            events[kept++] = e;
+            continue;
+        }
+
+        const char* name = e->len > 0 ? e->name : "";
+        // FNV-1a over wd and name
+        uint32_t hash = 2166136261u ^ (uint32_t)e->wd;
+        for (const char* c = name; *c; c++) {
+            hash = (hash ^ (unsigned char)*c) * 16777619u;
+        }
+
+        /* 删除后立即重建同名文件（编辑器、相机保存）时不能合并为一个事件 */
+        const bool boundary = (e->mask & (IN_CREATE | IN_DELETE | IN_DELETE_SELF | IN_MOVE_SELF |
+                                          IN_IGNORED | IN_UNMOUNT)) != 0;
+        size_t slot = hash & (size - 1);
+        bool merged = false;
+        while (mCoalesceSlots[slot] >= 0) {
+            struct inotify_event* first = events[mCoalesceSlots[slot]];
+            if (first->wd == e->wd &&
+                strcmp(first->len > 0 ? first->name : "", name) == 0) {
+                if (!boundary) {
+                    first->mask |= e->mask;
+                    merged = true;
+                }
+                break;
+            }
+            slot = (slot + 1) & (size - 1);
+        }
+
+        if (!merged) {
+            // a boundary takes over the slot of the run it ends
+            mCoalesceSlots[slot] = (int)kept;
+            events[kept++] = e;
+        }
+    }
 
-    return (struct inotify_event*) mCurrentEvent;
+    events.resize(kept);
 }
 
 } // namespace kmre
@@ -21,23 +21,52 @@
 #define FILEINOTIFYWATCHER_H
 
 #include <atomic>
+#include <string>
+#include <vector>
 
 #include <sys/inotify.h>
 
 #include <QMutex>
-#include <QMap>
-#include <QMultiMap>
+#include <QString>
+#include <QStringList>
+
+#include "watch-index.h"
 
 #ifndef NAME_MAX
 #define NAME_MAX 255
 #endif
 
 #define EVENT_SIZE          (sizeof(struct inotify_event))
-#define CURRENT_EVENT_SIZE  (16 * (EVENT_SIZE + NAME_MAX + 1))
-#define EVENT_BUFFER_SIZE   (64 * (EVENT_SIZE + NAME_MAX + 1))
+#define MAX_EVENT_SIZE      (EVENT_SIZE + NAME_MAX + 1)
+#define EVENT_BUFFER_SIZE   (256 * MAX_EVENT_SIZE)
 
 namespace kmre {
 
+// Who subscribed a watch. Several roles may share one inotify watch, each
+// role only sees the events of the paths it subscribed.
+enum WatchRole
+{
+    WATCH_ROLE_MEDIA = 0,
+    WATCH_ROLE_NORMAL,
+    WATCH_ROLE_PENDING,
+    WATCH_ROLE_DEPEND,
+    WATCH_ROLE_LINK,
+    WATCH_ROLE_CHECK,
+    WATCH_ROLE_COUNT,
+};
+
+#define WATCH_ROLE_BIT(role) (1u << (role))
+
+static_assert(WATCH_ROLE_COUNT <= WATCH_INDEX_ROLES, "WatchIndex::Node cannot hold every role");
+
+struct WatchTarget
+{
+    std::string path;
+    unsigned roles;
+    // events each role subscribed on this path
+    unsigned masks[WATCH_ROLE_COUNT];
+};
+
 class FileInotifyWatcher
 {
 public:
@@ -47,27 +76,73 @@ public:
     int initialize();
     void cleanup();
 
-    int addWatch(const QString& path, int mask);
-    int removeWatch(const QString& path);
+    // Subscribe role to path; returns the wd, or -errno on error (-ENOSPC
+    // once fs.inotify.max_user_watches is used up). The kernel watch is
+    // shared with the other roles: its mask is the union of what they asked
+    // for and narrows again when a role drops out or asks for less.
+    int addWatch(const QString& path, int mask, int role = WATCH_ROLE_MEDIA);
+    // Drop role from path, the watch goes away with its last role.
+    int removeWatch(const QString& path, int role = WATCH_ROLE_MEDIA);
+    // Drop every path of wd that is no longer a directory, for all roles.
     int removeWatch(int wd);
+    // The kernel dropped wd (IN_IGNORED): forget every path bound to it,
+    // for all roles, even when the path names a directory again.
+    void forgetWatch(int wd);
+    // Drop role from path and from every watched path below it. The paths
+    // role was dropped from are appended to removed when given.
+    int removeWatchTree(const QString& path, int role = WATCH_ROLE_MEDIA,
+                        std::vector<std::string>* removed = nullptr);
+    // A watched directory was renamed: move path and the watches below it
+    // to newPath, for all roles. Fails if path is not known or newPath is.
+    bool moveWatch(const QString& path, const QString& newPath);
 
     QString watchedPathFromWd(int wd);
+    // Same as above but builds the path into a reusable buffer, no syscall
+    // or allocation once the buffer has grown.
+    bool watchedPathFromWd(int wd, std::string& path);
     int wdFromWatchedPath(const QString& path);
+    // Every path watched through wd with its roles, written into targets
+    // (entries are reused). Returns the number of entries filled.
+    size_t watchTargetsFromWd(int wd, std::vector<WatchTarget>& targets);
+    size_t watchCount();
+
+    // Wait up to timeout ms, then drain the queue into the read buffer.
+    // events points into that buffer and stays valid until the next call.
+    // Repeated (wd, name) events of a batch are merged into the first one
+    // with their masks or'ed. Returns the event count, 0 on timeout and -1
+    // on error.
+    int readEvents(int timeout, std::vector<struct inotify_event*>& events);
 
-    struct inotify_event* readNextEvent(int timeout = 1000);
+    // role < 0 lists the paths of every role
+    QStringList watchedPaths(int role = -1);
 
 private:
-    QMultiMap<int, QString> mWdToPathMap;
-    QMap<QString, int> mPathToWdMap;
+    WatchIndex mIndex;
     int mInotifyFd;
     std::atomic<bool> mInitialized;
+    // ENOSPC is logged once, callers decide what to do about it
+    bool mLimitReported;
 
     QMutex mLock;
 
-    int mCurrentPosition;
-    int mTotalRead;
-    unsigned char mCurrentEvent[CURRENT_EVENT_SIZE];
-    unsigned char mEventBuffer[EVENT_BUFFER_SIZE];
+    // union of the masks of every role on every path of wd
+    unsigned maskOfLocked(int wd);
+    // set the kernel mask of node's watch to maskOfLocked()
+    void applyMaskLocked(WatchIndex::Node* node);
+
+    // Merge the masks of repeated events for the same (wd, name). An event
+    // that creates or destroys the entry is never merged into an earlier
+    // one: it starts a new run that later events merge into, so a delete
+    // and a recreate of the same name keep their order.
+    void coalesce(std::vector<struct inotify_event*>& events);
+
+    // incomplete record left after the last batch, moved to the head of
+    // mEventBuffer once the caller is done with that batch
+    int mPending;
+    int mPendingOffset;
+    // event indexes hashed by (wd, name), reused between batches
+    std::vector<int> mCoalesceSlots;
+    alignas(struct inotify_event) unsigned char mEventBuffer[EVENT_BUFFER_SIZE];
 };
 
 } // namespace kmre
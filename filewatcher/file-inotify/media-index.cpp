@@ -0,0 +1,515 @@
+/*
+ * Copyright (c) KylinSoft Co., Ltd. 2016-2024.All rights reserved.
+ *
+ * Authors:
+ *  Ma Chao    machao@kylinos.cn
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "media-index.h"
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syslog.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+
+#define INDEX_MAGIC         "KMREIDX"
+#define INDEX_VERSION       2
+#define INDEX_HEADER_SIZE   16
+// buffered records are written once they reach this size or on flush()
+#define INDEX_WRITE_SIZE    (64 * 1024)
+// compact when dead records outnumber live ones and the log is this large
+#define INDEX_COMPACT_MIN   4096
+#define INDEX_ALIGN(n)      (((n) + 7) & ~((size_t)7))
+
+namespace kmre {
+
+struct IndexHeader
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t reserved;
+};
+
+struct IndexRecord
+{
+    // crc32 of the rest of the record including its payload
+    uint32_t crc;
+    uint32_t length;
+    uint64_t hash;
+    uint64_t ino;
+    int64_t mtimeNs;
+    int64_t size;
+    // hash of the parent directory of a file entry, 0 otherwise
+    uint64_t parent;
+    uint8_t type;
+    uint8_t flags;
+    uint8_t reserved[6];
+};
+
+static uint32_t crc32(const unsigned char* data, size_t len)
+{
+    static uint32_t table[256];
+    static std::once_flag once;
+
+    std::call_once(once, []() {
+        for (uint32_t i = 0; i < 256; i++) {
+            uint32_t c = i;
+            for (int k = 0; k < 8; k++) {
+                c = (c & 1) ? (0xedb88320u ^ (c >> 1)) : (c >> 1);
+            }
+            table[i] = c;
+        }
+    });
+
+    uint32_t crc = 0xffffffffu;
+    for (size_t i = 0; i < len; i++) {
+        crc = table[(crc ^ data[i]) & 0xff] ^ (crc >> 8);
+    }
+    return crc ^ 0xffffffffu;
+}
+
+static bool sameEntry(const MediaIndex::Entry& a, const MediaIndex::Entry& b)
+{
+    return a.type == b.type && a.flags == b.flags && a.ino == b.ino &&
+           a.mtimeNs == b.mtimeNs && a.size == b.size && a.children == b.children &&
+           a.parent == b.parent && a.name == b.name;
+}
+
+static void serialize(uint64_t hash, const MediaIndex::Entry& entry, std::string& out)
+{
+    // the payload lists the subdirectories of a directory, or names a file
+    const std::vector<std::string> fileName(1, entry.name);
+    const std::vector<std::string>& names = entry.type == MediaIndex::ENTRY_FILE ? fileName : entry.children;
+    size_t payload = 0;
+    for (const std::string& name : names) {
+        payload += name.size() + 1;
+    }
+
+    size_t offset = out.size();
+    out.resize(offset + sizeof(IndexRecord) + INDEX_ALIGN(payload), '\0');
+
+    IndexRecord* record = (IndexRecord*)&out[offset];
+    record->length = (uint32_t)INDEX_ALIGN(payload);
+    record->hash = hash;
+    record->ino = entry.ino;
+    record->mtimeNs = entry.mtimeNs;
+    record->size = entry.size;
+    record->parent = entry.type == MediaIndex::ENTRY_FILE ? entry.parent : 0;
+    record->type = entry.type;
+    record->flags = entry.flags;
+
+    char* data = &out[offset + sizeof(IndexRecord)];
+    for (const std::string& name : names) {
+        memcpy(data, name.c_str(), name.size() + 1);
+        data += name.size() + 1;
+    }
+
+    record->crc = crc32((const unsigned char*)record + sizeof(uint32_t),
+                        sizeof(IndexRecord) - sizeof(uint32_t) + record->length);
+}
+
+MediaIndex::MediaIndex()
+    : mFd(-1),
+      mRecords(0),
+      mStale(false)
+{
+}
+
+MediaIndex::~MediaIndex()
+{
+    close();
+}
+
+uint64_t MediaIndex::hashPath(const char* path, size_t len)
+{
+    // FNV-1a
+    uint64_t hash = 14695981039346656037ull;
+    for (size_t i = 0; i < len; i++) {
+        hash = (hash ^ (unsigned char)path[i]) * 1099511628211ull;
+    }
+    return hash;
+}
+
+int MediaIndex::replay(const unsigned char* data, size_t len, size_t& validEnd)
+{
+    size_t offset = INDEX_HEADER_SIZE;
+    int count = 0;
+
+    while (offset + sizeof(IndexRecord) <= len) {
+        const IndexRecord* record = (const IndexRecord*)(data + offset);
+        if (record->length > len - offset - sizeof(IndexRecord) || (record->length & 7) != 0) {
+            break;
+        }
+        if (crc32(data + offset + sizeof(uint32_t), sizeof(IndexRecord) - sizeof(uint32_t) + record->length) != record->crc) {
+            break;
+        }
+
+        auto it = mEntries.find(record->hash);
+        if (it != mEntries.end()) {
+            unlinkLocked(record->hash, it->second);
+        }
+        if (record->type == ENTRY_REMOVED) {
+            if (it != mEntries.end()) {
+                mEntries.erase(it);
+            }
+        } else {
+            Entry& entry = mEntries[record->hash];
+            entry.type = record->type;
+            entry.flags = record->flags;
+            entry.ino = record->ino;
+            entry.mtimeNs = record->mtimeNs;
+            entry.size = record->size;
+            entry.parent = record->parent;
+            entry.children.clear();
+            entry.name.clear();
+
+            const char* names = (const char*)(record + 1);
+            const char* end = names + record->length;
+            while (names < end && *names != '\0') {
+                size_t n = strnlen(names, end - names);
+                if (entry.type == ENTRY_FILE) {
+                    entry.name.assign(names, n);
+                    break;
+                }
+                entry.children.emplace_back(names, n);
+                names += n + 1;
+            }
+            linkLocked(record->hash, entry);
+        }
+
+        offset += sizeof(IndexRecord) + record->length;
+        count++;
+    }
+
+    validEnd = offset;
+    return count;
+}
+
+int MediaIndex::open(const std::string& path)
+{
+    std::lock_guard<std::mutex> lock(mLock);
+    struct stat sb;
+    IndexHeader header;
+
+    if (mFd >= 0) {
+        return 0;
+    }
+
+    int fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0600);
+    if (fd < 0) {
+        return -errno;
+    }
+
+    if (fstat(fd, &sb) != 0) {
+        int err = -errno;
+        ::close(fd);
+        return err;
+    }
+
+    mEntries.clear();
+    mFiles.clear();
+    mRecords = 0;
+    mStale = false;
+
+    size_t validEnd = 0;
+    if ((size_t)sb.st_size >= INDEX_HEADER_SIZE) {
+        void* data = mmap(nullptr, sb.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (data != MAP_FAILED) {
+            const IndexHeader* h = (const IndexHeader*)data;
+            if (memcmp(h->magic, INDEX_MAGIC, sizeof(INDEX_MAGIC)) == 0 && h->version == INDEX_VERSION) {
+                mRecords = replay((const unsigned char*)data, sb.st_size, validEnd);
+            }
+            munmap(data, sb.st_size);
+        }
+    }
+
+    if (validEnd == 0) {
+        // new, foreign or damaged beyond the header: start over
+        memset(&header, 0, sizeof(header));
+        memcpy(header.magic, INDEX_MAGIC, sizeof(INDEX_MAGIC));
+        header.version = INDEX_VERSION;
+        if (ftruncate(fd, 0) != 0 || pwrite(fd, &header, sizeof(header), 0) != (ssize_t)sizeof(header)) {
+            int err = -errno;
+            ::close(fd);
+            return err;
+        }
+        validEnd = INDEX_HEADER_SIZE;
+    } else if (validEnd < (size_t)sb.st_size) {
+        syslog(LOG_WARNING, "MediaIndex: Dropping %lld bytes of torn records from %s.",
+               (long long)(sb.st_size - validEnd), path.c_str());
+        if (ftruncate(fd, validEnd) != 0) {
+            int err = -errno;
+            ::close(fd);
+            return err;
+        }
+    }
+
+    if (lseek(fd, validEnd, SEEK_SET) < 0) {
+        int err = -errno;
+        ::close(fd);
+        return err;
+    }
+
+    mPath = path;
+    mFd = fd;
+    return 0;
+}
+
+void MediaIndex::close()
+{
+    flush();
+
+    std::lock_guard<std::mutex> lock(mLock);
+    if (mFd >= 0) {
+        ::close(mFd);
+        mFd = -1;
+    }
+    mEntries.clear();
+    mFiles.clear();
+    mPending.clear();
+    mRecords = 0;
+    mStale = false;
+}
+
+bool MediaIndex::isOpen()
+{
+    std::lock_guard<std::mutex> lock(mLock);
+    return mFd >= 0;
+}
+
+bool MediaIndex::find(uint64_t hash, Entry& entry)
+{
+    std::lock_guard<std::mutex> lock(mLock);
+
+    auto it = mEntries.find(hash);
+    if (it == mEntries.end()) {
+        return false;
+    }
+
+    entry = it->second;
+    return true;
+}
+
+void MediaIndex::put(uint64_t hash, const Entry& entry)
+{
+    std::lock_guard<std::mutex> lock(mLock);
+
+    auto it = mEntries.find(hash);
+    if (it != mEntries.end()) {
+        if (sameEntry(it->second, entry)) {
+            return;
+        }
+        unlinkLocked(hash, it->second);
+    }
+
+    mEntries[hash] = entry;
+    linkLocked(hash, entry);
+    appendLocked(hash, entry);
+}
+
+void MediaIndex::remove(uint64_t hash)
+{
+    std::lock_guard<std::mutex> lock(mLock);
+
+    auto it = mEntries.find(hash);
+    if (it == mEntries.end()) {
+        return;
+    }
+    unlinkLocked(hash, it->second);
+    mEntries.erase(it);
+
+    Entry removed;
+    removed.type = ENTRY_REMOVED;
+    removed.flags = 0;
+    removed.ino = 0;
+    removed.mtimeNs = 0;
+    removed.size = 0;
+    removed.parent = 0;
+    appendLocked(hash, removed);
+}
+
+void MediaIndex::removeFiles(const std::string& dir, std::vector<std::string>& notified)
+{
+    std::lock_guard<std::mutex> lock(mLock);
+
+    auto files = mFiles.find(hashPath(dir));
+    if (files == mFiles.end()) {
+        return;
+    }
+
+    Entry removed;
+    removed.type = ENTRY_REMOVED;
+    removed.flags = 0;
+    removed.ino = 0;
+    removed.mtimeNs = 0;
+    removed.size = 0;
+    removed.parent = 0;
+    for (uint64_t hash : files->second) {
+        auto it = mEntries.find(hash);
+        if (it == mEntries.end()) {
+            continue;
+        }
+        if (it->second.flags & (FLAG_NOTIFIED | FLAG_SENT)) {
+            notified.push_back(dir + "/" + it->second.name);
+        }
+        mEntries.erase(it);
+        appendLocked(hash, removed);
+    }
+    mFiles.erase(files);
+}
+
+void MediaIndex::linkLocked(uint64_t hash, const Entry& entry)
+{
+    if (entry.type == ENTRY_FILE && entry.parent != 0) {
+        mFiles[entry.parent].insert(hash);
+    }
+}
+
+void MediaIndex::unlinkLocked(uint64_t hash, const Entry& entry)
+{
+    if (entry.type != ENTRY_FILE || entry.parent == 0) {
+        return;
+    }
+
+    auto files = mFiles.find(entry.parent);
+    if (files != mFiles.end()) {
+        files->second.erase(hash);
+        if (files->second.empty()) {
+            mFiles.erase(files);
+        }
+    }
+}
+
+void MediaIndex::appendLocked(uint64_t hash, const Entry& entry)
+{
+    if (mFd < 0) {
+        return;
+    }
+
+    serialize(hash, entry, mPending);
+    mRecords++;
+
+    if (mPending.size() >= INDEX_WRITE_SIZE) {
+        writeLocked(mPending);
+        mPending.clear();
+    }
+}
+
+int MediaIndex::writeLocked(const std::string& data)
+{
+    size_t written = 0;
+    const off_t start = lseek(mFd, 0, SEEK_CUR);
+
+    while (written < data.size()) {
+        ssize_t n = write(mFd, data.data() + written, data.size() - written);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            int err = -errno;
+            syslog(LOG_WARNING, "MediaIndex: Failed to write %s: %s", mPath.c_str(), strerror(errno));
+            /* 去掉写了一半的记录，否则之后追加的记录都接在残缺记录后面，重放时被一并丢弃 */
+            if (start < 0 || ftruncate(mFd, start) != 0 || lseek(mFd, start, SEEK_SET) < 0) {
+                syslog(LOG_WARNING, "MediaIndex: Failed to drop the torn write from %s: %s", mPath.c_str(),
+                       strerror(errno));
+            }
+            // the records of data are lost, the next flush() rewrites the log
+            mStale = true;
+            return err;
+        }
+        written += n;
+    }
+
+    return 0;
+}
+
+int MediaIndex::flush()
+{
+    std::lock_guard<std::mutex> lock(mLock);
+    int ret = 0;
+
+    if (mFd < 0) {
+        return 0;
+    }
+
+    if (!mPending.empty()) {
+        ret = writeLocked(mPending);
+        mPending.clear();
+    }
+
+    if (mStale || (mRecords >= INDEX_COMPACT_MIN && mRecords > mEntries.size() * 2)) {
+        ret = compactLocked();
+    }
+
+    return ret;
+}
+
+int MediaIndex::compactLocked()
+{
+    IndexHeader header;
+    std::string data;
+    const std::string tmpPath = mPath + ".tmp";
+
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, INDEX_MAGIC, sizeof(INDEX_MAGIC));
+    header.version = INDEX_VERSION;
+    data.append((const char*)&header, sizeof(header));
+    for (const auto& it : mEntries) {
+        serialize(it.first, it.second, data);
+    }
+
+    int fd = ::open(tmpPath.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+    if (fd < 0) {
+        return -errno;
+    }
+
+    int oldFd = mFd;
+    mFd = fd;
+    int ret = writeLocked(data);
+    mFd = oldFd;
+
+    // the new log must be on disk before it replaces the old one
+    if (ret == 0 && fsync(fd) != 0) {
+        ret = -errno;
+    }
+    if (ret == 0 && rename(tmpPath.c_str(), mPath.c_str()) != 0) {
+        ret = -errno;
+    }
+
+    if (ret != 0) {
+        ::close(fd);
+        unlink(tmpPath.c_str());
+        return ret;
+    }
+
+    syslog(LOG_DEBUG, "MediaIndex: Compacted %zu records into %zu.", mRecords, mEntries.size());
+    ::close(mFd);
+    mFd = fd;
+    mRecords = mEntries.size();
+    mStale = false;
+    lseek(mFd, 0, SEEK_END);
+    return 0;
+}
+
+size_t MediaIndex::size()
+{
+    std::lock_guard<std::mutex> lock(mLock);
+    return mEntries.size();
+}
+
+} // namespace kmre
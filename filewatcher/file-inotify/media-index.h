@@ -0,0 +1,132 @@
+/*
+ * Copyright (c) KylinSoft Co., Ltd. 2016-2024.All rights reserved.
+ *
+ * Authors:
+ *  Ma Chao    machao@kylinos.cn
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef MEDIAINDEX_H
+#define MEDIAINDEX_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "utils.h"
+
+namespace kmre {
+
+// Persistent index of scanned directories and reported media files.
+//
+// Entries are keyed by a 64-bit hash of the host path. A directory entry
+// keeps the mtime it had when it was listed and the names of its
+// subdirectories, so an unchanged directory need not be listed again; a file
+// entry keeps (inode, mtime, size), whether it was reported to Android, and
+// its name and parent directory so the files of a directory can be listed.
+//
+// On disk it is an append-only log of checksummed records. The log is
+// mapped and replayed on open(); a torn record left by a crash fails its
+// checksum and is cut off together with anything after it. Once dead
+// records outnumber live ones the log is rewritten to a temporary file and
+// renamed over the old one.
+//
+// All methods are thread safe.
+class MediaIndex
+{
+public:
+    enum EntryType
+    {
+        ENTRY_REMOVED = 0,
+        ENTRY_FILE = 1,
+        ENTRY_DIR = 2,
+    };
+
+    enum EntryFlag
+    {
+        // the manager took the record of this version of the file
+        FLAG_NOTIFIED = 0x1,
+        // a record was sent, the manager may not have taken it
+        FLAG_SENT = 0x2,
+    };
+
+    struct Entry
+    {
+        uint8_t type;
+        uint8_t flags;
+        uint64_t ino;
+        int64_t mtimeNs;
+        int64_t size;
+        // subdirectory names of a directory entry
+        std::vector<std::string> children;
+        // hash of the parent directory and the file name, file entries only
+        uint64_t parent;
+        std::string name;
+    };
+
+    MediaIndex();
+    ~MediaIndex();
+
+    static uint64_t hashPath(const char* path, size_t len);
+    static uint64_t hashPath(const std::string& path) { return hashPath(path.data(), path.size()); }
+
+    // Map and replay the log at path, creating it if needed. Return 0 or -errno.
+    int open(const std::string& path);
+    void close();
+    bool isOpen();
+
+    bool find(uint64_t hash, Entry& entry);
+    // Record entry unless it is already stored as is.
+    void put(uint64_t hash, const Entry& entry);
+    void remove(uint64_t hash);
+    // Remove the file entries directly inside dir and append the paths of
+    // those that were reported, or sent at least, to notified.
+    void removeFiles(const std::string& dir, std::vector<std::string>& notified);
+
+    // Write out buffered records and compact the log when it has grown stale.
+    int flush();
+
+    size_t size();
+
+private:
+    void appendLocked(uint64_t hash, const Entry& entry);
+    void linkLocked(uint64_t hash, const Entry& entry);
+    void unlinkLocked(uint64_t hash, const Entry& entry);
+    int writeLocked(const std::string& data);
+    int compactLocked();
+    int replay(const unsigned char* data, size_t len, size_t& validEnd);
+
+    std::mutex mLock;
+    std::string mPath;
+    int mFd;
+    std::unordered_map<uint64_t, Entry> mEntries;
+    // parent directory hash -> its file entries
+    std::unordered_map<uint64_t, std::unordered_set<uint64_t>> mFiles;
+    // records in the log, live or superseded
+    size_t mRecords;
+    std::string mPending;
+    // a write failed: the log lacks records mEntries has, rewrite it
+    bool mStale;
+
+    DISALLOW_COPY_AND_ASSIGN(MediaIndex);
+};
+
+} // namespace kmre
+
+#endif // MEDIAINDEX_H
@@ -0,0 +1,206 @@
+/*
+ * Copyright (c) KylinSoft Co., Ltd. 2016-2024.All rights reserved.
+ *
+ * Authors:
+ *  Ma Chao    machao@kylinos.cn
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "media-sniffer.h"
+
+#include <sys/stat.h>
+#include <string.h>
+
+namespace kmre {
+
+MediaSniffer::MediaSniffer(size_t capacity)
+    : mCapacity(capacity ? capacity : 1),
+      mHits(0),
+      mMisses(0)
+{
+}
+
+size_t MediaSniffer::KeyHash::operator()(const FileKey& key) const
+{
+    uint64_t h = key.ino * 0x9e3779b97f4a7c15ull;
+    h ^= key.dev + (h << 6) + (h >> 2);
+    h ^= (uint64_t)key.mtimeSec * 31 + (uint64_t)key.mtimeNsec;
+    h ^= (uint64_t)key.size * 0xff51afd7ed558ccdull;
+    return (size_t)h;
+}
+
+bool MediaSniffer::fileKey(int fd, FileKey& key)
+{
+    struct stat sb;
+
+    if (fstat(fd, &sb) != 0 || !S_ISREG(sb.st_mode)) {
+        return false;
+    }
+
+    key.dev = sb.st_dev;
+    key.ino = sb.st_ino;
+    key.mtimeSec = sb.st_mtim.tv_sec;
+    key.mtimeNsec = sb.st_mtim.tv_nsec;
+    key.size = sb.st_size;
+    return true;
+}
+
+static bool hasBytes(const unsigned char* data, size_t len, size_t offset, const char* magic, size_t magicLen)
+{
+    return len >= offset + magicLen && memcmp(data + offset, magic, magicLen) == 0;
+}
+
+// ISO base media file format (mp4, mov, 3gp, heif, avif), decided by brand
+static const char* classifyFtyp(const unsigned char* data, size_t len)
+{
+    if (!hasBytes(data, len, 4, "ftyp", 4) || len < 12) {
+        return nullptr;
+    }
+
+    const char* brand = (const char*)data + 8;
+    if (memcmp(brand, "heic", 4) == 0 || memcmp(brand, "heix", 4) == 0 ||
+        memcmp(brand, "heim", 4) == 0 || memcmp(brand, "heis", 4) == 0) {
+        return "image/heic";
+    }
+    if (memcmp(brand, "mif1", 4) == 0 || memcmp(brand, "msf1", 4) == 0) {
+        return "image/heif";
+    }
+    if (memcmp(brand, "avif", 4) == 0 || memcmp(brand, "avis", 4) == 0) {
+        return "image/avif";
+    }
+    if (memcmp(brand, "qt  ", 4) == 0) {
+        return "video/quicktime";
+    }
+    if (memcmp(brand, "3gp", 3) == 0) {
+        return "video/3gpp";
+    }
+    if (memcmp(brand, "3g2", 3) == 0) {
+        return "video/3gpp2";
+    }
+    // M4A/M4B/M4P are audio only
+    if (memcmp(brand, "M4A", 3) == 0 || memcmp(brand, "M4B", 3) == 0 || memcmp(brand, "M4P", 3) == 0) {
+        return nullptr;
+    }
+
+    return "video/mp4";
+}
+
+// EBML header, webm declares its DocType within the first bytes
+static const char* classifyEbml(const unsigned char* data, size_t len)
+{
+    if (!hasBytes(data, len, 0, "\x1a\x45\xdf\xa3", 4)) {
+        return nullptr;
+    }
+
+    for (size_t i = 4; i + 4 <= len; i++) {
+        if (memcmp(data + i, "webm", 4) == 0) {
+            return "video/webm";
+        }
+    }
+
+    return "video/x-matroska";
+}
+
+const char* MediaSniffer::classify(const unsigned char* data, size_t len)
+{
+    const char* mimeType = nullptr;
+
+    if (!data || len < 4) {
+        return nullptr;
+    }
+
+    if (hasBytes(data, len, 0, "\xff\xd8\xff", 3)) {
+        return "image/jpeg";
+    }
+    if (hasBytes(data, len, 0, "\x89PNG\r\n\x1a\n", 8)) {
+        return "image/png";
+    }
+    if (hasBytes(data, len, 0, "GIF87a", 6) || hasBytes(data, len, 0, "GIF89a", 6)) {
+        return "image/gif";
+    }
+    if (hasBytes(data, len, 0, "RIFF", 4)) {
+        if (hasBytes(data, len, 8, "WEBP", 4)) {
+            return "image/webp";
+        }
+        if (hasBytes(data, len, 8, "AVI ", 4)) {
+            return "video/x-msvideo";
+        }
+        return nullptr;
+    }
+    if (hasBytes(data, len, 0, "BM", 2) && len >= 14) {
+        return "image/bmp";
+    }
+    if (hasBytes(data, len, 0, "II*\0", 4) || hasBytes(data, len, 0, "MM\0*", 4)) {
+        return "image/tiff";
+    }
+    if ((mimeType = classifyFtyp(data, len)) != nullptr) {
+        return mimeType;
+    }
+    if ((mimeType = classifyEbml(data, len)) != nullptr) {
+        return mimeType;
+    }
+    if (hasBytes(data, len, 0, "FLV\x01", 4)) {
+        return "video/x-flv";
+    }
+    if (hasBytes(data, len, 0, "\x30\x26\xb2\x75\x8e\x66\xcf\x11", 8)) {
+        return "video/x-ms-wmv";
+    }
+    if (hasBytes(data, len, 0, "\x00\x00\x01\xba", 4)) {
+        return "video/mpeg";
+    }
+    // MPEG transport stream, sync byte every 188 bytes
+    if (data[0] == 0x47 && len > 188 && data[188] == 0x47) {
+        return "video/mp2t";
+    }
+
+    return nullptr;
+}
+
+bool MediaSniffer::lookup(const FileKey& key, std::string& mimeType)
+{
+    std::lock_guard<std::mutex> lock(mLock);
+
+    auto it = mEntries.find(key);
+    if (it == mEntries.end()) {
+        mMisses++;
+        return false;
+    }
+
+    mLru.splice(mLru.begin(), mLru, it->second);
+    mimeType = it->second->second;
+    mHits++;
+    return true;
+}
+
+void MediaSniffer::store(const FileKey& key, const std::string& mimeType)
+{
+    std::lock_guard<std::mutex> lock(mLock);
+
+    auto it = mEntries.find(key);
+    if (it != mEntries.end()) {
+        it->second->second = mimeType;
+        mLru.splice(mLru.begin(), mLru, it->second);
+        return;
+    }
+
+    mLru.emplace_front(key, mimeType);
+    mEntries[key] = mLru.begin();
+
+    if (mEntries.size() > mCapacity) {
+        mEntries.erase(mLru.back().first);
+        mLru.pop_back();
+    }
+}
+
+} // namespace kmre
@@ -0,0 +1,96 @@
+/*
+ * Copyright (c) KylinSoft Co., Ltd. 2016-2024.All rights reserved.
+ *
+ * Authors:
+ *  Ma Chao    machao@kylinos.cn
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef MEDIASNIFFER_H
+#define MEDIASNIFFER_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <list>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+#include "utils.h"
+
+#define MEDIA_MAGIC_SIZE 256
+
+namespace kmre {
+
+// Content based MIME detection for new media files.
+//
+// classify() recognises the common image and video containers from the
+// first MEDIA_MAGIC_SIZE bytes; anything else is left to the caller's full
+// detector. Results are remembered per (dev, inode, mtime, size), so a file
+// reported again without changes is not read a second time.
+//
+// lookup() and store() are thread safe.
+class MediaSniffer
+{
+public:
+    struct FileKey
+    {
+        uint64_t dev;
+        uint64_t ino;
+        int64_t mtimeSec;
+        int64_t mtimeNsec;
+        int64_t size;
+
+        bool operator==(const FileKey& other) const {
+            return dev == other.dev && ino == other.ino && mtimeSec == other.mtimeSec &&
+                   mtimeNsec == other.mtimeNsec && size == other.size;
+        }
+    };
+
+    explicit MediaSniffer(size_t capacity = 4096);
+
+    // Fill key from an open file, return false if it is not a regular file.
+    static bool fileKey(int fd, FileKey& key);
+    // MIME type of a known image/video container, or nullptr.
+    static const char* classify(const unsigned char* data, size_t len);
+
+    bool lookup(const FileKey& key, std::string& mimeType);
+    void store(const FileKey& key, const std::string& mimeType);
+
+    uint64_t hits() const { return mHits; }
+    uint64_t misses() const { return mMisses; }
+
+private:
+    struct KeyHash
+    {
+        size_t operator()(const FileKey& key) const;
+    };
+
+    typedef std::list<std::pair<FileKey, std::string>> LruList;
+
+    std::mutex mLock;
+    size_t mCapacity;
+    // most recently used first
+    LruList mLru;
+    std::unordered_map<FileKey, LruList::iterator, KeyHash> mEntries;
+    uint64_t mHits;
+    uint64_t mMisses;
+
+    DISALLOW_COPY_AND_ASSIGN(MediaSniffer);
+};
+
+} // namespace kmre
+
+#endif // MEDIASNIFFER_H
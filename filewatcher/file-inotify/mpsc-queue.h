@@ -0,0 +1,136 @@
+/*
+ * Copyright (c) KylinSoft Co., Ltd. 2016-2024.All rights reserved.
+ *
+ * Authors:
+ *  Ma Chao    machao@kylinos.cn
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef MPSCQUEUE_H
+#define MPSCQUEUE_H
+
+#include <atomic>
+#include <utility>
+
+#include "utils.h"
+
+namespace kmre {
+
+// Unbounded multi-producer single-consumer queue (Vyukov's intrusive
+// design with a stub node).
+//
+// push() is one atomic exchange and never waits for the consumer or for
+// other producers. pop() and empty() belong to a single consumer thread.
+// A producer preempted between its exchange and its link hides the
+// entries behind it for that short while: pop() returns false while
+// empty() still returns false, so the consumer retries instead of going to
+// sleep.
+template <typename T>
+class MpscQueue
+{
+public:
+    MpscQueue()
+        : mHead(&mStub),
+          mTail(&mStub)
+    {
+        mStub.next.store(nullptr);
+    }
+
+    ~MpscQueue()
+    {
+        T value;
+        while (pop(value)) {
+        }
+    }
+
+    void push(T value)
+    {
+        pushNode(new Node(std::move(value)));
+    }
+
+    bool pop(T& value)
+    {
+        Node* tail = mTail;
+        Node* next = tail->next.load();
+
+        if (tail == &mStub) {
+            if (!next) {
+                return false;
+            }
+            mTail = next;
+            tail = next;
+            next = next->next.load();
+        }
+
+        if (!next) {
+            // tail is the last node, put the stub behind it before taking it
+            if (tail != mHead.load()) {
+                return false;
+            }
+            pushNode(&mStub);
+            next = tail->next.load();
+            if (!next) {
+                return false;
+            }
+        }
+
+        mTail = next;
+        value = std::move(tail->value);
+        delete tail;
+
+        return true;
+    }
+
+    bool empty() const
+    {
+        return mTail == &mStub && !mStub.next.load();
+    }
+
+private:
+    struct Node
+    {
+        Node()
+            : next(nullptr)
+        {
+        }
+
+        explicit Node(T&& v)
+            : next(nullptr),
+              value(std::move(v))
+        {
+        }
+
+        std::atomic<Node*> next;
+        T value;
+    };
+
+    void pushNode(Node* node)
+    {
+        node->next.store(nullptr);
+        Node* prev = mHead.exchange(node);
+        prev->next.store(node);
+    }
+
+    // last pushed node, shared by the producers
+    std::atomic<Node*> mHead;
+    // next node to pop, consumer only
+    Node* mTail;
+    Node mStub;
+
+    DISALLOW_COPY_AND_ASSIGN(MpscQueue);
+};
+
+} // namespace kmre
+
+#endif // MPSCQUEUE_H
@@ -0,0 +1,218 @@
+/*
+ * Copyright (c) KylinSoft Co., Ltd. 2016-2024.All rights reserved.
+ *
+ * Authors:
+ *  Ma Chao    machao@kylinos.cn
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "path-filter.h"
+
+#include <fnmatch.h>
+#include <string.h>
+
+namespace kmre {
+
+static bool isGlob(const std::string& pattern)
+{
+    return pattern.find_first_of("*?[") != std::string::npos;
+}
+
+PathFilter::PathFilter()
+{
+}
+
+PathFilter::~PathFilter()
+{
+}
+
+void PathFilter::clear()
+{
+    mRoot.excluded = false;
+    mRoot.children.clear();
+    mPathGlobs.clear();
+    mNames.clear();
+    mNameGlobs.clear();
+    mMimeTypes.clear();
+    mMimePrefixes.clear();
+}
+
+bool PathFilter::addExclude(const std::string& pattern)
+{
+    if (pattern.empty()) {
+        return false;
+    }
+
+    if (pattern[0] != '/') {
+        if (pattern.find('/') != std::string::npos) {
+            return false;
+        }
+        if (isGlob(pattern)) {
+            mNameGlobs.push_back(pattern);
+        } else {
+            mNames.insert(pattern);
+        }
+        return true;
+    }
+
+    if (isGlob(pattern)) {
+        mPathGlobs.push_back(pattern);
+        return true;
+    }
+
+    Node* node = &mRoot;
+    size_t pos = 0;
+    while (pos < pattern.size()) {
+        size_t end = pattern.find('/', pos);
+        if (end == std::string::npos) {
+            end = pattern.size();
+        }
+        if (end > pos) {
+            std::unique_ptr<Node>& child = node->children[pattern.substr(pos, end - pos)];
+            if (!child) {
+                child.reset(new Node);
+            }
+            node = child.get();
+        }
+        pos = end + 1;
+    }
+    // "/" alone would exclude everything
+    if (node == &mRoot) {
+        return false;
+    }
+    node->excluded = true;
+
+    return true;
+}
+
+void PathFilter::addMimeType(const std::string& pattern)
+{
+    if (pattern == "*" || pattern == "*/*") {
+        mMimePrefixes.push_back(std::string());
+    } else if (pattern.size() > 2 && pattern.compare(pattern.size() - 2, 2, "/*") == 0) {
+        mMimePrefixes.push_back(pattern.substr(0, pattern.size() - 1));
+    } else if (!pattern.empty()) {
+        mMimeTypes.insert(pattern);
+    }
+}
+
+bool PathFilter::hasExcludes() const
+{
+    return !mRoot.children.empty() || !mPathGlobs.empty() || !mNames.empty() || !mNameGlobs.empty();
+}
+
+bool PathFilter::isAnchoredExcluded(const std::string& path) const
+{
+    const Node* node = &mRoot;
+    size_t pos = 0;
+    std::string name;
+
+    while (!node->children.empty() && pos < path.size()) {
+        size_t end = path.find('/', pos);
+        if (end == std::string::npos) {
+            end = path.size();
+        }
+        if (end > pos) {
+            name.assign(path, pos, end - pos);
+            auto it = node->children.find(name);
+            if (it == node->children.end()) {
+                break;
+            }
+            node = it->second.get();
+            if (node->excluded) {
+                return true;
+            }
+        }
+        pos = end + 1;
+    }
+
+    // FNM_LEADING_DIR: a pattern matching a parent excludes the whole tree
+    for (const std::string& glob : mPathGlobs) {
+        if (fnmatch(glob.c_str(), path.c_str(), FNM_PATHNAME | FNM_LEADING_DIR) == 0) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+bool PathFilter::isNameExcluded(const char* name) const
+{
+    if (!mNames.empty() && mNames.count(name) > 0) {
+        return true;
+    }
+
+    for (const std::string& glob : mNameGlobs) {
+        if (fnmatch(glob.c_str(), name, 0) == 0) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+bool PathFilter::isExcluded(const std::string& path) const
+{
+    std::string name;
+    size_t pos = 0;
+
+    if (!hasExcludes()) {
+        return false;
+    }
+
+    while (pos < path.size()) {
+        size_t end = path.find('/', pos);
+        if (end == std::string::npos) {
+            end = path.size();
+        }
+        if (end > pos) {
+            name.assign(path, pos, end - pos);
+            if (isNameExcluded(name.c_str())) {
+                return true;
+            }
+        }
+        pos = end + 1;
+    }
+
+    return isAnchoredExcluded(path);
+}
+
+bool PathFilter::isEntryExcluded(const std::string& path) const
+{
+    if (!hasExcludes()) {
+        return false;
+    }
+
+    size_t slash = path.find_last_of('/');
+    const char* name = path.c_str() + (slash == std::string::npos ? 0 : slash + 1);
+
+    return isNameExcluded(name) || isAnchoredExcluded(path);
+}
+
+bool PathFilter::allowsMimeType(const std::string& mimeType) const
+{
+    if (mMimeTypes.count(mimeType) > 0) {
+        return true;
+    }
+
+    for (const std::string& prefix : mMimePrefixes) {
+        if (mimeType.compare(0, prefix.size(), prefix) == 0) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+} // namespace kmre
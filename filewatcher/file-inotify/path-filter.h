@@ -0,0 +1,88 @@
+/*
+ * Copyright (c) KylinSoft Co., Ltd. 2016-2024.All rights reserved.
+ *
+ * Authors:
+ *  Ma Chao    machao@kylinos.cn
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef PATHFILTER_H
+#define PATHFILTER_H
+
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "utils.h"
+
+namespace kmre {
+
+// Exclusion rules and the MIME allow-list of the media watcher.
+//
+// An exclude starting with '/' is anchored: a literal path goes into a
+// trie of path components and excludes itself and everything below it, a
+// glob is matched against the whole path with fnmatch(3). Any other
+// exclude is matched against every name of a path, literal names through
+// a hash set and globs with fnmatch(3).
+//
+// Build it before the first scan; the const methods are then safe to call
+// from any thread.
+class PathFilter
+{
+public:
+    PathFilter();
+    ~PathFilter();
+
+    void clear();
+    // Return false for a pattern that can not be used (empty, or relative
+    // with a '/').
+    bool addExclude(const std::string& pattern);
+    // "type/subtype", "type/*" or "*"
+    void addMimeType(const std::string& pattern);
+
+    bool hasExcludes() const;
+    // Check every name of path and the anchored rules.
+    bool isExcluded(const std::string& path) const;
+    // Same, but only the last name: the parent of path already passed.
+    bool isEntryExcluded(const std::string& path) const;
+    bool isNameExcluded(const char* name) const;
+    bool allowsMimeType(const std::string& mimeType) const;
+
+private:
+    struct Node
+    {
+        bool excluded;
+        std::unordered_map<std::string, std::unique_ptr<Node>> children;
+
+        Node() : excluded(false) {}
+    };
+
+    bool isAnchoredExcluded(const std::string& path) const;
+
+    Node mRoot;
+    std::vector<std::string> mPathGlobs;
+    std::unordered_set<std::string> mNames;
+    std::vector<std::string> mNameGlobs;
+    std::unordered_set<std::string> mMimeTypes;
+    // "image/" for "image/*", empty for "*"
+    std::vector<std::string> mMimePrefixes;
+
+    DISALLOW_COPY_AND_ASSIGN(PathFilter);
+};
+
+} // namespace kmre
+
+#endif // PATHFILTER_H
@@ -0,0 +1,149 @@
+/*
+ * Copyright (c) KylinSoft Co., Ltd. 2016-2024.All rights reserved.
+ *
+ * Authors:
+ *  Ma Chao    machao@kylinos.cn
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef TIMERWHEEL_H
+#define TIMERWHEEL_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <utility>
+#include <vector>
+
+#include "utils.h"
+
+namespace kmre {
+
+// Hashed timer wheel for debounce deadlines.
+//
+// schedule() is O(1). advance() only visits the slots that elapsed since the
+// last call. An entry is not cancelled in place; rescheduling a key adds a
+// new entry, and the owner recognises stale ones by the tick handed back from
+// schedule(). Times are milliseconds from a monotonic clock.
+//
+// Not thread safe, the owner serializes access.
+template <typename Key>
+class TimerWheel
+{
+public:
+    typedef std::pair<Key, uint64_t> Expired;
+
+    TimerWheel(uint32_t tickMs = 50, size_t slots = 256)
+        : mTickMs(tickMs ? tickMs : 1),
+          mSlots(slots ? slots : 1),
+          mCurrentTick(0),
+          mCount(0)
+    {
+    }
+
+    // Fire key at nowMs + delayMs (rounded up to a tick); return the tick.
+    uint64_t schedule(const Key& key, uint64_t nowMs, uint64_t delayMs)
+    {
+        if (mCount == 0) {
+            mCurrentTick = nowMs / mTickMs;
+        }
+
+        uint64_t tick = (nowMs + delayMs + mTickMs - 1) / mTickMs;
+        if (tick <= mCurrentTick) {
+            tick = mCurrentTick + 1;
+        }
+
+        mSlots[tick % mSlots.size()].push_back({ key, tick });
+        mCount++;
+        return tick;
+    }
+
+    // Move every entry due at nowMs into expired as (key, tick).
+    void advance(uint64_t nowMs, std::vector<Expired>& expired)
+    {
+        uint64_t nowTick = nowMs / mTickMs;
+
+        if (mCount == 0 || nowTick <= mCurrentTick) {
+            if (mCount == 0 && nowTick > mCurrentTick) {
+                mCurrentTick = nowTick;
+            }
+            return;
+        }
+
+        // past one full turn every slot is due, visit each once
+        uint64_t steps = nowTick - mCurrentTick;
+        if (steps > mSlots.size()) {
+            steps = mSlots.size();
+        }
+
+        for (uint64_t i = 1; i <= steps && mCount > 0; i++) {
+            std::vector<Expired>& slot = mSlots[(mCurrentTick + i) % mSlots.size()];
+            size_t kept = 0;
+            for (size_t j = 0; j < slot.size(); j++) {
+                if (slot[j].second <= nowTick) {
+                    expired.push_back(std::move(slot[j]));
+                    mCount--;
+                } else {
+                    if (kept != j) {
+                        slot[kept] = std::move(slot[j]);
+                    }
+                    kept++;
+                }
+            }
+            slot.resize(kept);
+        }
+
+        mCurrentTick = nowTick;
+    }
+
+    // Milliseconds until the next entry is due, 0 if one is already due,
+    // -1 when the wheel is empty.
+    int64_t nextTimeout(uint64_t nowMs) const
+    {
+        if (mCount == 0) {
+            return -1;
+        }
+
+        uint64_t next = UINT64_MAX;
+        for (size_t i = 1; i <= mSlots.size(); i++) {
+            const std::vector<Expired>& slot = mSlots[(mCurrentTick + i) % mSlots.size()];
+            for (const Expired& entry : slot) {
+                if (entry.second < next) {
+                    next = entry.second;
+                }
+            }
+            // nothing can be due earlier than the slot it hashes to
+            if (next == mCurrentTick + i) {
+                break;
+            }
+        }
+
+        uint64_t deadline = next * mTickMs;
+        return deadline > nowMs ? (int64_t)(deadline - nowMs) : 0;
+    }
+
+    size_t size() const { return mCount; }
+
+private:
+    uint64_t mTickMs;
+    std::vector<std::vector<Expired>> mSlots;
+    uint64_t mCurrentTick;
+    size_t mCount;
+
+    DISALLOW_COPY_AND_ASSIGN(TimerWheel);
+};
+
+} // namespace kmre
+
+#endif // TIMERWHEEL_H
@@ -0,0 +1,212 @@
+/*
+ * Copyright (c) KylinSoft Co., Ltd. 2016-2024.All rights reserved.
+ *
+ * Authors:
+ *  Ma Chao    machao@kylinos.cn
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "watch-budget.h"
+
+#include <stdio.h>
+
+#define MAX_USER_WATCHES_PATH "/proc/sys/fs/inotify/max_user_watches"
+
+namespace kmre {
+
+WatchBudget::WatchBudget()
+    : mBudget(0)
+{
+}
+
+size_t WatchBudget::systemLimit()
+{
+    unsigned long limit = 0;
+
+    FILE* fp = fopen(MAX_USER_WATCHES_PATH, "re");
+    if (!fp) {
+        return 0;
+    }
+    if (fscanf(fp, "%lu", &limit) != 1) {
+        limit = 0;
+    }
+    fclose(fp);
+
+    return (size_t)limit;
+}
+
+void WatchBudget::setBudget(size_t budget)
+{
+    mBudget = budget;
+}
+
+void WatchBudget::shrinkToUsage()
+{
+    mBudget = mEntries.size();
+}
+
+int WatchBudget::depthOf(const std::string& path)
+{
+    int depth = 0;
+    for (char c : path) {
+        if (c == '/') {
+            depth++;
+        }
+    }
+    return depth;
+}
+
+bool WatchBudget::isUnder(const std::string& path, const std::string& dir)
+{
+    return path.size() > dir.size() && path.compare(0, dir.size(), dir) == 0 && path[dir.size()] == '/';
+}
+
+void WatchBudget::insert(const std::string& path, int depth, uint64_t lastActive)
+{
+    auto it = mOrder.insert({ depth, lastActive, path }).first;
+    mEntries[path] = it;
+}
+
+bool WatchBudget::admit(const std::string& path, uint64_t lastActive, std::string& evicted)
+{
+    evicted.clear();
+
+    if (mEntries.count(path) > 0) {
+        return true;
+    }
+
+    const int depth = depthOf(path);
+    if (mBudget == 0 || mEntries.size() < mBudget) {
+        insert(path, depth, lastActive);
+        return true;
+    }
+
+    // only a hotter directory may take the watch of the coldest one
+    auto coldest = mOrder.begin();
+    if (coldest == mOrder.end() || !Colder()(*coldest, { depth, lastActive, path })) {
+        return false;
+    }
+
+    evicted = coldest->path;
+    mEntries.erase(evicted);
+    mOrder.erase(coldest);
+    insert(path, depth, lastActive);
+
+    return true;
+}
+
+void WatchBudget::release(const std::string& path)
+{
+    auto it = mEntries.find(path);
+    if (it == mEntries.end()) {
+        return;
+    }
+
+    mOrder.erase(it->second);
+    mEntries.erase(it);
+}
+
+void WatchBudget::releaseTree(const std::string& path)
+{
+    release(path);
+    mPolled.erase(path);
+
+    for (auto it = mEntries.begin(); it != mEntries.end();) {
+        if (isUnder(it->first, path)) {
+            mOrder.erase(it->second);
+            it = mEntries.erase(it);
+        } else {
+            ++it;
+        }
+    }
+
+    for (auto it = mPolled.begin(); it != mPolled.end();) {
+        if (isUnder(it->first, path)) {
+            it = mPolled.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
+void WatchBudget::moveTree(const std::string& from, const std::string& to)
+{
+    std::vector<Entry> moved;
+    std::vector<std::pair<std::string, int64_t>> movedPolls;
+
+    for (auto it = mEntries.begin(); it != mEntries.end();) {
+        if (it->first == from || isUnder(it->first, from)) {
+            moved.push_back(*it->second);
+            mOrder.erase(it->second);
+            it = mEntries.erase(it);
+        } else {
+            ++it;
+        }
+    }
+
+    for (auto it = mPolled.begin(); it != mPolled.end();) {
+        if (it->first == from || isUnder(it->first, from)) {
+            movedPolls.emplace_back(to + it->first.substr(from.size()), it->second);
+            it = mPolled.erase(it);
+        } else {
+            ++it;
+        }
+    }
+
+    for (const Entry& entry : moved) {
+        const std::string path = to + entry.path.substr(from.size());
+        insert(path, depthOf(path), entry.lastActive);
+    }
+    for (const auto& poll : movedPolls) {
+        mPolled[poll.first] = poll.second;
+    }
+}
+
+void WatchBudget::touch(const std::string& path, uint64_t now)
+{
+    auto it = mEntries.find(path);
+    if (it == mEntries.end() || it->second->lastActive == now) {
+        return;
+    }
+
+    Entry entry = *it->second;
+    mOrder.erase(it->second);
+    entry.lastActive = now;
+    it->second = mOrder.insert(std::move(entry)).first;
+}
+
+void WatchBudget::addPolled(const std::string& path, int64_t mtimeNs)
+{
+    mPolled[path] = mtimeNs;
+}
+
+bool WatchBudget::removePolled(const std::string& path)
+{
+    return mPolled.erase(path) > 0;
+}
+
+void WatchBudget::setPolledMtime(const std::string& path, int64_t mtimeNs)
+{
+    auto it = mPolled.find(path);
+    if (it != mPolled.end()) {
+        it->second = mtimeNs;
+    }
+}
+
+void WatchBudget::polledDirs(std::vector<std::pair<std::string, int64_t>>& dirs) const
+{
+    dirs.assign(mPolled.begin(), mPolled.end());
+}
+
+} // namespace kmre
@@ -0,0 +1,115 @@
+/*
+ * Copyright (c) KylinSoft Co., Ltd. 2016-2024.All rights reserved.
+ *
+ * Authors:
+ *  Ma Chao    machao@kylinos.cn
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef WATCHBUDGET_H
+#define WATCHBUDGET_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <set>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "utils.h"
+
+namespace kmre {
+
+// Decides which directories of the media tree get an inotify watch once
+// fs.inotify.max_user_watches would be exceeded. Shallow directories and
+// those with recent events keep their watches; the coldest one (deepest,
+// then longest idle) gives its watch up to a hotter newcomer and is polled
+// by mtime instead. Not thread safe, FileInotifyService guards it with its
+// watcher lock.
+class WatchBudget
+{
+public:
+    WatchBudget();
+
+    // fs.inotify.max_user_watches, 0 if it can not be read
+    static size_t systemLimit();
+
+    // 0 means unlimited
+    void setBudget(size_t budget);
+    size_t budget() const { return mBudget; }
+    // The kernel refused a watch (ENOSPC): keep to what is in use now.
+    void shrinkToUsage();
+
+    // path asks for a watch, lastActive is 0 for directories found by a
+    // scan. Returns false if it must be polled instead. If another
+    // directory has to give its watch up first, it is moved to evicted.
+    bool admit(const std::string& path, uint64_t lastActive, std::string& evicted);
+    // the watch of path is gone
+    void release(const std::string& path);
+    // path and everything below it lost their watches or polls
+    void releaseTree(const std::string& path);
+    // a watched directory was renamed, carry it and its subtree over
+    void moveTree(const std::string& from, const std::string& to);
+    // events arrived in path
+    void touch(const std::string& path, uint64_t now);
+    size_t watchedCount() const { return mEntries.size(); }
+
+    void addPolled(const std::string& path, int64_t mtimeNs);
+    bool removePolled(const std::string& path);
+    bool isPolled(const std::string& path) const { return mPolled.count(path) > 0; }
+    void setPolledMtime(const std::string& path, int64_t mtimeNs);
+    void polledDirs(std::vector<std::pair<std::string, int64_t>>& dirs) const;
+    size_t polledCount() const { return mPolled.size(); }
+
+private:
+    struct Entry
+    {
+        int depth;
+        uint64_t lastActive;
+        std::string path;
+    };
+
+    // coldest first: deepest, then idle longest
+    struct Colder
+    {
+        bool operator()(const Entry& a, const Entry& b) const
+        {
+            if (a.depth != b.depth) {
+                return a.depth > b.depth;
+            }
+            if (a.lastActive != b.lastActive) {
+                return a.lastActive < b.lastActive;
+            }
+            return a.path < b.path;
+        }
+    };
+
+    static int depthOf(const std::string& path);
+    static bool isUnder(const std::string& path, const std::string& dir);
+    void insert(const std::string& path, int depth, uint64_t lastActive);
+
+    size_t mBudget;
+    std::set<Entry, Colder> mOrder;
+    std::unordered_map<std::string, std::set<Entry, Colder>::iterator> mEntries;
+    // polled directory -> mtime seen by the last poll
+    std::unordered_map<std::string, int64_t> mPolled;
+
+    DISALLOW_COPY_AND_ASSIGN(WatchBudget);
+};
+
+} // namespace kmre
+
+#endif // WATCHBUDGET_H
@@ -0,0 +1,234 @@
+/*
+ * Copyright (c) KylinSoft Co., Ltd. 2016-2024.All rights reserved.
+ *
+ * Authors:
+ *  Ma Chao    machao@kylinos.cn
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "watch-engine.h"
+
+#include <QMutexLocker>
+
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/syslog.h>
+
+// after a failed read, before trying again
+#define READ_RETRY_MS 1000
+
+namespace kmre {
+
+WatchEngine* WatchEngine::m_pInstance = nullptr;
+QMutex WatchEngine::lock;
+
+WatchEngine* WatchEngine::getInstance()
+{
+    if (nullptr == m_pInstance) {
+        QMutexLocker _l(&lock);
+        if (nullptr == m_pInstance) {
+            m_pInstance = new WatchEngine;
+        }
+    }
+
+    return m_pInstance;
+}
+
+WatchEngine::WatchEngine()
+    : mInitialized(false),
+      mIsRunning(false),
+      mStop(false)
+{
+    for (int role = 0; role < WATCH_ROLE_COUNT; role++) {
+        mHandlers[role] = nullptr;
+    }
+}
+
+WatchEngine::~WatchEngine()
+{
+    mStop = true;
+    if (mThread.joinable()) {
+        mThread.join();
+    }
+    mWatcher.cleanup();
+}
+
+int WatchEngine::initialize()
+{
+    QMutexLocker _l(&lock);
+
+    if (mInitialized) {
+        return 0;
+    }
+
+    if (mWatcher.initialize() < 0) {
+        return -1;
+    }
+
+    mInitialized = true;
+    return 0;
+}
+
+void WatchEngine::start()
+{
+    if (!mInitialized) {
+        return;
+    }
+
+    if (mIsRunning.exchange(true)) {
+        return;
+    }
+
+    mStop = false;
+    mThread = std::thread(&WatchEngine::run, this);
+}
+
+void WatchEngine::setHandler(int role, WatchHandler* handler)
+{
+    if (role < 0 || role >= WATCH_ROLE_COUNT) {
+        return;
+    }
+
+    QMutexLocker _l(&mHandlerLock);
+    mHandlers[role] = handler;
+}
+
+int WatchEngine::addWatch(const QString& path, int role, int mask)
+{
+    if (!mInitialized || role < 0 || role >= WATCH_ROLE_COUNT) {
+        return -1;
+    }
+
+    return mWatcher.addWatch(path, mask, role);
+}
+
+int WatchEngine::removeWatch(const QString& path, int role)
+{
+    if (!mInitialized || role < 0 || role >= WATCH_ROLE_COUNT) {
+        return -1;
+    }
+
+    return mWatcher.removeWatch(path, role);
+}
+
+int WatchEngine::removeWatch(int wd)
+{
+    return mWatcher.removeWatch(wd);
+}
+
+int WatchEngine::removeWatchTree(const QString& path, int role, std::vector<std::string>* removed)
+{
+    if (!mInitialized || role < 0 || role >= WATCH_ROLE_COUNT) {
+        return -1;
+    }
+
+    return mWatcher.removeWatchTree(path, role, removed);
+}
+
+bool WatchEngine::moveWatch(const QString& path, const QString& newPath)
+{
+    return mWatcher.moveWatch(path, newPath);
+}
+
+bool WatchEngine::watchedPathFromWd(int wd, std::string& path)
+{
+    return mWatcher.watchedPathFromWd(wd, path);
+}
+
+int WatchEngine::wdFromWatchedPath(const QString& path)
+{
+    return mWatcher.wdFromWatchedPath(path);
+}
+
+size_t WatchEngine::watchCount()
+{
+    return mWatcher.watchCount();
+}
+
+QStringList WatchEngine::watchedPaths(int role)
+{
+    return mWatcher.watchedPaths(role);
+}
+
+void WatchEngine::dispatchLocked(const struct inotify_event* event)
+{
+    if (event->mask & IN_Q_OVERFLOW) {
+        for (int role = 0; role < WATCH_ROLE_COUNT; role++) {
+            if (mHandlers[role]) {
+                mHandlers[role]->onWatchOverflow(role);
+            }
+        }
+        return;
+    }
+
+    // resolved before dispatching, handlers may drop the watch
+    size_t count = mWatcher.watchTargetsFromWd(event->wd, mTargets);
+    for (size_t i = 0; i < count; i++) {
+        for (int role = 0; role < WATCH_ROLE_COUNT; role++) {
+            if (!mHandlers[role] || !(mTargets[i].roles & WATCH_ROLE_BIT(role))) {
+                continue;
+            }
+            // a shared watch carries the events of every role, each gets
+            // what it asked for on this path
+            if (event->mask & ((mTargets[i].masks[role] & IN_ALL_EVENTS) | IN_IGNORED | IN_UNMOUNT)) {
+                mHandlers[role]->onWatchEvent(role, mTargets[i].path, event);
+            }
+        }
+    }
+
+    /* 内核已移除该监控（目录被删除或卸载），清理所有角色的记录 */
+    if (event->mask & IN_IGNORED) {
+        mWatcher.forgetWatch(event->wd);
+    }
+}
+
+void WatchEngine::run()
+{
+    std::vector<struct inotify_event*> events;
+    bool failing = false;
+
+    syslog(LOG_DEBUG, "WatchEngine: Event thread started.");
+
+    while (!mStop) {
+        int count = mWatcher.readEvents(1000, events);
+        if (count < 0) {
+            /* inotify fd出错时不能空转占满CPU，记录一次后定期重试 */
+            if (!failing) {
+                syslog(LOG_ERR, "WatchEngine: Failed to read events: %s", strerror(errno));
+                failing = true;
+            }
+            usleep(READ_RETRY_MS * 1000);
+            continue;
+        }
+        failing = false;
+        if (count == 0) {
+            continue;
+        }
+
+        QMutexLocker _l(&mHandlerLock);
+        for (const struct inotify_event* event : events) {
+            dispatchLocked(event);
+        }
+        for (int role = 0; role < WATCH_ROLE_COUNT; role++) {
+            if (mHandlers[role]) {
+                mHandlers[role]->onWatchBatchEnd(role);
+            }
+        }
+    }
+
+    mIsRunning = false;
+}
+
+} // namespace kmre
@@ -0,0 +1,109 @@
+/*
+ * Copyright (c) KylinSoft Co., Ltd. 2016-2024.All rights reserved.
+ *
+ * Authors:
+ *  Ma Chao    machao@kylinos.cn
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef WATCHENGINE_H
+#define WATCHENGINE_H
+
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <sys/inotify.h>
+
+#include <QMutex>
+#include <QString>
+#include <QStringList>
+
+#include "file-inotify-watcher.h"
+#include "utils.h"
+
+namespace kmre {
+
+// Receives the events of one WatchRole, always on the engine thread.
+class WatchHandler
+{
+public:
+    virtual ~WatchHandler() {}
+
+    // path is the watched path the event was reported for, event->name the
+    // entry inside it when event->len > 0
+    virtual void onWatchEvent(int role, const std::string& path, const struct inotify_event* event) = 0;
+    // the kernel queue overflowed, events of every role may be lost
+    virtual void onWatchOverflow(int role) { (void)role; }
+    // every event of the current batch has been dispatched
+    virtual void onWatchBatchEnd(int role) { (void)role; }
+};
+
+// The one inotify instance of the process. FileWatcher's link directories,
+// the path check scheduler and the media service subscribe role tagged
+// watches on it, and a single thread reads and decodes the events and
+// dispatches them to the handler of each role holding the watch. It lives
+// for the whole process, handlers unregister themselves with setHandler().
+class WatchEngine
+{
+public:
+    static WatchEngine* getInstance();
+
+    int initialize();
+    // start the event thread once, later calls do nothing
+    void start();
+
+    // handler may be nullptr; returns once no event is being dispatched
+    // to the previous handler
+    void setHandler(int role, WatchHandler* handler);
+
+    int addWatch(const QString& path, int role, int mask);
+    int removeWatch(const QString& path, int role);
+    int removeWatch(int wd);
+    int removeWatchTree(const QString& path, int role, std::vector<std::string>* removed = nullptr);
+    // rename path and everything below it, every role follows the move
+    bool moveWatch(const QString& path, const QString& newPath);
+
+    bool watchedPathFromWd(int wd, std::string& path);
+    int wdFromWatchedPath(const QString& path);
+    size_t watchCount();
+    QStringList watchedPaths(int role = -1);
+
+private:
+    WatchEngine();
+    ~WatchEngine();
+
+    void run();
+    void dispatchLocked(const struct inotify_event* event);
+
+    static WatchEngine* m_pInstance;
+    static QMutex lock;
+
+    FileInotifyWatcher mWatcher;
+    std::thread mThread;
+    std::atomic<bool> mInitialized;
+    std::atomic<bool> mIsRunning;
+    std::atomic<bool> mStop;
+    /* 派发期间持有，保证setHandler返回后旧的处理者不再被调用 */
+    QMutex mHandlerLock;
+    WatchHandler* mHandlers[WATCH_ROLE_COUNT];
+    std::vector<WatchTarget> mTargets;
+
+    DISALLOW_COPY_AND_ASSIGN(WatchEngine);
+};
+
+} // namespace kmre
+
+#endif // WATCHENGINE_H
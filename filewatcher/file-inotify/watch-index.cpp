@@ -0,0 +1,340 @@
+/*
+ * Copyright (c) KylinSoft Co., Ltd. 2016-2024.All rights reserved.
+ *
+ * Authors:
+ *  Ma Chao    machao@kylinos.cn
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "watch-index.h"
+
+#include <algorithm>
+#include <iterator>
+
+#define EMPTY_SLOT   (-1)
+#define DELETED_SLOT (-2)
+#define MIN_SLOTS    64
+
+namespace kmre {
+
+WatchIndex::WatchIndex()
+    : mSlots(MIN_SLOTS, { EMPTY_SLOT, nullptr }),
+      mCount(0),
+      mUsed(0)
+{
+    mRoot.parent = nullptr;
+    mRoot.wd = -1;
+    mRoot.roles = 0;
+    std::fill(std::begin(mRoot.masks), std::end(mRoot.masks), 0u);
+    mRoot.nextAlias = nullptr;
+}
+
+WatchIndex::~WatchIndex()
+{
+    clear();
+}
+
+void WatchIndex::deleteTree(Node* node)
+{
+    for (auto& child : node->children) {
+        deleteTree(child.second);
+        delete child.second;
+    }
+    node->children.clear();
+}
+
+void WatchIndex::clear()
+{
+    deleteTree(&mRoot);
+    mRoot.wd = -1;
+    mRoot.roles = 0;
+    mRoot.nextAlias = nullptr;
+    mSlots.assign(MIN_SLOTS, { EMPTY_SLOT, nullptr });
+    mCount = 0;
+    mUsed = 0;
+}
+
+WatchIndex::Node* WatchIndex::intern(const std::string& path)
+{
+    Node* node = &mRoot;
+    size_t pos = 0;
+
+    while (pos < path.size()) {
+        size_t end = path.find('/', pos);
+        if (end == std::string::npos) {
+            end = path.size();
+        }
+
+        if (end > pos) {
+            std::string name = path.substr(pos, end - pos);
+            auto it = node->children.find(name);
+            if (it == node->children.end()) {
+                Node* child = new Node;
+                child->parent = node;
+                child->name = name;
+                child->wd = -1;
+                child->roles = 0;
+                std::fill(std::begin(child->masks), std::end(child->masks), 0u);
+                child->nextAlias = nullptr;
+                it = node->children.emplace(std::move(name), child).first;
+            }
+            node = it->second;
+        }
+        pos = end + 1;
+    }
+
+    return node;
+}
+
+WatchIndex::Node* WatchIndex::find(const std::string& path) const
+{
+    const Node* node = &mRoot;
+    size_t pos = 0;
+
+    while (pos < path.size()) {
+        size_t end = path.find('/', pos);
+        if (end == std::string::npos) {
+            end = path.size();
+        }
+
+        if (end > pos) {
+            auto it = node->children.find(path.substr(pos, end - pos));
+            if (it == node->children.end()) {
+                return nullptr;
+            }
+            node = it->second;
+        }
+        pos = end + 1;
+    }
+
+    return const_cast<Node*>(node);
+}
+
+size_t WatchIndex::slotOf(int wd) const
+{
+    size_t mask = mSlots.size() - 1;
+    size_t i = ((size_t)(unsigned int)wd * 2654435761u) & mask;
+
+    while (true) {
+        const Slot& slot = mSlots[i];
+        if (slot.wd == wd || slot.wd == EMPTY_SLOT) {
+            return i;
+        }
+        i = (i + 1) & mask;
+    }
+}
+
+WatchIndex::Node* WatchIndex::lookup(int wd) const
+{
+    if (wd < 0) {
+        return nullptr;
+    }
+
+    const Slot& slot = mSlots[slotOf(wd)];
+    return slot.wd == wd ? slot.node : nullptr;
+}
+
+void WatchIndex::grow()
+{
+    std::vector<Slot> old;
+    old.swap(mSlots);
+
+    size_t size = MIN_SLOTS;
+    while (size < mCount * 4) {
+        size <<= 1;
+    }
+    mSlots.assign(size, { EMPTY_SLOT, nullptr });
+    mUsed = mCount;
+
+    for (const Slot& slot : old) {
+        if (slot.wd >= 0) {
+            mSlots[slotOf(slot.wd)] = slot;
+        }
+    }
+}
+
+void WatchIndex::bind(Node* node, int wd)
+{
+    if (!node || wd < 0 || node->wd == wd) {
+        return;
+    }
+
+    if (node->wd >= 0) {
+        unbind(node);
+    }
+
+    node->wd = wd;
+    node->nextAlias = nullptr;
+
+    Slot& slot = mSlots[slotOf(wd)];
+    if (slot.wd == wd) {
+        Node* last = slot.node;
+        while (last->nextAlias) {
+            last = last->nextAlias;
+        }
+        last->nextAlias = node;
+        return;
+    }
+
+    mCount++;
+    mUsed++;
+
+    // keep the load factor (including deleted slots) at or below 1/2
+    if (mUsed * 2 > mSlots.size()) {
+        grow();
+    }
+
+    Slot& fresh = mSlots[slotOf(wd)];
+    fresh.wd = wd;
+    fresh.node = node;
+}
+
+bool WatchIndex::unbind(Node* node)
+{
+    if (!node || node->wd < 0) {
+        return false;
+    }
+
+    int wd = node->wd;
+    node->wd = -1;
+
+    Slot& slot = mSlots[slotOf(wd)];
+    if (slot.wd != wd) {
+        node->nextAlias = nullptr;
+        return false;
+    }
+
+    if (slot.node == node) {
+        slot.node = node->nextAlias;
+    } else {
+        Node* prev = slot.node;
+        while (prev && prev->nextAlias != node) {
+            prev = prev->nextAlias;
+        }
+        if (prev) {
+            prev->nextAlias = node->nextAlias;
+        }
+    }
+    node->nextAlias = nullptr;
+
+    if (slot.node) {
+        return false;
+    }
+
+    slot.wd = DELETED_SLOT;
+    mCount--;
+    return true;
+}
+
+void WatchIndex::prune(Node* node)
+{
+    while (node && node != &mRoot && node->wd < 0 && node->children.empty()) {
+        Node* parent = node->parent;
+        parent->children.erase(node->name);
+        delete node;
+        node = parent;
+    }
+}
+
+void WatchIndex::pruneChildren(Node* node)
+{
+    for (auto it = node->children.begin(); it != node->children.end();) {
+        Node* child = it->second;
+        pruneChildren(child);
+        if (child->wd < 0 && child->children.empty()) {
+            delete child;
+            it = node->children.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
+void WatchIndex::pruneTree(Node* node)
+{
+    if (!node) {
+        return;
+    }
+
+    pruneChildren(node);
+    prune(node);
+}
+
+bool WatchIndex::move(Node* node, const std::string& path)
+{
+    if (!node || node == &mRoot || find(path)) {
+        return false;
+    }
+
+    size_t slash = path.find_last_of('/');
+    if (slash == std::string::npos || slash + 1 >= path.size()) {
+        return false;
+    }
+
+    Node* parent = intern(path.substr(0, slash));
+    for (Node* n = parent; n; n = n->parent) {
+        if (n == node) {
+            prune(parent);
+            return false;
+        }
+    }
+
+    Node* oldParent = node->parent;
+    oldParent->children.erase(node->name);
+    node->name = path.substr(slash + 1);
+    node->parent = parent;
+    parent->children.emplace(node->name, node);
+    prune(oldParent);
+
+    return true;
+}
+
+void WatchIndex::forEachNode(Node* node, const std::function<void(Node* node)>& func)
+{
+    func(node);
+    for (auto& child : node->children) {
+        forEachNode(child.second, func);
+    }
+}
+
+void WatchIndex::pathOf(const Node* node, std::string& out)
+{
+    size_t length = 0;
+    for (const Node* n = node; n && n->parent; n = n->parent) {
+        length += n->name.size() + 1;
+    }
+
+    out.resize(length);
+    size_t pos = length;
+    for (const Node* n = node; n && n->parent; n = n->parent) {
+        pos -= n->name.size();
+        out.replace(pos, n->name.size(), n->name);
+        out[--pos] = '/';
+    }
+
+    if (length == 0) {
+        out = "/";
+    }
+}
+
+void WatchIndex::forEachWd(const std::function<void(int wd)>& func) const
+{
+    for (const Slot& slot : mSlots) {
+        if (slot.wd >= 0) {
+            func(slot.wd);
+        }
+    }
+}
+
+} // namespace kmre
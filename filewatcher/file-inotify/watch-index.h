@@ -0,0 +1,119 @@
+/*
+ * Copyright (c) KylinSoft Co., Ltd. 2016-2024.All rights reserved.
+ *
+ * Authors:
+ *  Ma Chao    machao@kylinos.cn
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef WATCHINDEX_H
+#define WATCHINDEX_H
+
+#include <stddef.h>
+
+#include <functional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "utils.h"
+
+// roles a node can hold, see WatchRole
+#define WATCH_INDEX_ROLES 8
+
+namespace kmre {
+
+// Index of watched directories for FileInotifyWatcher.
+//
+// Paths are interned as a tree of nodes (parent pointer + one component), so
+// a path costs one short name per directory and a parent chain, and a watch
+// descriptor maps to its node through an open-addressing table. Looking up a
+// wd is O(1) and allocation free; the full path is only built on demand into
+// a caller-owned buffer.
+//
+// Not thread safe, the owner serializes access.
+class WatchIndex
+{
+public:
+    struct Node
+    {
+        Node* parent;
+        std::string name;
+        // -1 when the node only exists as the ancestor of watched nodes
+        int wd;
+        // bit set of the WatchRole subscriptions holding this watch
+        unsigned roles;
+        // inotify mask each role asked for, valid where roles has its bit
+        unsigned masks[WATCH_INDEX_ROLES];
+        // next path watched through the same wd (bind mounts and the like)
+        Node* nextAlias;
+        std::unordered_map<std::string, Node*> children;
+    };
+
+    WatchIndex();
+    ~WatchIndex();
+
+    // Find or create the node for an absolute path.
+    Node* intern(const std::string& path);
+    Node* find(const std::string& path) const;
+
+    // First path watched through wd, or nullptr.
+    Node* lookup(int wd) const;
+
+    // Record that node is watched by wd.
+    void bind(Node* node, int wd);
+    // Forget node's watch; return true when wd has no path left.
+    bool unbind(Node* node);
+    // Drop node and its ancestors while they are unwatched leaves.
+    void prune(Node* node);
+    // Same as prune(), but first drops the unwatched leaves below node.
+    void pruneTree(Node* node);
+    // Re-parent node under path, keeping its subtree and watches. Fails when
+    // path is already known or lies below node.
+    bool move(Node* node, const std::string& path);
+    // Visit node and everything below it, parents first. func must not
+    // change the tree.
+    void forEachNode(Node* node, const std::function<void(Node* node)>& func);
+
+    // Build the absolute path of node into out, reusing its capacity.
+    static void pathOf(const Node* node, std::string& out);
+
+    size_t watchCount() const { return mCount; }
+    void forEachWd(const std::function<void(int wd)>& func) const;
+    void clear();
+
+private:
+    struct Slot
+    {
+        int wd;
+        Node* node;
+    };
+
+    size_t slotOf(int wd) const;
+    void grow();
+    void deleteTree(Node* node);
+    void pruneChildren(Node* node);
+
+    Node mRoot;
+    // wd -> first node; wd == EMPTY_SLOT / DELETED_SLOT mark free entries
+    std::vector<Slot> mSlots;
+    size_t mCount;
+    size_t mUsed;
+
+    DISALLOW_COPY_AND_ASSIGN(WatchIndex);
+};
+
+} // namespace kmre
+
+#endif // WATCHINDEX_H
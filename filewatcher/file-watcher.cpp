@@ -32,22 +32,27 @@
 #include <QCoreApplication>
 #include <QtDBus/QDBusConnection>
 #include <QtDBus/QDBusMessage>
-#include <QTimer>
 
+#include <limits.h>
 #include <pwd.h>
 #include <sys/types.h>
 #include <unistd.h>
 #include <sys/stat.h>
 #include <sys/syslog.h>
+#include <sys/inotify.h>
 
 #include "file-watcher.h"
 #include "custom.h"
+#include "mount-monitor.h"
+#include "file-inotify/file-inotify-service.h"
 
 namespace kmre {
 
 static const QString kydroidDataPrefix = "/var/lib/kydroid/data";
 static const QString kmreDataPrefix = "/var/lib/kmre/data";
 
+#define LINK_WATCH_MASK (IN_ATTRIB | IN_MODIFY | IN_MOVE | IN_CREATE | IN_DELETE | IN_DELETE_SELF | IN_MOVE_SELF)
+
 FileWatcher* FileWatcher::m_pInstance = nullptr;
 
 QString FileWatcher::legacyContainerName()
@@ -102,10 +107,19 @@ const QString& getUserName()
 
 FileWatcher::FileWatcher(QObject *parent)
     : QObject(parent),
-      m_pSystemWatcher(nullptr),
+      m_pEngine(WatchEngine::getInstance()),
       mRunning(0),
-      mMutex(QMutex::Recursive)
+      m_pScheduler(new PathCheckScheduler(this)),
+      mMutex(QMutex::Recursive),
+      mLinkRecord(QStandardPaths::writableLocation(QStandardPaths::HomeLocation) + "/.kmre/kylin-kmre-filewatcher.links")
 {
+    // 调度器在主线程发出的结果统一排队处理，避免在 run() 持锁期间重入
+    connect(m_pScheduler, SIGNAL(addPath(QString)), this, SLOT(addWatchPath(QString)), Qt::QueuedConnection);
+    connect(m_pScheduler, SIGNAL(pendingAddPath(QString)), this, SLOT(pendingAddWatchPath(QString)), Qt::QueuedConnection);
+    connect(m_pScheduler, SIGNAL(dependAddPath(QString)), this, SLOT(dependAddWatchPath(QString)), Qt::QueuedConnection);
+    connect(m_pScheduler, SIGNAL(linkAddPath(QString)), this, SLOT(linkAddWatchPath(QString)), Qt::QueuedConnection);
+    connect(m_pScheduler, SIGNAL(statusChanged(QString)), this, SLOT(storageStatusChanged(QString)), Qt::QueuedConnection);
+
     mUid = getuid();
     mUserName = getUserName();
     if (mUserName.isEmpty() || mUserName.isNull()) {
@@ -121,74 +135,18 @@ FileWatcher::FileWatcher(QObject *parent)
                                              QString("/cn/kylinos/Kmre"),
                                              QString("cn.kylinos.Kmre"),
                                              QString("Stopped"), this, SLOT(onContainerStopped(QString)));
-
-    prepareDirectoryAndStorage();
 }
 
 FileWatcher::~FileWatcher()
 {
     QMutexLocker lock(&mMutex);
-    QMap<QString, DirectoryCheckWorker*>::iterator directoryWorkerIter;
-    QMap<QString, StorageCheckWorker*>::iterator storageWorkerIter;
-    QMap<QString, QThread*>::iterator threadIter;
-
-    for (directoryWorkerIter = mDirectoryWorkers.begin(); directoryWorkerIter != mDirectoryWorkers.end();) {
-        directoryWorkerIter.value()->deleteLater();
-        directoryWorkerIter++;
-    }
-    mDirectoryWorkers.clear();
-
-    for (storageWorkerIter = mStorageWorkers.begin(); storageWorkerIter != mStorageWorkers.end();) {
-        storageWorkerIter.value()->deleteLater();
-        storageWorkerIter++;
-    }
-    mStorageWorkers.clear();
-
-    for (threadIter = mThreads.begin(); threadIter != mThreads.end();) {
-        threadIter.value()->quit();
-        threadIter.value()->deleteLater();
-        threadIter++;
-    }
-    mThreads.clear();
+    mCheckPaths.clear();
 
-    if (m_pSystemWatcher) {
-        if (m_pSystemWatcher->files().size() > 0) {
-            m_pSystemWatcher->removePaths(m_pSystemWatcher->files());
-        }
-        if (m_pSystemWatcher->directories().size() > 0) {
-            m_pSystemWatcher->removePaths(m_pSystemWatcher->directories());
+    for (int role = WATCH_ROLE_NORMAL; role <= WATCH_ROLE_LINK; role++) {
+        m_pEngine->setHandler(role, nullptr);
+        for (const QString& path : m_pEngine->watchedPaths(role)) {
+            m_pEngine->removeWatch(path, role);
         }
-        m_pSystemWatcher->deleteLater();
-    }
-
-    if (m_pPendingWatcher) {
-        if (m_pPendingWatcher->files().size() > 0) {
-            m_pPendingWatcher->removePaths(m_pPendingWatcher->files());
-        }
-        if (m_pPendingWatcher->directories().size() > 0) {
-            m_pPendingWatcher->removePaths(m_pPendingWatcher->directories());
-        }
-        m_pPendingWatcher->deleteLater();
-    }
-
-    if (m_pDependWatcher) {
-        if (m_pDependWatcher->files().size() > 0) {
-            m_pDependWatcher->removePaths(m_pDependWatcher->files());
-        }
-        if (m_pDependWatcher->directories().size() > 0) {
-            m_pDependWatcher->removePaths(m_pDependWatcher->directories());
-        }
-        m_pDependWatcher->deleteLater();
-    }
-
-    if (m_pLinkWatcher) {
-        if (m_pLinkWatcher->files().size() > 0) {
-            m_pLinkWatcher->removePaths(m_pLinkWatcher->files());
-        }
-        if (m_pLinkWatcher->directories().size() > 0) {
-            m_pLinkWatcher->removePaths(m_pLinkWatcher->directories());
-        }
-        m_pLinkWatcher->deleteLater();
     }
 }
 
@@ -230,55 +188,89 @@ void FileWatcher::prepareDirectoryAndStorage()
     QString qqFileName = "QQfile_recv";
     QString qqFileLink = "../" + qqFileName;
 
-    QFileInfoList infoList = desktopDir.entryInfoList(QDir::AllEntries | QDir::System);
-    QFileInfo dataInfo(dataDestPath);
-    dataInfo.setCaching(false);
-    dataInfo.refresh();
-    //bool dataEntryExists = dataInfo.exists() || dataInfo.isSymLink();
-    //qDebug() << "dataEntryExists " << dataEntryExists;
-    for (QFileInfo& info : infoList) {
-        if (info.isSymLink()) {
-            QString target = info.symLinkTarget();
-            //qDebug() << target;
-            //qDebug() << info.absolutePath();
-            //qDebug() << info.absoluteFilePath();
-            if (target == wxSourcePath ||
-                    target == dataSourcePath ||
-                    target == qqSourcePath ||
-                    target == legacyWxSourcePath ||
-                    target == legacyDataSourcePath ||
-                    target == legacyQqSourcePath) {
-                //qDebug() << "filePath:        " << info.filePath();
-                //qDebug() << "fileName:        " << info.fileName();
-                //qDebug() << "baseName:        " << info.baseName();
-                //qDebug() << "path:            " << info.path();
-                //qDebug() << "Mobile_App_Data: " << tr("Mobile_App_Data");
-                /*
-                if (info.fileName() != tr("Mobile_App_Data")) {
-                    if (target == dataSourcePath && QFile::exists(dataSourcePath) && !dataEntryExists) {
-                        desktopDir.rename(info.fileName(), tr("Mobile_App_Data"));
-                        dataInfo.refresh();
-                        dataEntryExists = dataInfo.exists() || dataInfo.isSymLink();
-                        //qDebug() << "dataEntryExists " << dataEntryExists;
-                    } else {
-                        deleteLink(info.absoluteFilePath());
+    // links to the container data under one of the names used so far are removed
+    auto isObsoleteLink = [&](const QString& fileName, const QString& target) {
+        if (target != wxSourcePath &&
+                target != dataSourcePath &&
+                target != qqSourcePath &&
+                target != legacyWxSourcePath &&
+                target != legacyDataSourcePath &&
+                target != legacyQqSourcePath) {
+            return false;
+        }
+        return fileName == tr("Mobile_App_Data")
+                || fileName == tr("Android_Data")
+                || fileName == tr("Wechat_Data")
+                || fileName == tr("QQ_Data")
+                || fileName == "Mobile_App_Data"
+                || fileName == "Android_Data"
+                || fileName == "Wechat_Data"
+                || fileName == "QQ_Data";
+    };
+
+    /* 有记录时只校验记录中的链接，避免遍历整个桌面（桌面文件多或家目录在NFS上时很慢） */
+    QStringList obsoleteLinks;
+    if (mLinkRecord.load()) {
+        for (const LinkRecord::Link& link : mLinkRecord.links()) {
+            struct stat sb;
+            char target[PATH_MAX];
+            const QByteArray path = link.path.toLocal8Bit();
+            ssize_t len = -1;
+
+            if (lstat(path.constData(), &sb) == 0 && S_ISLNK(sb.st_mode) && (quint64)sb.st_ino == link.ino) {
+                len = readlink(path.constData(), target, sizeof(target));
+            }
+            // gone, or replaced by the user since: no longer ours
+            if (len < 0 || QString::fromLocal8Bit(target, (int)len) != link.target) {
+                mLinkRecord.remove(link.path);
+                continue;
+            }
+
+            QFileInfo info(link.path);
+            if (isObsoleteLink(info.fileName(), info.symLinkTarget())) {
+                obsoleteLinks.append(link.path);
+            }
+        }
+    } else {
+        // no record yet: links left by earlier versions can only be found by listing
+        QFileInfoList infoList = desktopDir.entryInfoList(QDir::AllEntries | QDir::System);
+        QFileInfo dataInfo(dataDestPath);
+        dataInfo.setCaching(false);
+        dataInfo.refresh();
+        //bool dataEntryExists = dataInfo.exists() || dataInfo.isSymLink();
+        //qDebug() << "dataEntryExists " << dataEntryExists;
+        for (QFileInfo& info : infoList) {
+            if (info.isSymLink()) {
+                QString target = info.symLinkTarget();
+                //qDebug() << target;
+                //qDebug() << info.absolutePath();
+                //qDebug() << info.absoluteFilePath();
+                if (isObsoleteLink(info.fileName(), target)) {
+                    //qDebug() << "filePath:        " << info.filePath();
+                    //qDebug() << "fileName:        " << info.fileName();
+                    //qDebug() << "baseName:        " << info.baseName();
+                    //qDebug() << "path:            " << info.path();
+                    //qDebug() << "Mobile_App_Data: " << tr("Mobile_App_Data");
+                    /*
+                    if (info.fileName() != tr("Mobile_App_Data")) {
+                        if (target == dataSourcePath && QFile::exists(dataSourcePath) && !dataEntryExists) {
+                            desktopDir.rename(info.fileName(), tr("Mobile_App_Data"));
+                            dataInfo.refresh();
+                            dataEntryExists = dataInfo.exists() || dataInfo.isSymLink();
+                            //qDebug() << "dataEntryExists " << dataEntryExists;
+                        } else {
+                            deleteLink(info.absoluteFilePath());
+                        }
                     }
-                }
-                */
-                QString fileName = info.fileName();
-                if (fileName == tr("Mobile_App_Data")
-                        || fileName == tr("Android_Data")
-                        || fileName == tr("Wechat_Data")
-                        || fileName == tr("QQ_Data")
-                        || fileName == "Mobile_App_Data"
-                        || fileName == "Android_Data"
-                        || fileName == "Wechat_Data"
-                        || fileName == "QQ_Data") {
-                    deleteLink(info.absoluteFilePath());
+                    */
+                    obsoleteLinks.append(info.absoluteFilePath());
                 }
             }
         }
     }
+    deleteLinks(obsoleteLinks);
+    // the first run also writes the record, empty or not
+    mLinkRecord.save();
 
     //mHashDirectory.insert(wxSourcePath, { wxDestPath, wxIconPath, false } );
 
@@ -321,28 +313,30 @@ FileWatcher* FileWatcher::GetInstance()
 {
     if (m_pInstance == nullptr) {
         m_pInstance = new FileWatcher();
-        m_pInstance->m_pSystemWatcher = new QFileSystemWatcher();
-        m_pInstance->m_pPendingWatcher = new QFileSystemWatcher();
-        m_pInstance->m_pDependWatcher = new QFileSystemWatcher();
-        m_pInstance->m_pLinkWatcher = new QFileSystemWatcher();
-
-        connect(m_pInstance->m_pSystemWatcher, SIGNAL(directoryChanged(QString)), m_pInstance, SLOT(directoryUpdated(QString)));
-        connect(m_pInstance->m_pSystemWatcher, SIGNAL(fileChanged(QString)), m_pInstance, SLOT(fileUpdated(QString)));
 
-        connect(m_pInstance->m_pPendingWatcher, SIGNAL(directoryChanged(QString)), m_pInstance, SLOT(pendingDirectoryUpdated(QString)));
-        connect(m_pInstance->m_pDependWatcher, SIGNAL(directoryChanged(QString)), m_pInstance, SLOT(dependDirectoryUpdated(QString)));
-        connect(m_pInstance->m_pLinkWatcher, SIGNAL(directoryChanged(QString)), m_pInstance, SLOT(linkDirectoryUpdated(QString)));
+        WatchEngine* engine = m_pInstance->m_pEngine;
+        if (engine->initialize() < 0) {
+            syslog(LOG_ERR, "FileWatcher: Failed to initialize watch engine.");
+        }
+        for (int role = WATCH_ROLE_NORMAL; role <= WATCH_ROLE_LINK; role++) {
+            engine->setHandler(role, m_pInstance);
+        }
+        engine->start();
     }
 
     return m_pInstance;
 }
 
+QString FileWatcher::installedFilePath()
+{
+    return "/var/lib/kmre/" + mContainerName + "/data/local/tmp/installed.json";
+}
+
 bool FileWatcher::shouldRun()
 {
     QJsonParseError err;
     QByteArray json;
-    QString installedFilePath = "/var/lib/kmre/" + mContainerName + "/data/local/tmp/installed.json";
-    QFile installedFile(installedFilePath);
+    QFile installedFile(installedFilePath());
 
     if (!installedFile.exists()) {
         //qDebug() << "File " + installedFilePath + " doesn't exist.";
@@ -391,11 +385,8 @@ void FileWatcher::run()
         return;
     }
 
-    if (!shouldRun()) {
-        QTimer::singleShot(5000, [=] () {
-            qApp->quit();
-        });
-    }
+    // the Desktop location is only right once user-dirs.dirs exists
+    prepareDirectoryAndStorage();
 
     {
         QHashIterator<QString, LinkDestination> directoryIter(mHashDirectory);
@@ -406,15 +397,7 @@ void FileWatcher::run()
                 QMutexLocker lock(&mMutex);
                 QString destination = directoryIter.value().destination;
                 QString source = directoryIter.key();
-                DirectoryCheckWorker* worker = new DirectoryCheckWorker(source);
-                mDirectoryWorkers.insert(source, worker);
-                QThread *t = new QThread();
-                mThreads.insert(source, t);
-                connect(this, SIGNAL(check(QString, int)), worker, SLOT(doCheck(QString, int)));
-                connect(worker, SIGNAL(addPath(QString)), this, SLOT(addWatchPath(QString)));
-
-                worker->moveToThread(t);
-                t->start();
+                mCheckPaths.insert(source);
 
                 {
                     QFile file(source);
@@ -423,7 +406,7 @@ void FileWatcher::run()
                     }
                 }
 
-                emit check(source, CHECK_TYPE_NORMAL);
+                m_pScheduler->doCheck(source, CHECK_TYPE_NORMAL);
             }
         }
     }
@@ -438,15 +421,7 @@ void FileWatcher::run()
                 QString dependPath = pendingIter.value().dependPath;
                 QString pendingPath = pendingIter.value().pendingPath;
                 QString pendingName = pendingIter.value().pendingName;
-                DirectoryCheckWorker *worker = new DirectoryCheckWorker(sourcePath);
-                mDirectoryWorkers.insert(sourcePath, worker);
-                QThread *t = new QThread();
-                mThreads.insert(sourcePath, t);
-                connect(this, SIGNAL(check(QString,int)), worker, SLOT(doCheck(QString,int)));
-                connect(worker, SIGNAL(pendingAddPath(QString)), this, SLOT(pendingAddWatchPath(QString)));
-
-                worker->moveToThread(t);
-                t->start();
+                mCheckPaths.insert(sourcePath);
 
                 {
                     QFile dependFile(dependPath);
@@ -463,7 +438,7 @@ void FileWatcher::run()
                     }
                 }
 
-                emit check(sourcePath, CHECK_TYPE_PENDING);
+                m_pScheduler->doCheck(sourcePath, CHECK_TYPE_PENDING);
             }
         }
     }
@@ -477,15 +452,7 @@ void FileWatcher::run()
                 QString destPath = dependIter.value().destLink.destination;
                 QString dependPath = dependIter.key();
                 QStringList directories = dependIter.value().directories;
-                DirectoryCheckWorker *worker = new DirectoryCheckWorker(dependPath);
-                mDirectoryWorkers.insert(dependPath, worker);
-                QThread *t = new QThread();
-                mThreads.insert(dependPath, t);
-                connect(this, SIGNAL(check(QString,int)), worker, SLOT(doCheck(QString,int)));
-                connect(worker, SIGNAL(dependAddPath(QString)), this, SLOT(dependAddWatchPath(QString)));
-
-                worker->moveToThread(t);
-                t->start();
+                mCheckPaths.insert(dependPath);
 
                 {
                     QFile dependFile(dependPath);
@@ -509,7 +476,7 @@ void FileWatcher::run()
                     }
                 }
 
-                emit check(dependPath, CHECK_TYPE_DEPEND);
+                m_pScheduler->doCheck(dependPath, CHECK_TYPE_DEPEND);
             }
         }
     }
@@ -521,17 +488,9 @@ void FileWatcher::run()
             {
                 QMutexLocker lock(&mMutex);
                 QString linkPath = linkIter.key();
-                DirectoryCheckWorker *worker = new DirectoryCheckWorker(linkPath);
-                mDirectoryWorkers.insert(linkPath, worker);
-                QThread *t = new QThread();
-                mThreads.insert(linkPath, t);
-                connect(this, SIGNAL(check(QString,int)), worker, SLOT(doCheck(QString,int)));
-                connect(worker, SIGNAL(linkAddPath(QString)), this, SLOT(linkAddWatchPath(QString)));
-
-                worker->moveToThread(t);
-                t->start();
+                mCheckPaths.insert(linkPath);
 
-                emit check(linkPath, CHECK_TYPE_LINK);
+                m_pScheduler->doCheck(linkPath, CHECK_TYPE_LINK);
             }
         }
     }
@@ -546,24 +505,11 @@ void FileWatcher::run()
                 QString destination = storageIter.value().destination;
                 QString source = storageIter.key();
                 QString iconPath = storageIter.value().iconPath;
-                StorageCheckWorker* worker = new StorageCheckWorker(source);
-                mStorageWorkers.insert(source, worker);
                 bool fuseMounted;
-                QThread *t = new QThread();
-                mThreads.insert(source, t);
-                connect(this, SIGNAL(checkStorage(QString, bool)), worker, SLOT(doCheck(QString,bool)));
-                connect(worker, SIGNAL(statusChanged(QString)), this, SLOT(storageStatusChanged(QString)));
-
-                worker->moveToThread(t);
-                t->start();
 
                 // make or delete link
                 {
-                    QStorageInfo info(source);
-                    if (info.isValid() &&
-                        info.isReady() &&
-                        (QString(info.device()) == QString("/dev/fuse")) &&
-                        (QString(info.fileSystemType()) == QString("fuse"))) {
+                    if (MountMonitor::GetInstance()->isFuseMounted(source)) {
                         if (storageIter.value().shouldCreate) {
                             makeLink(destination, source, iconPath);
                         }
@@ -577,7 +523,7 @@ void FileWatcher::run()
                     }
                 }
 
-                emit checkStorage(source, fuseMounted);
+                m_pScheduler->doCheckStorage(source, fuseMounted);
             }
         }
     }
@@ -604,15 +550,7 @@ void FileWatcher::storageStatusChanged(const QString &path)
     source = iter.key();
     iconPath = iter.value().iconPath;
 
-    QStorageInfo info(path);
-    if (!info.isReady() || !info.isValid()) {
-        deleteLink(destination);
-        emit checkStorage(path, false);
-        return;
-    }
-
-    if ((QString(info.device()) == QString("/dev/fuse")) &&
-            (QString(info.fileSystemType()) == QString("fuse"))) {
+    if (MountMonitor::GetInstance()->isFuseMounted(path)) {
         if (iter.value().shouldCreate) {
             makeLink(destination, source, iconPath);
         }
@@ -625,7 +563,7 @@ void FileWatcher::storageStatusChanged(const QString &path)
         deleteLink(destination);
     }
 
-    emit checkStorage(path, fuseMounted);
+    m_pScheduler->doCheckStorage(path, fuseMounted);
 }
 
 void FileWatcher::start()
@@ -637,6 +575,21 @@ void FileWatcher::stop()
     qApp->quit();
 }
 
+QVariantMap FileWatcher::getWatchStats()
+{
+    QVariantMap stats;
+    FileInotifyService::WatchStats watchStats = FileInotifyService::getInstance()->watchStats();
+
+    stats.insert("backend", watchStats.fanotify ? "fanotify" : "inotify");
+    stats.insert("watched", watchStats.watched);
+    stats.insert("polled", watchStats.polled);
+    stats.insert("budget", watchStats.budget);
+    stats.insert("max_user_watches", watchStats.limit);
+    stats.insert("total_watches", watchStats.total);
+
+    return stats;
+}
+
 void FileWatcher::onContainerStopped(const QString &container)
 {
     if (container == mContainerName) {
@@ -650,7 +603,7 @@ void FileWatcher::addWatchPath(const QString &path)
 {
     //qDebug() << QString("Add to watch: %1").arg(path);
 
-    m_pSystemWatcher->addPath(path);
+    watchPath(path, WATCH_ROLE_NORMAL);
     QHash<QString, LinkDestination>::const_iterator iter = mHashDirectory.find(path);
     if (iter == mHashDirectory.end()) {
         return;
@@ -666,7 +619,7 @@ void FileWatcher::pendingAddWatchPath(const QString &path)
 {
     //qDebug() << QString("Pending Add to watch: %1").arg(path);
 
-    m_pPendingWatcher->addPath(path);
+    watchPath(path, WATCH_ROLE_PENDING);
     QHash<QString, PendingDirectory>::const_iterator iter = mHashPending.find(path);
     if (iter == mHashPending.end()) {
         return;
@@ -691,7 +644,7 @@ void FileWatcher::pendingAddWatchPath(const QString &path)
 void FileWatcher::linkAddWatchPath(const QString &path)
 {
     //qDebug() << QString("Link Add to watch: %1").arg(path);
-    m_pLinkWatcher->addPath(path);
+    watchPath(path, WATCH_ROLE_LINK);
     QHash<QString, LinkInfo>::const_iterator iter = mHashLink.find(path);
     if (iter == mHashLink.end()) {
         return;
@@ -706,7 +659,7 @@ void FileWatcher::dependAddWatchPath(const QString &path)
 {
     //qDebug() << QString("Depend Add to watch: %1").arg(path);
 
-    m_pDependWatcher->addPath(path);
+    watchPath(path, WATCH_ROLE_DEPEND);
     dependMakeLink(path);
 }
 
@@ -781,7 +734,7 @@ void FileWatcher::directoryUpdated(const QString &path)
         //qDebug() << QString("Directory changed: %1").arg(path);
     } else {
         //qDebug() << QString("Directory removed: %1").arg(path);
-        m_pSystemWatcher->removePath(path);
+        unwatchPath(path, WATCH_ROLE_NORMAL);
         QHash<QString, LinkDestination>::const_iterator iter = mHashDirectory.find(path);
         if (iter != mHashDirectory.end()) {
             deleteLink(iter.value().destination);
@@ -790,8 +743,8 @@ void FileWatcher::directoryUpdated(const QString &path)
         {
 
             QMutexLocker lock(&mMutex);
-            if (mDirectoryWorkers.contains(path)) {
-                emit check(path, CHECK_TYPE_NORMAL);
+            if (mCheckPaths.contains(path)) {
+                m_pScheduler->doCheck(path, CHECK_TYPE_NORMAL);
             }
 
         }
@@ -807,7 +760,7 @@ void FileWatcher::linkDirectoryUpdated(const QString &path)
         //qDebug() << QString("Directory changed: %1").arg(path);
     } else {
         //qDebug() << QString("Directory removed: %1").arg(path);
-        m_pLinkWatcher->removePath(path);
+        unwatchPath(path, WATCH_ROLE_LINK);
         QHash<QString, LinkInfo>::const_iterator iter = mHashLink.find(path);
         if (iter != mHashLink.end()) {
             deleteLink(iter.value().destination);
@@ -835,7 +788,7 @@ void FileWatcher::pendingDirectoryUpdated(const QString &path)
         //qDebug() << QString("Pending directory changed: %1").arg(path);
     } else {
         //qDebug() << QString("Pending directory removed: %1").arg(path);
-        m_pPendingWatcher->removePath(path);
+        unwatchPath(path, WATCH_ROLE_PENDING);
         if (iter != mHashPending.end()) {
             deleteLink(iter.value().pendingPath + "/" + iter.value().pendingName);
         }
@@ -844,8 +797,8 @@ void FileWatcher::pendingDirectoryUpdated(const QString &path)
 
         {
             QMutexLocker lock(&mMutex);
-            if (mDirectoryWorkers.contains(path)) {
-                emit check(path, CHECK_TYPE_PENDING);
+            if (mCheckPaths.contains(path)) {
+                m_pScheduler->doCheck(path, CHECK_TYPE_PENDING);
             }
         }
     }
@@ -872,13 +825,13 @@ void FileWatcher::dependDirectoryUpdated(const QString &path)
         }
     } else {
         //qDebug() << QString("Depend directory removed: %1").arg(path);
-        m_pDependWatcher->removePath(path);
+        unwatchPath(path, WATCH_ROLE_DEPEND);
         dependDeleteLink(path);
 
         {
             QMutexLocker lock(&mMutex);
-            if (mDirectoryWorkers.contains(path)) {
-                emit check(path, CHECK_TYPE_DEPEND);
+            if (mCheckPaths.contains(path)) {
+                m_pScheduler->doCheck(path, CHECK_TYPE_DEPEND);
             }
         }
     }
@@ -892,68 +845,156 @@ void FileWatcher::fileUpdated(const QString &path)
         //qDebug() << QString("Directory changed: %1").arg(path);
     } else {
         //qDebug() << QString("Directory removed: %1").arg(path);
-        m_pSystemWatcher->removePath(path);
+        unwatchPath(path, WATCH_ROLE_NORMAL);
     }
 }
 
 
-void FileWatcher::makeLink(const QString &dest, const QString &source, const QString &iconPath)
+void FileWatcher::watchPath(const QString &path, int role)
 {
-    QFile file(dest);
-    QString linkPath;
+    if (m_pEngine->addWatch(path, role, LINK_WATCH_MASK) < 0) {
+        syslog(LOG_WARNING, "FileWatcher: Failed to watch %s.", path.toStdString().c_str());
+    }
+}
 
+void FileWatcher::unwatchPath(const QString &path, int role)
+{
+    m_pEngine->removeWatch(path, role);
+}
 
-    linkPath = file.symLinkTarget();
-    if (linkPath == source) {
-        return;
+void FileWatcher::onWatchEvent(int role, const std::string &path, const struct inotify_event *event)
+{
+    (void)event;
+
+    mChangedPaths.insert(qMakePair(role, QString::fromStdString(path)));
+}
+
+void FileWatcher::onWatchOverflow(int role)
+{
+    // the engine calls every role, one rescan covers them all
+    if (role == WATCH_ROLE_NORMAL) {
+        QMetaObject::invokeMethod(this, "rescanWatchedPaths", Qt::QueuedConnection);
     }
+}
 
-    if (linkPath.isEmpty() || linkPath.isNull()) {
-        if (file.exists()) {
-            // dest path is not a link file
-            return;
+void FileWatcher::onWatchBatchEnd(int role)
+{
+    (void)role;
+
+    /* 同一批内同一目录的多个事件只处理一次 */
+    for (const QPair<int, QString>& changed : mChangedPaths) {
+        QMetaObject::invokeMethod(this, "watchedPathChanged", Qt::QueuedConnection,
+                                  Q_ARG(QString, changed.second), Q_ARG(int, changed.first));
+    }
+    mChangedPaths.clear();
+}
+
+void FileWatcher::watchedPathChanged(const QString &path, int role)
+{
+    switch (role) {
+    case WATCH_ROLE_NORMAL:
+        if (mHashDirectory.contains(path)) {
+            directoryUpdated(path);
         } else {
-            QFile::link(source, dest);
-            file_set_custom_icon(dest.toStdString().c_str(), iconPath.toStdString().c_str());
+            fileUpdated(path);
         }
+        break;
+    case WATCH_ROLE_PENDING:
+        pendingDirectoryUpdated(path);
+        break;
+    case WATCH_ROLE_DEPEND:
+        dependDirectoryUpdated(path);
+        break;
+    case WATCH_ROLE_LINK:
+        linkDirectoryUpdated(path);
+        break;
+    default:
+        break;
     }
 }
 
+void FileWatcher::rescanWatchedPaths()
+{
+    for (int role = WATCH_ROLE_NORMAL; role <= WATCH_ROLE_LINK; role++) {
+        for (const QString& path : m_pEngine->watchedPaths(role)) {
+            watchedPathChanged(path, role);
+        }
+    }
+}
+
+void FileWatcher::makeLink(const QString &dest, const QString &source, const QString &iconPath)
+{
+    makeLinks({ { dest, source, iconPath } });
+}
+
 void FileWatcher::makeLink(const QString &dest, const QString &source)
 {
-    QFile file(dest);
-    QString linkPath;
+    makeLinks({ { dest, source, QString() } });
+}
+
+void FileWatcher::deleteLink(const QString &dest)
+{
+    deleteLinks({ dest });
+}
 
-    linkPath = file.symLinkTarget();
-    if (linkPath == source) {
+void FileWatcher::makeLinks(const QList<LinkRequest> &links)
+{
+    if (links.isEmpty()) {
         return;
     }
 
-    if (linkPath.isEmpty() || linkPath.isNull()) {
-        if (file.exists()) {
-            // dest path is not a link file
-            return;
-        } else {
-            QFile::link(source, dest);
+    for (const LinkRequest& link : links) {
+        QFile file(link.destination);
+        QString linkPath;
+
+        linkPath = file.symLinkTarget();
+        if (linkPath == link.source) {
+            continue;
+        }
+
+        if (linkPath.isEmpty() || linkPath.isNull()) {
+            if (file.exists()) {
+                // dest path is not a link file
+                continue;
+            } else if (QFile::link(link.source, link.destination)) {
+                struct stat sb;
+                if (lstat(link.destination.toLocal8Bit().constData(), &sb) == 0) {
+                    mLinkRecord.add(link.destination, link.source, (quint64)sb.st_ino);
+                }
+                if (!link.iconPath.isEmpty()) {
+                    file_set_custom_icon(link.destination.toStdString().c_str(), link.iconPath.toStdString().c_str());
+                }
+            }
         }
     }
+
+    mLinkRecord.save();
 }
 
-void FileWatcher::deleteLink(const QString &dest)
+void FileWatcher::deleteLinks(const QStringList &dests)
 {
-    QFile file(dest);
-    QString linkPath;
+    if (dests.isEmpty()) {
+        return;
+    }
 
-    linkPath = file.symLinkTarget();
+    for (const QString& dest : dests) {
+        QFile file(dest);
+        QString linkPath;
 
-    if (linkPath.isEmpty() || linkPath.isNull()) {
-        if (file.exists()) {
-            // dest path is not a link file
-            return;
+        linkPath = file.symLinkTarget();
+
+        if (linkPath.isEmpty() || linkPath.isNull()) {
+            if (file.exists()) {
+                // dest path is not a link file
+                continue;
+            }
         }
+
+        QFile::remove(dest);
+        mLinkRecord.remove(dest);
     }
 
-    QFile::remove(dest);
+    mLinkRecord.save();
 }
 
 } // namespace kmre
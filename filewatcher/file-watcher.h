@@ -22,7 +22,6 @@
 
 #include <QObject>
 #include <QString>
-#include <QFileSystemWatcher>
 #include <QStorageInfo>
 #include <QHash>
 #include <QAtomicInt>
@@ -30,10 +29,14 @@
 #include <QList>
 #include <QThread>
 #include <QMap>
+#include <QVariantMap>
+#include <QSet>
+#include <QPair>
 #include <QMutex>
 
-#include "directory-check-worker.h"
-#include "storage-check-worker.h"
+#include "link-record.h"
+#include "path-check-scheduler.h"
+#include "file-inotify/watch-engine.h"
 
 
 namespace kmre {
@@ -56,6 +59,14 @@ struct LinkInfo
     QString linkName;
 };
 
+struct LinkRequest
+{
+    QString destination;
+    QString source;
+    // empty: no custom icon
+    QString iconPath;
+};
+
 struct PendingDirectory
 {
     QString dependPath;
@@ -72,15 +83,18 @@ struct DependDirectory
 };
 
 
-class FileWatcher : public QObject
+class FileWatcher : public QObject, public WatchHandler
 {
     Q_OBJECT
 
 public:
 
     static FileWatcher* GetInstance();
+    // whether installed.json lists any app
     bool shouldRun();
-    void run();
+    QString installedFilePath();
+    // queued from the startup thread once user-dirs.dirs is in place
+    Q_INVOKABLE void run();
 
 public slots:
     void addWatchPath(const QString& path);
@@ -95,11 +109,13 @@ public slots:
     void storageStatusChanged(const QString &path);
     void start();
     void stop();
+    // watched/polled directory counts of the media watcher
+    QVariantMap getWatchStats();
     void onContainerStopped(const QString &container);
 
-signals:
-    void check(const QString& path, int checkType);
-    void checkStorage(const QString& path, bool fuseMounted);
+private slots:
+    void watchedPathChanged(const QString &path, int role);
+    void rescanWatchedPaths();
 
 private:
     explicit FileWatcher(QObject *parent = 0);
@@ -113,13 +129,23 @@ private:
     void makeLink(const QString& dest, const QString& source);
     void dependMakeLink(const QString& path);
     void deleteLink(const QString& dest);
+    // one record update for the whole batch
+    void makeLinks(const QList<LinkRequest>& links);
+    void deleteLinks(const QStringList& dests);
     void dependDeleteLink(const QString& path);
+    void watchPath(const QString& path, int role);
+    void unwatchPath(const QString& path, int role);
+
+    // called on the WatchEngine thread, results are queued to this thread
+    void onWatchEvent(int role, const std::string& path, const struct inotify_event* event) override;
+    void onWatchOverflow(int role) override;
+    void onWatchBatchEnd(int role) override;
 
     static FileWatcher * m_pInstance;
-    QFileSystemWatcher *m_pSystemWatcher;
-    QFileSystemWatcher *m_pPendingWatcher;
-    QFileSystemWatcher *m_pDependWatcher;
-    QFileSystemWatcher *m_pLinkWatcher;
+    /* 四类目录共用一个inotify实例，按角色区分 */
+    WatchEngine *m_pEngine;
+    // paths changed in the current engine batch, only touched by its thread
+    QSet<QPair<int, QString>> mChangedPaths;
     QHash<QString, LinkDestination> mHashDirectory;
     QHash<QString, LinkDestination> mHashStorage;
     QHash<QString, PendingDirectory> mHashPending;
@@ -130,10 +156,11 @@ private:
     QString mContainerName;
     QString mLegacyContainerName;
     QAtomicInteger<int> mRunning;
-    QMap<QString, QThread*> mThreads;
-    QMap<QString, DirectoryCheckWorker*> mDirectoryWorkers;
-    QMap<QString, StorageCheckWorker*> mStorageWorkers;
+    PathCheckScheduler *m_pScheduler;
+    QSet<QString> mCheckPaths;
     QMutex mMutex;
+    /* 已创建的桌面链接，启动时只校验这些 */
+    LinkRecord mLinkRecord;
 };
 
 } // namespace kmre
@@ -33,6 +33,14 @@ FileWatcherAdaptor::~FileWatcherAdaptor()
     // destructor
 }
 
+QVariantMap FileWatcherAdaptor::getWatchStats()
+{
+    // handle method call cn.kylinos.Kmre.FileWatcher.getWatchStats
+    QVariantMap stats;
+    QMetaObject::invokeMethod(parent(), "getWatchStats", Q_RETURN_ARG(QVariantMap, stats));
+    return stats;
+}
+
 void FileWatcherAdaptor::start()
 {
     // handle method call cn.kylinos.Kmre.FileWatcher.start
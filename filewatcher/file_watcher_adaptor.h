@@ -34,6 +34,9 @@ class FileWatcherAdaptor: public QDBusAbstractAdaptor
 "  <interface name=\"cn.kylinos.Kmre.FileWatcher\">\n"
 "    <method name=\"start\"/>\n"
 "    <method name=\"stop\"/>\n"
+"    <method name=\"getWatchStats\">\n"
+"      <arg direction=\"out\" type=\"a{sv}\" name=\"stats\"/>\n"
+"    </method>\n"
 "  </interface>\n"
         "")
 public:
@@ -42,6 +45,7 @@ public:
 
 public: // PROPERTIES
 public Q_SLOTS: // METHODS
+    QVariantMap getWatchStats();
     void start();
     void stop();
 Q_SIGNALS: // SIGNALS
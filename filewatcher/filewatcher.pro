@@ -53,27 +53,49 @@ DEFINES += QT_DEPRECATED_WARNINGS
 
 SOURCES += main.cpp \
     file-inotify/dbus-client.cpp \
+    file-inotify/directory-scanner.cpp \
+    file-inotify/file-fanotify-watcher.cpp \
     file-inotify/file-inotify-service.cpp \
     file-inotify/file-inotify-watcher.cpp \
+    file-inotify/media-index.cpp \
+    file-inotify/media-sniffer.cpp \
+    file-inotify/path-filter.cpp \
     file-inotify/utils.cpp \
+    file-inotify/watch-budget.cpp \
+    file-inotify/watch-engine.cpp \
+    file-inotify/watch-index.cpp \
     file-watcher.cpp \
     file_watcher_adaptor.cpp \
-    directory-check-worker.cpp \
-    storage-check-worker.cpp \
-    custom.cpp \
-    lock-file.cpp
+    link-record.cpp \
+    mount-monitor.cpp \
+    path-check-scheduler.cpp \
+    watch-config.cpp \
+    custom.cpp
 
 HEADERS += \
     file-inotify/dbus-client.h \
+    file-inotify/directory-scanner.h \
+    file-inotify/file-fanotify-watcher.h \
     file-inotify/file-inotify-service.h \
     file-inotify/file-inotify-watcher.h \
+    file-inotify/media-index.h \
+    file-inotify/media-sniffer.h \
+    file-inotify/mpsc-queue.h \
+    file-inotify/path-filter.h \
+    file-inotify/timer-wheel.h \
     file-inotify/utils.h \
+    file-inotify/watch-budget.h \
+    file-inotify/watch-engine.h \
+    file-inotify/watch-index.h \
     file-watcher.h \
     file_watcher_adaptor.h \
-    directory-check-worker.h \
-    storage-check-worker.h \
-    custom.h \
-    lock-file.h
+    link-record.h \
+    mount-monitor.h \
+    path-check-scheduler.h \
+    watch-config.h \
+    custom.h
+
+include(../common/common.pri)
 
 TRANSLATIONS += resources/translations/kylin-kmre-filewatcher_zh_CN.ts
 !system($$PWD/resources/translations/generate_translations_pm.sh): error("Failed to generate pm")
@@ -0,0 +1,127 @@
+/*
+ * Copyright (c) KylinSoft Co., Ltd. 2016-2024.All rights reserved.
+ *
+ * Authors:
+ *  Ma Chao    machao@kylinos.cn
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QJsonParseError>
+#include <QSaveFile>
+
+#include <sys/syslog.h>
+
+#include "link-record.h"
+
+#define LINK_RECORD_VERSION 1
+
+namespace kmre {
+
+LinkRecord::LinkRecord(const QString& filePath)
+    : mFilePath(filePath),
+      mDirty(false)
+{
+}
+
+bool LinkRecord::load()
+{
+    QFile file(mFilePath);
+
+    mLinks.clear();
+    // until a record was read, the next save() writes one
+    mDirty = true;
+
+    if (!file.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+
+    QJsonParseError error;
+    QJsonDocument doc = QJsonDocument::fromJson(file.readAll(), &error);
+    if (error.error != QJsonParseError::NoError || !doc.isObject() ||
+        doc.object().value("version").toInt() != LINK_RECORD_VERSION) {
+        syslog(LOG_WARNING, "LinkRecord: Ignoring unreadable record %s.", mFilePath.toStdString().c_str());
+        return false;
+    }
+
+    for (const QJsonValue& value : doc.object().value("links").toArray()) {
+        QJsonObject object = value.toObject();
+        Link link;
+        link.path = object.value("path").toString();
+        link.target = object.value("target").toString();
+        link.ino = object.value("inode").toString().toULongLong();
+        if (!link.path.isEmpty()) {
+            mLinks.insert(link.path, link);
+        }
+    }
+
+    mDirty = false;
+    return true;
+}
+
+bool LinkRecord::save()
+{
+    if (!mDirty) {
+        return true;
+    }
+
+    QJsonArray array;
+    for (const Link& link : mLinks) {
+        QJsonObject object;
+        object.insert("path", link.path);
+        object.insert("target", link.target);
+        // inodes may not fit into a double
+        object.insert("inode", QString::number(link.ino));
+        array.append(object);
+    }
+
+    QJsonObject root;
+    root.insert("version", LINK_RECORD_VERSION);
+    root.insert("links", array);
+
+    QDir().mkpath(QFileInfo(mFilePath).absolutePath());
+
+    QSaveFile file(mFilePath);
+    if (!file.open(QIODevice::WriteOnly) ||
+        file.write(QJsonDocument(root).toJson(QJsonDocument::Compact)) < 0 || !file.commit()) {
+        syslog(LOG_WARNING, "LinkRecord: Failed to write %s.", mFilePath.toStdString().c_str());
+        return false;
+    }
+
+    mDirty = false;
+    return true;
+}
+
+void LinkRecord::add(const QString& path, const QString& target, quint64 ino)
+{
+    mLinks.insert(path, { path, target, ino });
+    mDirty = true;
+}
+
+bool LinkRecord::remove(const QString& path)
+{
+    if (mLinks.remove(path) == 0) {
+        return false;
+    }
+
+    mDirty = true;
+    return true;
+}
+
+} // namespace kmre
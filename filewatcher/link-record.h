@@ -0,0 +1,68 @@
+/*
+ * Copyright (c) KylinSoft Co., Ltd. 2016-2024.All rights reserved.
+ *
+ * Authors:
+ *  Ma Chao    machao@kylinos.cn
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef LINKRECORD_H
+#define LINKRECORD_H
+
+#include <QHash>
+#include <QList>
+#include <QString>
+
+#include "file-inotify/utils.h"
+
+namespace kmre {
+
+/*
+ * 记录FileWatcher自己创建的符号链接（路径、目标、inode），保存在 ~/.kmre 下。
+ * 启动时只需检查这些链接，不必遍历整个桌面。
+ * 只在主线程使用，不加锁。
+ */
+class LinkRecord
+{
+public:
+    struct Link
+    {
+        QString path;
+        QString target;
+        quint64 ino;
+    };
+
+    explicit LinkRecord(const QString& filePath);
+
+    // false if there is no record yet, or it can not be read
+    bool load();
+    // writes only if something changed since the last load()/save(), or
+    // if load() found no record
+    bool save();
+
+    void add(const QString& path, const QString& target, quint64 ino);
+    bool remove(const QString& path);
+    QList<Link> links() const { return mLinks.values(); }
+
+private:
+    QString mFilePath;
+    QHash<QString, Link> mLinks;
+    bool mDirty;
+
+    DISALLOW_COPY_AND_ASSIGN(LinkRecord);
+};
+
+} // namespace kmre
+
+#endif // LINKRECORD_H
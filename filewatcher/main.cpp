@@ -26,18 +26,31 @@
 #include <QDir>
 #include <QFile>
 
+#include "custom.h"
 #include "file-watcher.h"
 #include "file_watcher_adaptor.h"
 #include "file-inotify/file-inotify-service.h"
-#include "lock-file.h"
+#include "watch-config.h"
+#include "utils/lockfile.h"
 
+#include <QElapsedTimer>
+#include <QFileInfo>
+
+#include <atomic>
+#include <thread>
+
+#include <poll.h>
 #include <unistd.h>
+#include <sys/inotify.h>
 #include <sys/utsname.h>
 #include <sys/syslog.h>
 
 #define SERVICE_INTERFACE "cn.kylinos.Kmre.FileWatcher"
 #define SERVICE_PATH "/cn/kylinos/Kmre/FileWatcher"
 #define LOG_IDENT "KMRE_kylin-kmre-filewatcher"
+// how long to wait for installed.json before quitting, and for user-dirs.dirs
+#define INSTALLED_WAIT_MS 5000
+#define USER_DIRS_WAIT_MS 3000
 
 static const char *unsupported_kernel[] = {
     "4.4.58",
@@ -83,10 +96,126 @@ static bool prepareLockFile(QString& lockFilePath)
     return true;
 }
 
-int main(int argc, char *argv[])
+// Startup steps with their time since main(), logged once the last root
+// has been scanned.
+class StartupTrace
 {
-    int count = 0;
+public:
+    StartupTrace()
+    {
+        mTimer.start();
+    }
+
+    void mark(const QString& step)
+    {
+        mSteps.append(QString("%1 %2ms").arg(step).arg(mTimer.elapsed()));
+    }
+
+    void log()
+    {
+        syslog(LOG_INFO, "Startup trace: %s.", mSteps.join(", ").toStdString().c_str());
+    }
+
+private:
+    QElapsedTimer mTimer;
+    QStringList mSteps;
+};
+
+// Wait up to timeoutMs until ready() holds, woken by inotify on the parent
+// directory of path instead of polling.
+template <typename Ready>
+static bool waitForFile(const QString& path, int timeoutMs, Ready ready, const std::atomic<bool>& stop)
+{
+    QElapsedTimer timer;
+    timer.start();
+
+    if (ready()) {
+        return true;
+    }
+
+    int fd = inotify_init1(IN_CLOEXEC | IN_NONBLOCK);
+    if (fd >= 0 && inotify_add_watch(fd, QFileInfo(path).absolutePath().toStdString().c_str(),
+                                     IN_CREATE | IN_MOVED_TO | IN_CLOSE_WRITE) < 0) {
+        close(fd);
+        fd = -1;
+    }
+
+    bool result = false;
+    while (!stop) {
+        int remaining = timeoutMs - (int)timer.elapsed();
+        if (remaining <= 0) {
+            result = ready();
+            break;
+        }
+
+        // without a watch (no parent directory yet) just check once a while
+        struct pollfd pfd = { fd, POLLIN, 0 };
+        if (poll(&pfd, fd >= 0 ? 1 : 0, fd >= 0 ? remaining : qMin(remaining, 500)) > 0) {
+            char buf[4096];
+            while (read(fd, buf, sizeof(buf)) > 0) {
+            }
+        }
+        if (ready()) {
+            result = true;
+            break;
+        }
+    }
+
+    if (fd >= 0) {
+        close(fd);
+    }
+
+    return result;
+}
+
+/* 后台启动流程：先确认有已安装的应用，再按优先级依次扫描各个目录 */
+static void startInBackground(kmre::FileWatcher* fw, StartupTrace* trace, const std::atomic<bool>& stop)
+{
+    if (!waitForFile(fw->installedFilePath(), INSTALLED_WAIT_MS, [fw]() { return fw->shouldRun(); }, stop)) {
+        syslog(LOG_INFO, "No app installed, exit now.");
+        QMetaObject::invokeMethod(qApp, "quit", Qt::QueuedConnection);
+        return;
+    }
+    trace->mark("installed.json");
+
+    QString homeDirPath = QStandardPaths::writableLocation(QStandardPaths::HomeLocation);
+    QString userDirsFilePath = homeDirPath + "/.config/user-dirs.dirs";
+    waitForFile(userDirsFilePath, USER_DIRS_WAIT_MS, [&userDirsFilePath]() { return QFile::exists(userDirsFilePath); }, stop);
+    trace->mark("user-dirs.dirs");
+
+    QMetaObject::invokeMethod(fw, "run", Qt::QueuedConnection);
+
+    kmre::FileInotifyService* s = nullptr;
+    s = kmre::FileInotifyService::getInstance();
 
+    if (s) {
+        const kmre::WatchConfig config = kmre::WatchConfig::load();
+        s->initialize();
+        s->setFilter(config.excludes, config.mimeTypes);
+        // with inotify the service runs as soon as the first root is watched,
+        // fanotify only marks the roots and is started once they all are
+        for (const QString& root : config.roots) {
+            // the walks add watches while the started service handles
+            // events, addWatchRecursively() serializes the two
+            s->addWatchRecursively(root, false, &stop);
+            if (stop) {
+                return;
+            }
+            trace->mark(QFileInfo(root).fileName());
+            if (!s->usesFanotify()) {
+                s->start();
+            }
+        }
+        s->start();
+    }
+
+    trace->mark("started");
+    trace->log();
+}
+
+int main(int argc, char *argv[])
+{
+    StartupTrace trace;
     QCoreApplication a(argc, argv);
 
     openlog(LOG_IDENT, LOG_NDELAY | LOG_NOWAIT | LOG_PID, LOG_USER);
@@ -101,16 +230,6 @@ int main(int argc, char *argv[])
     }
 */
 
-    QString homeDirPath = QStandardPaths::writableLocation(QStandardPaths::HomeLocation);
-    QString userDirsFilePath = homeDirPath + "/.config/user-dirs.dirs";
-    while (!QFile::exists(userDirsFilePath)) {
-        usleep(100 * 1000);
-
-        if (++count > 30) {
-            break;
-        }
-    }
-
     QString lockFilePath;
     syslog(LOG_DEBUG, "Prepare lock file directory.");
     if (!prepareLockFile(lockFilePath)) {
@@ -124,20 +243,6 @@ int main(int argc, char *argv[])
         return 0;
     }
 
-    kmre::FileInotifyService* s = nullptr;
-    s = kmre::FileInotifyService::getInstance();
-
-    if (s) {
-        s->initialize();
-        s->addWatchRecursively(QStandardPaths::writableLocation(QStandardPaths::DocumentsLocation));
-        s->addWatchRecursively(QStandardPaths::writableLocation(QStandardPaths::DownloadLocation));
-        s->addWatchRecursively(QStandardPaths::writableLocation(QStandardPaths::PicturesLocation));
-        s->addWatchRecursively(QStandardPaths::writableLocation(QStandardPaths::MoviesLocation));
-        s->addWatchRecursively(QStandardPaths::writableLocation(QStandardPaths::MusicLocation));
-        s->addWatchRecursively(QStandardPaths::writableLocation(QStandardPaths::DesktopLocation));
-        s->start();
-    }
-
     QString locale = QLocale::system().name();
     QTranslator translator;
     if (locale == "zh_CN") {
@@ -167,8 +272,19 @@ int main(int argc, char *argv[])
         return 1;
     }
 
+    trace.mark("dbus");
+
+    // the service answers on D-Bus at once, the rest follows in the background
+    std::atomic<bool> stopStartup(false);
+    std::thread startupThread(startInBackground, fw, &trace, std::cref(stopStartup));
+
     syslog(LOG_DEBUG, "kylin-kmre-filewatcher is running.");
-    fw->run();
+    int ret = a.exec();
+
+    stopStartup = true;
+    startupThread.join();
+    // icons of links made just before quitting still get written
+    file_attributes_flush();
 
-    return a.exec();
+    return ret;
 }
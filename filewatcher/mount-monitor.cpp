@@ -0,0 +1,284 @@
+/*
+ * Copyright (c) KylinSoft Co., Ltd. 2016-2024.All rights reserved.
+ *
+ * Authors:
+ *  Ma Chao    machao@kylinos.cn
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <QFileInfo>
+#include <QMutexLocker>
+#include <QSet>
+#include <QSocketNotifier>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/syslog.h>
+
+#include "mount-monitor.h"
+
+#define MOUNTINFO_PATH "/proc/self/mountinfo"
+#define MOUNTINFO_READ_SIZE 16384
+
+namespace kmre {
+
+MountMonitor* MountMonitor::m_pInstance = nullptr;
+
+MountMonitor* MountMonitor::GetInstance()
+{
+    if (m_pInstance == nullptr) {
+        m_pInstance = new MountMonitor();
+    }
+
+    return m_pInstance;
+}
+
+MountMonitor::MountMonitor(QObject *parent)
+    : QObject(parent),
+      mMountsFd(-1),
+      m_pNotifier(nullptr)
+{
+    mMountsFd = open(MOUNTINFO_PATH, O_RDONLY | O_CLOEXEC);
+    if (mMountsFd < 0) {
+        syslog(LOG_ERR, "MountMonitor: open %s failed: %s", MOUNTINFO_PATH, strerror(errno));
+        return;
+    }
+
+    QList<int> changedIds;
+    reload(changedIds);
+
+    // mountinfo 在挂载表变化时以 POLLPRI 通知，对应 QSocketNotifier::Exception
+    m_pNotifier = new QSocketNotifier(mMountsFd, QSocketNotifier::Exception, this);
+    connect(m_pNotifier, SIGNAL(activated(int)), this, SLOT(onMountsActivated()));
+}
+
+MountMonitor::~MountMonitor()
+{
+    if (m_pNotifier) {
+        m_pNotifier->setEnabled(false);
+    }
+    if (mMountsFd >= 0) {
+        close(mMountsFd);
+        mMountsFd = -1;
+    }
+}
+
+QString MountMonitor::unescape(const QByteArray& field)
+{
+    // mountinfo 中空格、制表符、换行和反斜杠以 \ooo 八进制转义
+    if (field.indexOf('\\') < 0) {
+        return QString::fromLocal8Bit(field);
+    }
+
+    QByteArray out;
+    out.reserve(field.size());
+    for (int i = 0; i < field.size(); ++i) {
+        if (field[i] == '\\' && i + 3 < field.size() &&
+                field[i + 1] >= '0' && field[i + 1] <= '3' &&
+                field[i + 2] >= '0' && field[i + 2] <= '7' &&
+                field[i + 3] >= '0' && field[i + 3] <= '7') {
+            out.append(char(((field[i + 1] - '0') << 6) | ((field[i + 2] - '0') << 3) | (field[i + 3] - '0')));
+            i += 3;
+        } else {
+            out.append(field[i]);
+        }
+    }
+
+    return QString::fromLocal8Bit(out);
+}
+
+bool MountMonitor::parseLine(const QByteArray& line, MountEntry& entry)
+{
+    // 格式：id parent major:minor root mountpoint options [optional...] - fstype source superoptions
+    QList<QByteArray> fields = line.split(' ');
+    int separator = fields.indexOf("-");
+
+    if (fields.size() < 10 || separator < 6 || separator + 2 >= fields.size()) {
+        return false;
+    }
+
+    bool ok = false;
+    entry.id = fields[0].toInt(&ok);
+    if (!ok) {
+        return false;
+    }
+    entry.mountPoint = unescape(fields[4]);
+    entry.fsType = unescape(fields[separator + 1]);
+    entry.source = unescape(fields[separator + 2]);
+
+    return true;
+}
+
+bool MountMonitor::reload(QList<int>& changedIds)
+{
+    // 必须从头读完 mountinfo 才会清除 POLLPRI
+    mBuffer.resize(0);
+    if (lseek(mMountsFd, 0, SEEK_SET) < 0) {
+        return false;
+    }
+    while (true) {
+        int offset = mBuffer.size();
+        mBuffer.resize(offset + MOUNTINFO_READ_SIZE);
+        ssize_t len = read(mMountsFd, mBuffer.data() + offset, MOUNTINFO_READ_SIZE);
+        if (len < 0 && errno == EINTR) {
+            mBuffer.resize(offset);
+            continue;
+        }
+        mBuffer.resize(offset + (len > 0 ? len : 0));
+        if (len <= 0) {
+            break;
+        }
+    }
+
+    QMutexLocker lock(&mLock);
+    QList<int> order;
+    QSet<int> seen;
+    const char *data = mBuffer.constData();
+    int size = mBuffer.size();
+
+    order.reserve(mOrder.size());
+    for (int start = 0; start < size;) {
+        const char *newline = static_cast<const char*>(memchr(data + start, '\n', size - start));
+        int end = newline ? int(newline - data) : size;
+        int id = atoi(data + start);
+
+        if (end > start && id > 0) {
+            // 行内容未变的挂载无需重新解析
+            QHash<int, QByteArray>::const_iterator iter = mLines.constFind(id);
+            if (iter == mLines.constEnd() || iter.value().size() != end - start ||
+                    memcmp(iter.value().constData(), data + start, end - start) != 0) {
+                QByteArray line(data + start, end - start);
+                MountEntry entry;
+                if (parseLine(line, entry)) {
+                    mLines.insert(id, line);
+                    mEntries.insert(id, entry);
+                    changedIds.append(id);
+                }
+            }
+            if (mEntries.contains(id)) {
+                order.append(id);
+                seen.insert(id);
+            }
+        }
+
+        start = end + 1;
+    }
+
+    for (int id : mOrder) {
+        if (!seen.contains(id)) {
+            mLines.remove(id);
+            mEntries.remove(id);
+            changedIds.append(id);
+        }
+    }
+
+    bool changed = !changedIds.isEmpty() || order != mOrder;
+    mOrder.swap(order);
+
+    return changed;
+}
+
+bool MountMonitor::lookupLocked(const QString& canonicalPath, MountEntry& entry) const
+{
+    for (int i = mOrder.size() - 1; i >= 0; --i) {
+        const MountEntry& mount = mEntries[mOrder.at(i)];
+        if (canonicalPath.startsWith(mount.mountPoint) &&
+                (canonicalPath.size() == mount.mountPoint.size() ||
+                 mount.mountPoint == QLatin1String("/") ||
+                 canonicalPath.at(mount.mountPoint.size()) == QLatin1Char('/'))) {
+            entry = mount;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+int MountMonitor::resolveLocked(const QString& path) const
+{
+    QString canonicalPath = QFileInfo(path).canonicalFilePath();
+    MountEntry entry;
+
+    if (canonicalPath.isEmpty() || !lookupLocked(canonicalPath, entry)) {
+        return -1;
+    }
+
+    return entry.id;
+}
+
+bool MountMonitor::lookup(const QString& path, MountEntry& entry)
+{
+    QString canonicalPath = QFileInfo(path).canonicalFilePath();
+    if (canonicalPath.isEmpty()) {
+        return false;
+    }
+
+    QMutexLocker lock(&mLock);
+    return lookupLocked(canonicalPath, entry);
+}
+
+bool MountMonitor::isFuseMounted(const QString& path)
+{
+    MountEntry entry;
+
+    if (!lookup(path, entry)) {
+        return false;
+    }
+
+    return (entry.source == QString("/dev/fuse")) && (entry.fsType == QString("fuse"));
+}
+
+void MountMonitor::addPath(const QString& path)
+{
+    QMutexLocker lock(&mLock);
+    mPaths.insert(path, resolveLocked(path));
+}
+
+void MountMonitor::removePath(const QString& path)
+{
+    QMutexLocker lock(&mLock);
+    mPaths.remove(path);
+}
+
+void MountMonitor::onMountsActivated()
+{
+    QList<int> changedIds;
+    QList<QString> changedPaths;
+
+    if (!reload(changedIds)) {
+        return;
+    }
+
+    {
+        QMutexLocker lock(&mLock);
+        QHash<QString, int>::iterator iter;
+        for (iter = mPaths.begin(); iter != mPaths.end(); ++iter) {
+            int id = resolveLocked(iter.key());
+            if (id != iter.value() || changedIds.contains(id)) {
+                iter.value() = id;
+                changedPaths.append(iter.key());
+            }
+        }
+    }
+
+    for (const QString& path : changedPaths) {
+        emit pathChanged(path);
+    }
+    emit mountsChanged();
+}
+
+} // namespace kmre
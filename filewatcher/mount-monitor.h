@@ -0,0 +1,89 @@
+/*
+ * Copyright (c) KylinSoft Co., Ltd. 2016-2024.All rights reserved.
+ *
+ * Authors:
+ *  Ma Chao    machao@kylinos.cn
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef MOUNTMONITOR_H
+#define MOUNTMONITOR_H
+
+#include <QObject>
+#include <QString>
+#include <QByteArray>
+#include <QHash>
+#include <QList>
+#include <QMutex>
+
+class QSocketNotifier;
+
+namespace kmre {
+
+struct MountEntry
+{
+    int id;
+    QString mountPoint;
+    QString fsType;
+    QString source;
+};
+
+/*
+ * 进程内共享的挂载表监控：在 /proc/self/mountinfo 上等待 POLLPRI，
+ * 变化时只重新解析新增或改动的行，并对登记路径所在挂载的变化发出 pathChanged。
+ * lookup() 可在任意线程调用，通知在创建实例的线程（主线程）发出。
+ */
+class MountMonitor : public QObject
+{
+    Q_OBJECT
+
+public:
+    static MountMonitor* GetInstance();
+
+    void addPath(const QString& path);
+    void removePath(const QString& path);
+    bool lookup(const QString& path, MountEntry& entry);
+    bool isFuseMounted(const QString& path);
+
+signals:
+    void pathChanged(const QString& path);
+    void mountsChanged();
+
+private slots:
+    void onMountsActivated();
+
+private:
+    explicit MountMonitor(QObject *parent = nullptr);
+    ~MountMonitor();
+
+    bool reload(QList<int>& changedIds);
+    bool lookupLocked(const QString& canonicalPath, MountEntry& entry) const;
+    int resolveLocked(const QString& path) const;
+    static bool parseLine(const QByteArray& line, MountEntry& entry);
+    static QString unescape(const QByteArray& field);
+
+    static MountMonitor *m_pInstance;
+    int mMountsFd;
+    QSocketNotifier *m_pNotifier;
+    QMutex mLock;
+    QByteArray mBuffer;
+    QList<int> mOrder;                  // 按 mountinfo 顺序排列的挂载 id，后挂载的覆盖先挂载的
+    QHash<int, QByteArray> mLines;      // 挂载 id -> 原始行，用于增量比较
+    QHash<int, MountEntry> mEntries;
+    QHash<QString, int> mPaths;         // 登记路径 -> 当前所在挂载 id，-1 表示不可用
+};
+
+} // namespace kmre
+
+#endif // MOUNTMONITOR_H
@@ -0,0 +1,282 @@
+/*
+ * Copyright (c) KylinSoft Co., Ltd. 2016-2024.All rights reserved.
+ *
+ * Authors:
+ *  Ma Chao    machao@kylinos.cn
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <QFileInfo>
+#include <QFile>
+
+#include <errno.h>
+#include <string.h>
+#include <sys/inotify.h>
+#include <sys/stat.h>
+#include <sys/syslog.h>
+
+#include "path-check-scheduler.h"
+#include "mount-monitor.h"
+#include "file-inotify/watch-engine.h"
+
+#define ANCESTOR_WATCH_MASK (IN_CREATE | IN_MOVED_TO | IN_DELETE_SELF | IN_MOVE_SELF | IN_ONLYDIR)
+// 路径经由符号链接指向别处时，祖先目录收不到事件，用低频兜底重查
+#define CHECK_RESCAN_INTERVAL_MS 30000
+
+namespace kmre {
+
+PathCheckScheduler::PathCheckScheduler(QObject *parent)
+    : QObject(parent),
+      m_pEngine(WatchEngine::getInstance())
+{
+    // 祖先目录的监控与其他监控共用 WatchEngine 的 inotify 实例
+    if (m_pEngine->initialize() < 0) {
+        syslog(LOG_ERR, "PathCheckScheduler: Failed to initialize watch engine.");
+    }
+    m_pEngine->setHandler(WATCH_ROLE_CHECK, this);
+    m_pEngine->start();
+
+    MountMonitor *monitor = MountMonitor::GetInstance();
+    connect(monitor, SIGNAL(pathChanged(QString)), this, SLOT(onStoragePathChanged(QString)));
+    // 新的挂载点也可能让等待中的目录出现
+    connect(monitor, SIGNAL(mountsChanged()), this, SLOT(onRescanTimeout()));
+
+    mRescanTimer.setInterval(CHECK_RESCAN_INTERVAL_MS);
+    connect(&mRescanTimer, SIGNAL(timeout()), this, SLOT(onRescanTimeout()));
+}
+
+PathCheckScheduler::~PathCheckScheduler()
+{
+    mRescanTimer.stop();
+
+    m_pEngine->setHandler(WATCH_ROLE_CHECK, nullptr);
+    for (const QString& ancestor : mWatchAncestors) {
+        m_pEngine->removeWatch(ancestor, WATCH_ROLE_CHECK);
+    }
+}
+
+int PathCheckScheduler::storageState(const QString& path)
+{
+    MountEntry entry;
+
+    if (!MountMonitor::GetInstance()->lookup(path, entry)) {
+        return STORAGE_INVALID;
+    }
+
+    if ((entry.source == QString("/dev/fuse")) && (entry.fsType == QString("fuse"))) {
+        return STORAGE_FUSE;
+    }
+
+    return STORAGE_NORMAL;
+}
+
+void PathCheckScheduler::doCheck(const QString& path, int checkType)
+{
+    if (QFileInfo::exists(path)) {
+        dispatch(path, checkType);
+        return;
+    }
+
+    mCheckTypes.insert(path, checkType);
+    armCheck(path);
+
+    if (!mRescanTimer.isActive()) {
+        mRescanTimer.start();
+    }
+}
+
+void PathCheckScheduler::doCheckStorage(const QString& path, bool fuseMounted)
+{
+    int state = storageState(path);
+    int previous = mStorages.value(path, -1);
+
+    mStorages.insert(path, state);
+    if (previous < 0) {
+        MountMonitor::GetInstance()->addPath(path);
+    }
+
+    // 不可用状态只通知一次，之后等挂载表变化再通知，避免反复触发
+    if (state == STORAGE_INVALID) {
+        if (previous != STORAGE_INVALID) {
+            emit statusChanged(path);
+        }
+    } else if ((state == STORAGE_FUSE) != fuseMounted) {
+        emit statusChanged(path);
+    }
+}
+
+void PathCheckScheduler::armCheck(const QString& path)
+{
+    int oldWd = mCheckWatches.value(path, -1);
+    QByteArray ancestor = QFile::encodeName(path);
+    struct stat st;
+    int wd = -1;
+
+    // 向上查找最近的已存在目录
+    do {
+        int slash = ancestor.lastIndexOf('/');
+        if (slash <= 0) {
+            ancestor = "/";
+        } else {
+            ancestor.truncate(slash);
+        }
+    } while (ancestor != "/" && (stat(ancestor.constData(), &st) != 0 || !S_ISDIR(st.st_mode)));
+
+    const QString ancestorPath = QFile::decodeName(ancestor);
+    wd = m_pEngine->addWatch(ancestorPath, WATCH_ROLE_CHECK, ANCESTOR_WATCH_MASK);
+    if (wd < 0) {
+        syslog(LOG_WARNING, "PathCheckScheduler: watch %s failed: %s", ancestor.constData(), strerror(errno));
+    } else {
+        mWatchAncestors.insert(wd, ancestorPath);
+    }
+
+    if (oldWd == wd) {
+        return;
+    }
+
+    if (oldWd >= 0) {
+        QHash<int, QSet<QString>>::iterator iter = mWatchPaths.find(oldWd);
+        if (iter != mWatchPaths.end()) {
+            iter.value().remove(path);
+            if (iter.value().isEmpty()) {
+                mWatchPaths.erase(iter);
+                releaseWatch(oldWd);
+            }
+        }
+    }
+
+    if (wd >= 0) {
+        mCheckWatches.insert(path, wd);
+        mWatchPaths[wd].insert(path);
+    } else {
+        mCheckWatches.remove(path);
+    }
+}
+
+void PathCheckScheduler::releaseWatch(int wd)
+{
+    QHash<int, QString>::iterator iter = mWatchAncestors.find(wd);
+    if (iter != mWatchAncestors.end()) {
+        m_pEngine->removeWatch(iter.value(), WATCH_ROLE_CHECK);
+        mWatchAncestors.erase(iter);
+    }
+}
+
+void PathCheckScheduler::recheck(const QString& path)
+{
+    QHash<QString, int>::iterator iter = mCheckTypes.find(path);
+    if (iter == mCheckTypes.end()) {
+        return;
+    }
+
+    if (!QFileInfo::exists(path)) {
+        armCheck(path);
+        return;
+    }
+
+    int checkType = iter.value();
+    int wd = mCheckWatches.take(path);
+    mCheckTypes.erase(iter);
+
+    QHash<int, QSet<QString>>::iterator watchIter = mWatchPaths.find(wd);
+    if (watchIter != mWatchPaths.end()) {
+        watchIter.value().remove(path);
+        if (watchIter.value().isEmpty()) {
+            mWatchPaths.erase(watchIter);
+            releaseWatch(wd);
+        }
+    }
+
+    if (mCheckTypes.isEmpty()) {
+        mRescanTimer.stop();
+    }
+
+    dispatch(path, checkType);
+}
+
+void PathCheckScheduler::recheckAll()
+{
+    QList<QString> paths = mCheckTypes.keys();
+    for (const QString& path : paths) {
+        recheck(path);
+    }
+}
+
+void PathCheckScheduler::dispatch(const QString& path, int checkType)
+{
+    if (checkType == CHECK_TYPE_PENDING) {
+        emit pendingAddPath(path);
+    } else if (checkType == CHECK_TYPE_NORMAL) {
+        emit addPath(path);
+    } else if (checkType == CHECK_TYPE_DEPEND) {
+        emit dependAddPath(path);
+    } else if (checkType == CHECK_TYPE_LINK) {
+        emit linkAddPath(path);
+    }
+}
+
+void PathCheckScheduler::onWatchEvent(int role, const std::string& path, const struct inotify_event* event)
+{
+    (void)role;
+    (void)path;
+
+    mChangedWds.insert(event->wd);
+}
+
+void PathCheckScheduler::onWatchOverflow(int role)
+{
+    (void)role;
+
+    QMetaObject::invokeMethod(this, "onRescanTimeout", Qt::QueuedConnection);
+}
+
+void PathCheckScheduler::onWatchBatchEnd(int role)
+{
+    (void)role;
+
+    // 同一祖先目录的多个事件只重查一次
+    for (int wd : mChangedWds) {
+        QMetaObject::invokeMethod(this, "onAncestorChanged", Qt::QueuedConnection, Q_ARG(int, wd));
+    }
+    mChangedWds.clear();
+}
+
+void PathCheckScheduler::onAncestorChanged(int wd)
+{
+    QSet<QString> paths = mWatchPaths.value(wd);
+    for (const QString& path : paths) {
+        recheck(path);
+    }
+}
+
+void PathCheckScheduler::onStoragePathChanged(const QString& path)
+{
+    QHash<QString, int>::iterator iter = mStorages.find(path);
+    if (iter == mStorages.end()) {
+        return;
+    }
+
+    int state = storageState(path);
+    if (state != iter.value()) {
+        iter.value() = state;
+        emit statusChanged(path);
+    }
+}
+
+void PathCheckScheduler::onRescanTimeout()
+{
+    recheckAll();
+}
+
+} // namespace kmre
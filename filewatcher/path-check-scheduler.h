@@ -0,0 +1,103 @@
+/*
+ * Copyright (c) KylinSoft Co., Ltd. 2016-2024.All rights reserved.
+ *
+ * Authors:
+ *  Ma Chao    machao@kylinos.cn
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef PATHCHECKSCHEDULER_H
+#define PATHCHECKSCHEDULER_H
+
+#include <QObject>
+#include <QString>
+#include <QHash>
+#include <QSet>
+#include <QTimer>
+
+#include <string>
+
+#include "file-inotify/watch-engine.h"
+
+namespace kmre {
+
+enum
+{
+    CHECK_TYPE_NORMAL = 0,
+    CHECK_TYPE_PENDING,
+    CHECK_TYPE_DEPEND,
+    CHECK_TYPE_LINK,
+};
+
+/*
+ * 在主线程事件循环中统一等待目录出现和存储挂载状态变化：
+ * 目录通过 WatchEngine 监控其最近的已存在祖先目录，
+ * 存储在 MountMonitor 报告所在挂载变化时重新判断，不再为每个路径开线程轮询。
+ */
+class PathCheckScheduler : public QObject, public WatchHandler
+{
+    Q_OBJECT
+
+public:
+    explicit PathCheckScheduler(QObject *parent = nullptr);
+    ~PathCheckScheduler();
+
+    void doCheck(const QString& path, int checkType);
+    void doCheckStorage(const QString& path, bool fuseMounted);
+
+signals:
+    void addPath(const QString& path);
+    void pendingAddPath(const QString& path);
+    void dependAddPath(const QString& path);
+    void linkAddPath(const QString& path);
+    void statusChanged(const QString& path);
+
+private slots:
+    void onAncestorChanged(int wd);
+    void onStoragePathChanged(const QString& path);
+    void onRescanTimeout();
+
+private:
+    enum
+    {
+        STORAGE_INVALID = 0,
+        STORAGE_NORMAL,
+        STORAGE_FUSE,
+    };
+
+    static int storageState(const QString& path);
+    void armCheck(const QString& path);
+    void recheck(const QString& path);
+    void recheckAll();
+    void dispatch(const QString& path, int checkType);
+    void releaseWatch(int wd);
+
+    // called on the WatchEngine thread, results are queued to this thread
+    void onWatchEvent(int role, const std::string& path, const struct inotify_event* event) override;
+    void onWatchOverflow(int role) override;
+    void onWatchBatchEnd(int role) override;
+
+    WatchEngine *m_pEngine;
+    QTimer mRescanTimer;
+    QHash<QString, int> mCheckTypes;        // 等待出现的路径 -> 检查类型
+    QHash<QString, int> mCheckWatches;      // 等待出现的路径 -> 监控的祖先目录 wd
+    QHash<int, QSet<QString>> mWatchPaths;  // wd -> 等待中的路径
+    QHash<int, QString> mWatchAncestors;    // wd -> 被监控的祖先目录
+    QSet<int> mChangedWds;                  // 当前批次有事件的 wd，仅在 WatchEngine 线程访问
+    QHash<QString, int> mStorages;          // 存储路径 -> 最近一次的挂载状态
+};
+
+} // namespace kmre
+
+#endif // PATHCHECKSCHEDULER_H
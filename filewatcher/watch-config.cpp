@@ -0,0 +1,124 @@
+/*
+ * Copyright (c) KylinSoft Co., Ltd. 2016-2024.All rights reserved.
+ *
+ * Authors:
+ *  Ma Chao    machao@kylinos.cn
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <QFile>
+#include <QSettings>
+#include <QStandardPaths>
+
+#include <sys/syslog.h>
+
+#include "watch-config.h"
+
+namespace kmre {
+
+static const struct
+{
+    const char* name;
+    QStandardPaths::StandardLocation location;
+} standardRoots[] = {
+    { "Documents", QStandardPaths::DocumentsLocation },
+    { "Download", QStandardPaths::DownloadLocation },
+    { "Pictures", QStandardPaths::PicturesLocation },
+    { "Movies", QStandardPaths::MoviesLocation },
+    { "Music", QStandardPaths::MusicLocation },
+    { "Desktop", QStandardPaths::DesktopLocation },
+};
+
+static QString expandHome(const QString& path, const QString& homeDirPath)
+{
+    if (path == "~") {
+        return homeDirPath;
+    }
+    if (path.startsWith("~/")) {
+        return homeDirPath + path.mid(1);
+    }
+    return path;
+}
+
+static QString resolveRoot(const QString& root, const QString& homeDirPath)
+{
+    for (const auto& standard : standardRoots) {
+        if (root.compare(QLatin1String(standard.name), Qt::CaseInsensitive) == 0) {
+            return QStandardPaths::writableLocation(standard.location);
+        }
+    }
+
+    const QString path = expandHome(root, homeDirPath);
+    if (path.startsWith('/')) {
+        return path;
+    }
+
+    return homeDirPath + "/" + path;
+}
+
+WatchConfig WatchConfig::load()
+{
+    WatchConfig config;
+    const QString homeDirPath = QStandardPaths::writableLocation(QStandardPaths::HomeLocation);
+    const QString confPath = homeDirPath + "/.config/kmre/kmre.ini";
+    // scanned in this order at startup
+    QStringList roots = { "Pictures", "Movies", "Download", "Desktop", "Documents", "Music" };
+    QStringList excludes = { "node_modules", "__pycache__", "CMakeFiles" };
+    QStringList mimeTypes = { "image/*", "video/*" };
+
+    if (QFile::exists(confPath)) {
+        QSettings settings(confPath, QSettings::IniFormat);
+        settings.setIniCodec("UTF-8");
+        settings.beginGroup("filewatcher");
+        roots = settings.value("roots", roots).toStringList();
+        excludes = settings.value("excludes", excludes).toStringList();
+        mimeTypes = settings.value("mime_types", mimeTypes).toStringList();
+        settings.endGroup();
+    }
+
+    for (const QString& root : roots) {
+        if (root.trimmed().isEmpty()) {
+            continue;
+        }
+
+        const QString path = resolveRoot(root.trimmed(), homeDirPath);
+        // only files below the home directory are shared with Android
+        if (path != homeDirPath && !path.startsWith(homeDirPath + "/")) {
+            syslog(LOG_WARNING, "WatchConfig: Ignoring root %s outside the home directory.", path.toStdString().c_str());
+            continue;
+        }
+        if (!config.roots.contains(path)) {
+            config.roots.append(path);
+        }
+    }
+
+    for (const QString& exclude : excludes) {
+        if (!exclude.trimmed().isEmpty()) {
+            config.excludes.append(expandHome(exclude.trimmed(), homeDirPath));
+        }
+    }
+
+    for (const QString& mimeType : mimeTypes) {
+        if (!mimeType.trimmed().isEmpty()) {
+            config.mimeTypes.append(mimeType.trimmed());
+        }
+    }
+
+    syslog(LOG_DEBUG, "WatchConfig: %d roots, %d exclude rules, %d MIME types.",
+           config.roots.size(), config.excludes.size(), config.mimeTypes.size());
+
+    return config;
+}
+
+} // namespace kmre
@@ -0,0 +1,52 @@
+/*
+ * Copyright (c) KylinSoft Co., Ltd. 2016-2024.All rights reserved.
+ *
+ * Authors:
+ *  Ma Chao    machao@kylinos.cn
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef WATCHCONFIG_H
+#define WATCHCONFIG_H
+
+#include <QString>
+#include <QStringList>
+
+namespace kmre {
+
+/*
+ * 媒体文件监控配置，读取 ~/.config/kmre/kmre.ini 的 [filewatcher] 组，缺省的键使用内置值：
+ *
+ *   [filewatcher]
+ *   roots=Pictures,Movies,Download,Desktop,Documents,Music
+ *   excludes=node_modules,__pycache__,CMakeFiles
+ *   mime_types=image/*,video/*
+ *
+ * roots: 标准目录名（按 user-dirs.dirs 解析）、绝对路径或 ~/ 开头的路径，只接受家目录下的路径。
+ *        启动后按列出的顺序在后台依次扫描，最可能出现新媒体文件的目录排在前面。
+ * excludes: 不含 '/' 的规则匹配任意一级名称，以 '/' 或 ~/ 开头的规则匹配该路径及其下所有内容，均支持通配符。
+ * mime_types: 上报的 MIME 类型，支持 type/* 形式。
+ */
+struct WatchConfig
+{
+    QStringList roots;
+    QStringList excludes;
+    QStringList mimeTypes;
+
+    static WatchConfig load();
+};
+
+} // namespace kmre
+
+#endif // WATCHCONFIG_H
@@ -29,28 +29,18 @@ dbus_service.files += ../data/com.kylin.Kmre.gps.service
 dbus_service.path = /usr/share/dbus-1/services/
 
 SOURCES += main.cpp \
-    common/socket/SocketStream.cpp \
-    common/socket/UnixStream.cpp \
-    common/utils/sockets.cpp \
-    dbusadaptor.cpp \
+    gpsdbusadaptor.cpp \
     gpsdataget.cpp \
-    kmregps.cpp \
-    threadpool.cpp \
-    utils.cpp
-
-INCLUDEPATH += common/
+    kmregps.cpp
 
 HEADERS += \
-    common/socket/SocketStream.h \
-    common/socket/UnixStream.h \
-    common/utils/sockets.h \
-    dbusadaptor.h \
+    gpsdbusadaptor.h \
     gpsdataget.h \
     kmregps.h \
     myutils.h \
-    socketstream.h \
-    threadpool.h \
-    utils.h
+    socketstream.h
+
+include(../common/common.pri)
 
 INSTALLS += target \
     dbus_service
@@ -19,9 +19,15 @@
 
 #include "gpsdataget.h"
 #include "myutils.h"
+#include "utils.h"
 #include <sys/syslog.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
 #include <QDebug>
 
+#define SOCKET_WRITE_TIMEOUT_MS 1000
+
 
 GpsdataGet::GpsdataGet(QObject *parent) : QObject(parent) {}
 
@@ -33,57 +39,114 @@ GpsdataGet *GpsdataGet::getInstance(void)
 
 void GpsdataGet::initData()
 {
-    mListenSock = new UnixStream();
-    this->start();
+    {
+        QMutexLocker locker(&mListenLock);
+        /* 析构可能早于工作线程开始监听 */
+        if (mStopping) {
+            return;
+        }
+        mListenSock = new UnixStream();
+        if (!this->start()) {
+            return;
+        }
+    }
+    acceptLoop();
 }
 
 GpsdataGet::~GpsdataGet()
 {
-    if (mListenSock) {
-        delete mListenSock;
-        mListenSock = nullptr;
+    mPlayer.stop();
+    mRecorder.close();
+    mStopping = true;
+    {
+        QMutexLocker locker(&mWriteLock);
+        closeStream();
+    }
+    {
+        QMutexLocker locker(&mListenLock);
+        if (mListenSock) {
+            /* 唤醒阻塞在accept()中的线程 */
+            mListenSock->forceStop();
+        }
+    }
+    /* 工作线程退出accept循环后才能释放监听socket */
+    QThread *worker = thread();
+    if (worker && worker != QThread::currentThread()) {
+        worker->quit();
+        worker->wait();
     }
+    delete mListenSock;
+    mListenSock = nullptr;
 }
 
-void GpsdataGet::start()
+bool GpsdataGet::start()
 {
     if (mListenSock) {
-        QString socketPath = getUnixDomainSocketPath();
+        QString socketPath = getGpsSocketPath();
         if (socketPath.isEmpty()) {
             syslog(LOG_ERR, "GpsdataGet: Get socketPath is empty.");
-            return;
+            return false;
         }
         if (mListenSock->listen(socketPath.toStdString().c_str()) < 0) {
-            syslog(LOG_ERR, "GpsdataGet: listen %s failed.");
-            return;
+            syslog(LOG_ERR, "GpsdataGet: listen %s failed.", socketPath.toStdString().c_str());
+            return false;
         }
         chmod(socketPath.toStdString().c_str(), 0777);
+        return true;
+    }
+    return false;
+}
 
-        qDebug() << "GpsdataGet: Waiting for accept";
+/* 容器端的连接由本线程接受，D-Bus线程写失败时只关闭连接，不在写路径上等待重连 */
+void GpsdataGet::acceptLoop()
+{
+    while (!mStopping) {
         syslog(LOG_DEBUG, "GpsdataGet: Waiting for accept");
-        m_stream = mListenSock->accept();
-        if (!m_stream) {
-            qDebug() << "GpsdataGet: Fail to accept.";
-        } else {
-            qDebug() << "GpsdataGet: Socket connect successfully.";
-            sendData(gpsdata);
+        SocketStream *stream = mListenSock->accept();
+        if (!stream) {
+            if (!mStopping) {
+                syslog(LOG_ERR, "GpsdataGet: Fail to accept: %s", strerror(errno));
+                sleep(1);
+            }
+            continue;
         }
+
+        {
+            QMutexLocker locker(&mWriteLock);
+            /* 容器重启后会重新连接，旧连接不再有读端 */
+            closeStream();
+            m_stream = stream;
+            setStream(m_stream);
+        }
+        syslog(LOG_DEBUG, "GpsdataGet: Socket connect successfully.");
+        sendData(gpsdata);
     }
 }
 
 void GpsdataGet::sendData(QString data)
 {
     qDebug() << "sendData()"<<data;
-    int ret = writeData(data);
-    if (ret < 0) {
-        syslog(LOG_DEBUG, "GpsdataGet: Failed to write data to gps socket.");
-        if (updateSocket(m_stream)) {
-            writeData(data);
+    if (mRecorder.isOpen()) {
+        QByteArray ba = data.toLatin1();
+        mRecorder.append(ba.constData(), ba.size());
+    }
+    deliver(data);
+}
+
+void GpsdataGet::deliver(const QString &data, bool more)
+{
+    QMutexLocker locker(&mWriteLock);
+    if (m_stream) {
+        int ret = writeData(data, more);
+        if (ret < 0) {
+            /* 超时或部分写入后记录边界已错位，只能断开等待容器重连 */
+            syslog(LOG_WARNING, "GpsdataGet: Failed to write data to gps socket, dropping the connection.");
+            closeStream();
         }
     }
 }
 
-int GpsdataGet::writeData(QString data)
+int GpsdataGet::writeData(QString data, bool more)
 {
     int ret = 0;
     if (data == "")
@@ -97,18 +160,97 @@ int GpsdataGet::writeData(QString data)
     char senddata[65] = "";
     memcpy(senddata, ptr, 65);
     if (m_stream) {
-        ret = m_stream->writeFully(senddata, sizeof(senddata));
+        ret = mWriter.write(senddata, sizeof(senddata), more);
     }
     return ret;
 }
 
-bool GpsdataGet::updateSocket(SocketStream *)
+void GpsdataGet::closeStream()
 {
-    m_stream = mListenSock->accept();
-    if (!m_stream) {
-        syslog(LOG_ERR, "updateSocket: Fail to accept.");
+    if (m_stream) {
+        mWriter.setStream(nullptr);
+        delete m_stream;
+        m_stream = nullptr;
+    }
+}
+
+/* 录制经过本服务的定位数据，用于之后回放 */
+bool GpsdataGet::startRecord(const QString &path)
+{
+    int ret = mRecorder.open(path.toStdString().c_str(), kmre::TRACE_KIND_GPS);
+    if (ret < 0) {
+        syslog(LOG_ERR, "GpsdataGet: Failed to create trace file %s: %s", path.toStdString().c_str(), strerror(-ret));
         return false;
-    } else {
-        return true;
     }
+    return true;
+}
+
+void GpsdataGet::stopRecord()
+{
+    syslog(LOG_DEBUG, "GpsdataGet: Recorded %llu samples.", (unsigned long long)mRecorder.sampleCount());
+    mRecorder.close();
+}
+
+/* 按录制时的时间间隔(可加速)将轨迹回放给容器 */
+bool GpsdataGet::startReplay(const QString &path, double speed, bool loop)
+{
+    mPlayer.stop();
+
+    int ret = mPlayer.load(path.toStdString().c_str(), kmre::TRACE_KIND_GPS);
+    if (ret <= 0) {
+        syslog(LOG_ERR, "GpsdataGet: Failed to load trace file %s.", path.toStdString().c_str());
+        return false;
+    }
+
+    {
+        QMutexLocker locker(&mWriteLock);
+        mWriter.resetStats();
+    }
+
+    ret = mPlayer.start(speed, loop, [this](const char *data, size_t len, bool more) {
+        deliver(QString::fromLatin1(data, len), more);
+    });
+
+    return ret == 0;
+}
+
+void GpsdataGet::stopReplay()
+{
+    mPlayer.stop();
+
+    /* 发出回放停止时仍在合并窗口中的数据 */
+    QMutexLocker locker(&mWriteLock);
+    if (m_stream) {
+        mWriter.flush();
+    }
+    syslog(LOG_DEBUG, "GpsdataGet: Sent %llu messages in %llu socket writes since replay start.",
+           (unsigned long long)mWriter.messageCount(), (unsigned long long)mWriter.sendCount());
+}
+
+/* 回放时间隔小于windowUs的数据合并为一次写入，0表示不合并 */
+void GpsdataGet::setCoalesceWindow(uint windowUs)
+{
+    mPlayer.setCoalesceWindow(windowUs);
+}
+
+void GpsdataGet::setStream(SocketStream *stream)
+{
+    if (stream) {
+        stream->attachStats(&mStreamStats);
+    }
+    mWriter.setStream(stream);
+    /* 容器端不再读取时不能无限期阻塞D-Bus调用 */
+    mWriter.setTimeout(SOCKET_WRITE_TIMEOUT_MS);
+}
+
+QVariantMap GpsdataGet::getStreamStats()
+{
+    {
+        /* 两次写入之间容器端可能已退出 */
+        QMutexLocker locker(&mWriteLock);
+        if (m_stream) {
+            m_stream->peerAlive();
+        }
+    }
+    return Utils::streamStatsToMap(mStreamStats);
 }
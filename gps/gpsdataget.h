@@ -24,10 +24,15 @@
 #include <QList>
 #include <QMap>
 #include <pthread.h>
+#include <atomic>
 #include <QTime>
 #include <QDateTime>
+#include <QMutex>
+#include <QVariantMap>
 #include "socket/SocketStream.h"
+#include "socket/SocketWriter.h"
 #include "socket/UnixStream.h"
+#include "utils/trace_log.h"
 
 
 class GpsdataGet : public QObject
@@ -39,6 +44,13 @@ public:
     static GpsdataGet *getInstance(void);
     QString gpsdata = "";
 
+    bool startRecord(const QString &path);
+    void stopRecord();
+    bool startReplay(const QString &path, double speed, bool loop);
+    void stopReplay();
+    void setCoalesceWindow(uint windowUs);
+    QVariantMap getStreamStats();
+
 public slots:
     void initData();
     void sendData(QString data);
@@ -48,10 +60,22 @@ private:
     QByteArray mBuffer;
     SocketStream *m_stream = nullptr;
     bool flag = false;
-    void start();
+    std::atomic<bool> mStopping{false};
+    /* 保护mListenSock的创建与forceStop()，二者分属工作线程和析构线程 */
+    QMutex mListenLock;
+    bool start();
+    void acceptLoop();
+
+    void deliver(const QString &data, bool more = false);
+    int writeData(QString data, bool more = false);
+    void closeStream();
+    void setStream(SocketStream *stream);
 
-    int writeData(QString data);
-    bool updateSocket(SocketStream *);
+    QMutex mWriteLock;
+    SocketWriter mWriter;
+    SocketStreamStats mStreamStats;
+    kmre::TraceRecorder mRecorder;
+    kmre::TracePlayer mPlayer;
 };
 
 #endif // GPSDATAGET_H
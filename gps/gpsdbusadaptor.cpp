@@ -0,0 +1,94 @@
+/*
+ * Copyright (c) KylinSoft Co., Ltd. 2016-2024.All rights reserved.
+ *
+ * Authors:
+ *  Yuan ShanShan    yuanshanshan@kylinos.cn
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "gpsdbusadaptor.h"
+#include "myutils.h"
+#include "utils/servicehost.h"
+
+GpsDbusAdaptor::GpsDbusAdaptor(QObject *parent) : QDBusAbstractAdaptor(parent)
+{
+}
+
+GpsDbusAdaptor::~GpsDbusAdaptor() {}
+
+bool GpsDbusAdaptor::registerService(QDBusConnection connection)
+{
+    if (!connection.registerService(KYLIN_GPSSERVER_SERVICE)) {
+        return false;
+    }
+    /* gps与sensor的对象路径都是"/"，单进程模式下共用同一个导出对象 */
+    if (connection.objectRegisteredAt(KYLIN_GPSSERVER_PATH) == parent()) {
+        return true;
+    }
+    return connection.registerObject(KYLIN_GPSSERVER_PATH, parent(), QDBusConnection::ExportAdaptors);
+}
+
+/* 传递虚拟定位的数据 */
+void GpsDbusAdaptor::passGpsData(QString gpsdata)
+{
+    GpsdataGet::getInstance()->gpsdata = gpsdata;
+    sendData(gpsdata);
+}
+
+void GpsDbusAdaptor::sendData(QString data)
+{
+    GpsdataGet::getInstance()->sendData(data);
+}
+
+bool GpsDbusAdaptor::startRecord(QString path)
+{
+    return GpsdataGet::getInstance()->startRecord(path);
+}
+
+void GpsDbusAdaptor::stopRecord()
+{
+    GpsdataGet::getInstance()->stopRecord();
+}
+
+bool GpsDbusAdaptor::startReplay(QString path, double speed, bool loop)
+{
+    return GpsdataGet::getInstance()->startReplay(path, speed, loop);
+}
+
+void GpsDbusAdaptor::stopReplay()
+{
+    GpsdataGet::getInstance()->stopReplay();
+}
+
+void GpsDbusAdaptor::setCoalesceWindow(uint windowUs)
+{
+    GpsdataGet::getInstance()->setCoalesceWindow(windowUs);
+}
+
+QVariantMap GpsDbusAdaptor::getStreamStats()
+{
+    return GpsdataGet::getInstance()->getStreamStats();
+}
+
+void GpsDbusAdaptor::start()
+{
+}
+
+void GpsDbusAdaptor::stop()
+{
+    if (kmre::ServiceHost::handleStop(KYLIN_GPSSERVER_SERVICE)) {
+        return;
+    }
+    exit(0);
+}
@@ -17,8 +17,8 @@
  * limitations under the License.
  */
 
-#ifndef DBUSADAPTOR_H
-#define DBUSADAPTOR_H
+#ifndef GPS_DBUSADAPTOR_H
+#define GPS_DBUSADAPTOR_H
 
 #define KYLIN_GPSSERVER_PATH "/"
 #define KYLIN_GPSSERVER_SERVICE "com.kylin.Kmre.gpsserver"
@@ -26,6 +26,7 @@
 
 #include <QObject>
 #include <QCoreApplication>
+#include <QtDBus/QDBusAbstractAdaptor>
 #include <QtDBus/QDBusConnection>
 #include <QDBusInterface>
 #include <QtDBus/QDBusError>
@@ -34,20 +35,30 @@
 #include <QDateTime>
 #include <QDebug>
 #include "gpsdataget.h"
-#include "myutils.h"
 
-class DbusAdaptor : public QObject
+class GpsDbusAdaptor : public QDBusAbstractAdaptor
 {
     Q_OBJECT
     Q_CLASSINFO("D-Bus Interface", KYLIN_GPSSERVER_SERVICE)
 
 public:
-    DbusAdaptor(QObject *parent = 0);
-    virtual ~DbusAdaptor();
+    GpsDbusAdaptor(QObject *parent);
+    virtual ~GpsDbusAdaptor();
+
+    /* 申请服务名并导出parent，parent可由多个服务共用 */
+    bool registerService(QDBusConnection connection);
 
 public slots:
     /* 传递gps数据 */
     void passGpsData(QString gpsdata);
+    /* 录制/回放定位轨迹 */
+    bool startRecord(QString path);
+    void stopRecord();
+    bool startReplay(QString path, double speed, bool loop);
+    void stopReplay();
+    void setCoalesceWindow(uint windowUs);
+    /* 与容器间socket的读写统计 */
+    QVariantMap getStreamStats();
     void start();
     void stop();
 
@@ -22,6 +22,7 @@
 #include "kmregps.h"
 #include "threadpool.h"
 #include "utils.h"
+#include "utils/servicehost.h"
 
 KmreGps::KmreGps(QObject *parent) : QObject(parent) {}
 
@@ -41,6 +42,10 @@ void KmreGps::init()
     m_gpsdataget->moveToThread(thread);
     QObject::connect(thread, SIGNAL(started()), m_gpsdataget, SLOT(initData()));
     thread->start();
+    /* 合并进程模式下由宿主统一处理Stopped信号 */
+    if (kmre::ServiceHost::isHosted()) {
+        return;
+    }
     QDBusConnection::systemBus().connect(QString("cn.kylinos.Kmre"), QString("/cn/kylinos/Kmre"),
                                          QString("cn.kylinos.Kmre"), QString("Stopped"), this,
                                          SLOT(onStopApplication(QString)));
@@ -17,8 +17,8 @@
  * limitations under the License.
  */
 
-#ifndef MYUTILS_H
-#define MYUTILS_H
+#ifndef GPS_MYUTILS_H
+#define GPS_MYUTILS_H
 
 #include <QObject>
 #include <pwd.h>
@@ -47,7 +47,7 @@ inline QString GpsSocketPath(int32_t uid, const QString &userName)
 }
 
 
-inline QString getUnixDomainSocketPath()
+inline QString getGpsSocketPath()
 {
     QString socketPath;
 
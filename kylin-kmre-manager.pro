@@ -18,11 +18,36 @@
 TEMPLATE = subdirs
 #CONFIG = ordered
 SUBDIRS += \
+    common \
     manager \
-    audio \
-    filewatcher \
-    sensors \
-    gps
+    filewatcher
+
+# qmake CONFIG+=kmre_single_process: audio, sensors and gps are hosted by one
+# kylin-kmre-services process instead of three daemons
+kmre_single_process {
+    SUBDIRS += services
+    services.depends = common
+} else {
+    SUBDIRS += \
+        audio \
+        sensors \
+        gps
+    audio.depends = common
+    sensors.depends = common
+    gps.depends = common
+}
+
+# daemons link the static runtime in common/
+filewatcher.depends = common
+
+# qmake CONFIG+=kmre_bench: also build the filewatcher replay benchmark and
+# the socket write benchmark
+kmre_bench {
+    SUBDIRS += filewatcher_bench socket_bench
+    filewatcher_bench.subdir = filewatcher/bench
+    socket_bench.subdir = common/bench
+    socket_bench.depends = common
+}
 
 #ARCH=$$QMAKE_HOST.arch
 #isEqual(ARCH, aarch64) {
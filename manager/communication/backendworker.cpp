@@ -227,6 +227,39 @@ void BackendWorker::insertOneRecordToAndroidDB(const QString &path, const QStrin
     }
 }
 
+// libkmre只提供单条插入接口，批量插入时只加载一次insert_file
+void BackendWorker::insertRecordsToAndroidDB(const FileRecordList &records)
+{
+    if (records.isEmpty()) {
+        return;
+    }
+
+    GetFunction  getFunction("insert_file");
+    void* insert_file = getFunction();
+    if (!insert_file) {
+        syslog(LOG_ERR, "[%s] insert_file not found!", __func__);
+        return;
+    }
+
+    int failed = 0;
+    for (const FileRecord &record : records) {
+        if (record.path.isEmpty() || record.mimeType.isEmpty()) {
+            failed++;
+            continue;
+        }
+
+        const std::string path = record.path.toStdString();
+        const std::string mimeType = record.mimeType.toStdString();
+        if (!((bool(*)(char *, char *))insert_file)(const_cast<char *>(path.c_str()), const_cast<char *>(mimeType.c_str()))) {
+            failed++;
+        }
+    }
+
+    if (failed > 0) {
+        syslog(LOG_ERR, "[%s] insert_file failed for %d of %d records!", __func__, failed, records.size());
+    }
+}
+
 void BackendWorker::removeOneRecordFromAndroidDB(const QString &path, const QString &mime_type)
 {
     if (path.isEmpty() || mime_type.isEmpty()) {
@@ -247,6 +280,39 @@ void BackendWorker::removeOneRecordFromAndroidDB(const QString &path, const QStr
     }
 }
 
+// 与批量插入相同，批量删除时只加载一次remove_file
+void BackendWorker::removeRecordsFromAndroidDB(const FileRecordList &records)
+{
+    if (records.isEmpty()) {
+        return;
+    }
+
+    GetFunction  getFunction("remove_file");
+    void* remove_file = getFunction();
+    if (!remove_file) {
+        syslog(LOG_ERR, "[%s] remove_file not found!", __func__);
+        return;
+    }
+
+    int failed = 0;
+    for (const FileRecord &record : records) {
+        if (record.path.isEmpty() || record.mimeType.isEmpty()) {
+            failed++;
+            continue;
+        }
+
+        const std::string path = record.path.toStdString();
+        const std::string mimeType = record.mimeType.toStdString();
+        if (!((bool(*)(char *, char *))remove_file)(const_cast<char *>(path.c_str()), const_cast<char *>(mimeType.c_str()))) {
+            failed++;
+        }
+    }
+
+    if (failed > 0) {
+        syslog(LOG_ERR, "[%s] remove_file failed for %d of %d records!", __func__, failed, records.size());
+    }
+}
+
 void BackendWorker::requestAllFilesFromAndroidDB(int type)
 {
     bool ret = false;
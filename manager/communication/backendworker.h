@@ -22,6 +22,7 @@
 #define BACKENDWORKER_H
 
 #include <QObject>
+#include "metatypes.h"
 
 class QTimer;
 struct AppInfo;
@@ -40,7 +41,9 @@ public slots:
     void pasueAllApps();
     void controlApp(int id, const QString &pkgName, int event_type, int event_value = 0);
     void insertOneRecordToAndroidDB(const QString &path, const QString &mime_type);
+    void insertRecordsToAndroidDB(const FileRecordList &records);
     void removeOneRecordFromAndroidDB(const QString &path, const QString &mime_type);
+    void removeRecordsFromAndroidDB(const FileRecordList &records);
     void requestAllFilesFromAndroidDB(int type);
     bool updateDekstopAndIcon(const AppInfo &appInfo);
     void removeDekstopAndIcon(const QString &appName);
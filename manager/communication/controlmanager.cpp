@@ -107,8 +107,12 @@ void ControlManager::initConnections()
     connect(mSignalManager, &SignalManager::requestSetSystemProp, mBackendWorker, &BackendWorker::setSystemProp);
     //绑定向安卓数据库添加一条记录的请求
     connect(mSignalManager, &SignalManager::requestAddFileRecord, mBackendWorker, &BackendWorker::insertOneRecordToAndroidDB);
+    //绑定向安卓数据库批量添加记录的请求
+    connect(mSignalManager, &SignalManager::requestAddFileRecords, mBackendWorker, &BackendWorker::insertRecordsToAndroidDB);
     //绑定从安卓数据库删除一条记录的请求
     connect(mSignalManager, &SignalManager::requestRemoveFileRecord, mBackendWorker, &BackendWorker::removeOneRecordFromAndroidDB);
+    //绑定从安卓数据库批量删除记录的请求
+    connect(mSignalManager, &SignalManager::requestRemoveFileRecords, mBackendWorker, &BackendWorker::removeRecordsFromAndroidDB);
     //
     connect(mSignalManager, &SignalManager::requestAllFiles, mBackendWorker, &BackendWorker::requestAllFilesFromAndroidDB);
 
@@ -344,11 +348,23 @@ void ControlManager::addOneRecord(const QString &path, const QString &mime_type)
     emit mSignalManager->requestAddFileRecord(path, mime_type);
 }
 
+// 请求向android数据库批量增加记录
+void ControlManager::addRecords(const FileRecordList &records)
+{
+    emit mSignalManager->requestAddFileRecords(records);
+}
+
 // 请求从android数据库删除一条记录
 void ControlManager::removeOneRecord(const QString &path, const QString &mime_type)
 {
     emit mSignalManager->requestRemoveFileRecord(path, mime_type);
 }
+
+// 请求从android数据库批量删除记录
+void ControlManager::removeRecords(const FileRecordList &records)
+{
+    emit mSignalManager->requestRemoveFileRecords(records);
+}
 /*
 *   请求从android获取所有文件数据
     type 0: dump all mediafile info
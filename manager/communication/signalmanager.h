@@ -37,7 +37,9 @@ signals:
     void requestCloseAllApps();
     void requestControlApp(int id, const QString &pkgName, int event_type, int event_value);
     void requestAddFileRecord(const QString &path, const QString &mime_type);
+    void requestAddFileRecords(const FileRecordList &records);
     void requestRemoveFileRecord(const QString &path, const QString &mime_type);
+    void requestRemoveFileRecords(const FileRecordList &records);
     void requestAllFiles(int type);
     void requestSetSystemProp(int type, const QString &propName, const QString &propValue);
 
@@ -39,6 +39,12 @@ void ManagerAdaptor::addOneRecord(const QString &path, const QString &mime_type)
     QMetaObject::invokeMethod(parent(), "addOneRecord", Q_ARG(QString, path), Q_ARG(QString, mime_type));
 }
 
+void ManagerAdaptor::addRecords(FileRecordList records)
+{
+    // handle method call cn.kylinos.Kmre.Manager.addRecords
+    QMetaObject::invokeMethod(parent(), "addRecords", Q_ARG(FileRecordList, records));
+}
+
 void ManagerAdaptor::closeApp(const QString &appName, const QString &pkgName, bool forceKill)
 {
     // handle method call cn.kylinos.Kmre.Manager.closeApp
@@ -117,6 +123,12 @@ void ManagerAdaptor::removeOneRecord(const QString &path, const QString &mime_ty
     QMetaObject::invokeMethod(parent(), "removeOneRecord", Q_ARG(QString, path), Q_ARG(QString, mime_type));
 }
 
+void ManagerAdaptor::removeRecords(FileRecordList records)
+{
+    // handle method call cn.kylinos.Kmre.Manager.removeRecords
+    QMetaObject::invokeMethod(parent(), "removeRecords", Q_ARG(FileRecordList, records));
+}
+
 void ManagerAdaptor::setCameraDevice(const QString &device)
 {
     // handle method call cn.kylinos.Kmre.Manager.setCameraDevice
@@ -61,10 +61,18 @@ class ManagerAdaptor: public QDBusAbstractAdaptor
 "      <arg direction=\"in\" type=\"s\" name=\"path\"/>\n"
 "      <arg direction=\"in\" type=\"s\" name=\"mime_type\"/>\n"
 "    </method>\n"
+"    <method name=\"addRecords\">\n"
+"      <arg direction=\"in\" type=\"a(ss)\" name=\"records\"/>\n"
+"      <annotation value=\"FileRecordList\" name=\"org.qtproject.QtDBus.QtTypeName.In0\"/>\n"
+"    </method>\n"
 "    <method name=\"removeOneRecord\">\n"
 "      <arg direction=\"in\" type=\"s\" name=\"path\"/>\n"
 "      <arg direction=\"in\" type=\"s\" name=\"mime_type\"/>\n"
 "    </method>\n"
+"    <method name=\"removeRecords\">\n"
+"      <arg direction=\"in\" type=\"a(ss)\" name=\"records\"/>\n"
+"      <annotation value=\"FileRecordList\" name=\"org.qtproject.QtDBus.QtTypeName.In0\"/>\n"
+"    </method>\n"
 "    <method name=\"commandToGetAllFiles\">\n"
 "      <arg direction=\"in\" type=\"i\" name=\"type\"/>\n"
 "    </method>\n"
@@ -107,6 +115,7 @@ public:
 public: // PROPERTIES
 public Q_SLOTS: // METHODS
     void addOneRecord(const QString &path, const QString &mime_type);
+    void addRecords(FileRecordList records);
     void closeApp(const QString &appName, const QString &pkgName, bool forceKill);
     void commandToGetAllFiles(int type);
     void controlApp(int id, const QString &pkgName, int event_type);
@@ -118,6 +127,7 @@ public Q_SLOTS: // METHODS
     bool isHostSupportDDS();
     void quit();
     void removeOneRecord(const QString &path, const QString &mime_type);
+    void removeRecords(FileRecordList records);
     void setCameraDevice(const QString &device);
     void setSystemProp(int event_type, const QString &value_field, const QString &value);
 Q_SIGNALS: // SIGNALS
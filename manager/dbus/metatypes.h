@@ -70,6 +70,32 @@ public:
 typedef QList<AndroidMeta> AndroidMetaList;
 Q_DECLARE_METATYPE(AndroidMeta);
 Q_DECLARE_METATYPE(AndroidMetaList);
+
+// 批量添加/删除文件记录(addRecords/removeRecords)的单条记录，对应D-Bus类型(ss)
+class FileRecord
+{
+public:
+    QString path;
+    QString mimeType;
+
+    friend QDBusArgument& operator<<(QDBusArgument& arg, const FileRecord& record) {
+        arg.beginStructure();
+        arg << record.path << record.mimeType;
+        arg.endStructure();
+        return arg;
+    }
+
+    friend const QDBusArgument& operator>>(const QDBusArgument& arg, FileRecord& record) {
+        arg.beginStructure();
+        arg >> record.path >> record.mimeType;
+        arg.endStructure();
+        return arg;
+    }
+};
+
+typedef QList<FileRecord> FileRecordList;
+Q_DECLARE_METATYPE(FileRecord);
+Q_DECLARE_METATYPE(FileRecordList);
 Q_DECLARE_METATYPE(QList<QByteArray>)
 
 #endif // DBUS_METATYPES_H_
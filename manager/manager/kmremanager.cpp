@@ -51,6 +51,8 @@ KmreManager::KmreManager()
     qDBusRegisterMetaType<QList<QByteArray>>();
     qDBusRegisterMetaType<AndroidMeta>();
     qDBusRegisterMetaType<AndroidMetaList>();
+    qDBusRegisterMetaType<FileRecord>();
+    qDBusRegisterMetaType<FileRecordList>();
 
     kmre::DBusClient::getInstance()->Prepare(Utils::getUserName(), getuid());
     mSignalManager = SignalManager::getInstance();
@@ -270,12 +272,24 @@ void KmreManager::addOneRecord(const QString &path, const QString &mime_type)
     mControlManager->addOneRecord(path, mime_type);
 }
 
+// 请求向android数据库批量增加记录
+void KmreManager::addRecords(const FileRecordList &records)
+{
+    mControlManager->addRecords(records);
+}
+
 // 请求从android数据库删除一条记录
 void KmreManager::removeOneRecord(const QString &path, const QString &mime_type)
 {
     mControlManager->removeOneRecord(path, mime_type);
 }
 
+// 请求从android数据库批量删除记录
+void KmreManager::removeRecords(const FileRecordList &records)
+{
+    mControlManager->removeRecords(records);
+}
+
 void KmreManager::commandToGetAllFiles(int type)
 {
     mControlManager->commandToGetAllFiles(type);
@@ -45,7 +45,9 @@ public slots:
     void closeApp(const QString &appName, const QString& pkgName, bool forceKill);
     void controlApp(int id, const QString &pkgName, int event_type, int event_value = 0);
     void addOneRecord(const QString &path, const QString &mime_type);
+    void addRecords(const FileRecordList &records);
     void removeOneRecord(const QString &path, const QString &mime_type);
+    void removeRecords(const FileRecordList &records);
     void commandToGetAllFiles(int type);
     AndroidMetaList getAllFiles(const QString &uri, bool reverse_order);
     bool filesIsEmpty();
@@ -22,6 +22,7 @@
 #include "kmresensor.h"
 #include "threadpool.h"
 #include "utils.h"
+#include "utils/servicehost.h"
 
 KmreSensor::KmreSensor(QObject *parent) : QObject(parent) {}
 
@@ -41,6 +42,10 @@ void KmreSensor::init()
     m_sensordataget->moveToThread(thread);
     QObject::connect(thread, SIGNAL(started()), m_sensordataget, SLOT(initData()));
     thread->start();
+    /* 合并进程模式下由宿主统一处理Stopped信号 */
+    if (kmre::ServiceHost::isHosted()) {
+        return;
+    }
     QDBusConnection::systemBus().connect(QString("cn.kylinos.Kmre"), QString("/cn/kylinos/Kmre"),
                                          QString("cn.kylinos.Kmre"), QString("Stopped"), this,
                                          SLOT(onStopApplication(QString)));
@@ -29,76 +29,13 @@
 #include <pwd.h>
 #include <sys/syslog.h>
 #include "utils.h"
-#include "dbusadaptor.h"
+#include "utils/lockfile.h"
+#include "sensordbusadaptor.h"
 #include "threadpool.h"
 #include "kmresensor.h"
 
-#define BUF_SIZE 1024
 #define LOG_IDENT "KMRE_kylin-kmre-sensor"
 
-static int open_lock_file(const char *path)
-{
-    int fd;
-    fd = open(path, O_RDWR | O_CLOEXEC | O_CREAT, 0666);
-    if (fd < 0) {
-        return fd;
-    }
-
-    return fd;
-}
-
-static int try_lock_file(int fd)
-{
-    int ret = -1;
-    int count = 0;
-
-    for (count = 0; count < 5; count++) {
-        ret = flock(fd, LOCK_EX | LOCK_NB);
-        if (ret == 0) {
-            break;
-        }
-        if ((EBADF == errno) || (EINVAL == errno) || (EWOULDBLOCK == errno)) {
-            break;
-        }
-        sleep(1);
-    }
-
-    return ret;
-}
-
-static void unlock_fd(int fd)
-{
-    if (fd < 0) {
-        return;
-    }
-    flock(fd, LOCK_UN);
-    close(fd);
-}
-
-static int do_lock_file(const char *path, int *lockFd)
-{
-    int fd;
-    int ret;
-
-    fd = open_lock_file(path);
-    if (fd < 0) {
-        return -1;
-    }
-
-    ret = try_lock_file(fd);
-    if (ret < 0) {
-        close(fd);
-        return -1;
-    }
-
-    if (lockFd) {
-        *lockFd = fd;
-    }
-
-    return 0;
-}
-
-
 int main(int argc, char *argv[])
 {
     QCoreApplication a(argc, argv);
@@ -106,35 +43,16 @@ int main(int argc, char *argv[])
     // openlog(LOG_IDENT, LOG_NDELAY | LOG_NOWAIT | LOG_PID, LOG_USER);
 
     int nRet = 0;
-    char lockFilePath[BUF_SIZE] = {0};
-    char user[BUF_SIZE] = {0};
-    char *home_dir = NULL;
-    char home_path[BUF_SIZE] = {0};
-    char lock_file_dir[BUF_SIZE] = {0};
-
-    snprintf(user, sizeof(user), "%s", Utils::getUserName().toStdString().c_str());
-
-    home_dir = getenv("HOME");
-    if (!home_dir) {
-        snprintf(home_path, sizeof(home_path), "/home/%s", user);
-        home_dir = home_path;
-    }
-
-    snprintf(lock_file_dir, sizeof(lock_file_dir), "%s/.kmre", home_dir);
-    snprintf(lockFilePath, sizeof(lockFilePath), "%s/kylin-kmre-sensor.lock", lock_file_dir);
-
-    mkdir(lock_file_dir, 0777);
-    chmod(lock_file_dir, 0777);
-
     int lockfd;
-    int ret = do_lock_file(lockFilePath, &lockfd);
+    int ret = lock_daemon_file("kylin-kmre-sensor", &lockfd);
     if (ret < 0) {
         exit(-1);
     }
 
     /* 创建DBus服务 */
-    DbusAdaptor adaptor;
-    Q_UNUSED(adaptor);
+    QObject root;
+    SensorDbusAdaptor *adaptor = new SensorDbusAdaptor(&root);
+    adaptor->registerService(QDBusConnection::sessionBus());
 
     KmreSensor sensor;
     sensor.init();
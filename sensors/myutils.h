@@ -17,8 +17,8 @@
  * limitations under the License.
  */
 
-#ifndef MYUTILS_H
-#define MYUTILS_H
+#ifndef SENSOR_MYUTILS_H
+#define SENSOR_MYUTILS_H
 
 #include <QObject>
 #include <pwd.h>
@@ -46,7 +46,7 @@ inline QString SensorSocketPath(int32_t uid, const QString &userName)
     return containerPath(uid, userName) + "/sockets/kmre_sensors";
 }
 
-inline QString getUnixDomainSocketPath()
+inline QString getSensorSocketPath()
 {
     QString socketPath;
 
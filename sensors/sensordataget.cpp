@@ -19,9 +19,15 @@
 
 #include "sensordataget.h"
 #include "myutils.h"
+#include "utils.h"
 #include <sys/syslog.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
 #include <QDebug>
 
+#define SOCKET_WRITE_TIMEOUT_MS 1000
+
 
 SensordataGet::SensordataGet(QObject *parent) : QObject(parent) {}
 
@@ -33,58 +39,114 @@ SensordataGet *SensordataGet::getInstance(void)
 
 void SensordataGet::initData()
 {
-    mListenSock = new UnixStream();
-    this->start();
+    {
+        QMutexLocker locker(&mListenLock);
+        /* 析构可能早于工作线程开始监听 */
+        if (mStopping) {
+            return;
+        }
+        mListenSock = new UnixStream();
+        if (!this->start()) {
+            return;
+        }
+    }
+    acceptLoop();
 }
 
 SensordataGet::~SensordataGet()
 {
-    if (mListenSock) {
-        delete mListenSock;
-        mListenSock = nullptr;
+    mPlayer.stop();
+    mRecorder.close();
+    mStopping = true;
+    {
+        QMutexLocker locker(&mWriteLock);
+        closeStream();
     }
+    {
+        QMutexLocker locker(&mListenLock);
+        if (mListenSock) {
+            /* 唤醒阻塞在accept()中的线程 */
+            mListenSock->forceStop();
+        }
+    }
+    /* 工作线程退出accept循环后才能释放监听socket */
+    QThread *worker = thread();
+    if (worker && worker != QThread::currentThread()) {
+        worker->quit();
+        worker->wait();
+    }
+    delete mListenSock;
+    mListenSock = nullptr;
 }
 
-void SensordataGet::start()
+bool SensordataGet::start()
 {
     if (mListenSock) {
-        QString socketPath = getUnixDomainSocketPath();
+        QString socketPath = getSensorSocketPath();
         if (socketPath.isEmpty()) {
             syslog(LOG_ERR, "SensordataGet: Get socketPath is empty.");
-            return;
+            return false;
         }
         if (mListenSock->listen(socketPath.toStdString().c_str()) < 0) {
-            syslog(LOG_ERR, "SensordataGet: listen %s failed.");
+            syslog(LOG_ERR, "SensordataGet: listen %s failed.", socketPath.toStdString().c_str());
             qDebug()<<"连接失败";
-            return;
+            return false;
         }
         chmod(socketPath.toStdString().c_str(), 0777);
+        return true;
+    }
+    return false;
+}
 
+/* 容器端的连接由本线程接受，D-Bus线程写失败时只关闭连接，不在写路径上等待重连 */
+void SensordataGet::acceptLoop()
+{
+    while (!mStopping) {
         syslog(LOG_DEBUG, "SensordataGet: Waiting for accept");
-        m_stream = mListenSock->accept();
-        qDebug()<<"接收成功";
-        if (!m_stream) {
-            syslog(LOG_ERR, "SensordataGet: Fail to accept.");
-        } else {
-            syslog(LOG_DEBUG, "SensordataGet: Socket connect successfully.");
+        SocketStream *stream = mListenSock->accept();
+        if (!stream) {
+            if (!mStopping) {
+                syslog(LOG_ERR, "SensordataGet: Fail to accept: %s", strerror(errno));
+                sleep(1);
+            }
+            continue;
+        }
+
+        {
+            QMutexLocker locker(&mWriteLock);
+            /* 容器重启后会重新连接，旧连接不再有读端 */
+            closeStream();
+            m_stream = stream;
+            setStream(m_stream);
         }
+        syslog(LOG_DEBUG, "SensordataGet: Socket connect successfully.");
     }
 }
 
 void SensordataGet::sendData(QString data)
 {
     qDebug()<<"data:"<<data;
+    if (mRecorder.isOpen()) {
+        QByteArray ba = data.toLatin1();
+        mRecorder.append(ba.constData(), ba.size());
+    }
+    deliver(data);
+}
+
+void SensordataGet::deliver(const QString &data, bool more)
+{
+    QMutexLocker locker(&mWriteLock);
     if (m_stream) {
-        int ret = writeData(data);
+        int ret = writeData(data, more);
         if (ret < 0) {
-            syslog(LOG_DEBUG, "SensordataGet: Failed to write data to sensor socket.");
-            updateSocket(m_stream);
-            ret = writeData(data);
+            /* 超时或部分写入后记录边界已错位，只能断开等待容器重连 */
+            syslog(LOG_WARNING, "SensordataGet: Failed to write data to sensor socket, dropping the connection.");
+            closeStream();
         }
     }
 }
 
-int SensordataGet::writeData(QString data)
+int SensordataGet::writeData(QString data, bool more)
 {
     qDebug()<<"data:"<<data;
     QString temp ="acceleration:";
@@ -98,16 +160,96 @@ int SensordataGet::writeData(QString data)
     memcpy(senddata, ptr, 24);
     char sensordata[128] = {0};
     sprintf(sensordata, "%ssync:%ld", senddata, timeT);
-    int ret = m_stream->writeFully(sensordata, sizeof(sensordata));
+    int ret = mWriter.write(sensordata, sizeof(sensordata), more);
     return ret;
 }
 
-void SensordataGet::updateSocket(SocketStream *)
+void SensordataGet::closeStream()
+{
+    if (m_stream) {
+        mWriter.setStream(nullptr);
+        delete m_stream;
+        m_stream = nullptr;
+    }
+}
+
+/* 录制经过本服务的传感器数据，用于之后回放 */
+bool SensordataGet::startRecord(const QString &path)
+{
+    int ret = mRecorder.open(path.toStdString().c_str(), kmre::TRACE_KIND_SENSOR);
+    if (ret < 0) {
+        syslog(LOG_ERR, "SensordataGet: Failed to create trace file %s: %s", path.toStdString().c_str(), strerror(-ret));
+        return false;
+    }
+    return true;
+}
+
+void SensordataGet::stopRecord()
+{
+    syslog(LOG_DEBUG, "SensordataGet: Recorded %llu samples.", (unsigned long long)mRecorder.sampleCount());
+    mRecorder.close();
+}
+
+/* 按录制时的时间间隔(可加速)将传感器数据回放给容器 */
+bool SensordataGet::startReplay(const QString &path, double speed, bool loop)
+{
+    mPlayer.stop();
+
+    int ret = mPlayer.load(path.toStdString().c_str(), kmre::TRACE_KIND_SENSOR);
+    if (ret <= 0) {
+        syslog(LOG_ERR, "SensordataGet: Failed to load trace file %s.", path.toStdString().c_str());
+        return false;
+    }
+
+    {
+        QMutexLocker locker(&mWriteLock);
+        mWriter.resetStats();
+    }
+
+    ret = mPlayer.start(speed, loop, [this](const char *data, size_t len, bool more) {
+        deliver(QString::fromLatin1(data, len), more);
+    });
+
+    return ret == 0;
+}
+
+void SensordataGet::stopReplay()
 {
-    m_stream = mListenSock->accept();
-    if (!m_stream) {
-        syslog(LOG_ERR, "updateSocket: Fail to accept.");
-    } else {
-        syslog(LOG_DEBUG, "updateSocket: Socket connect successfully.");
+    mPlayer.stop();
+
+    /* 发出回放停止时仍在合并窗口中的数据 */
+    QMutexLocker locker(&mWriteLock);
+    if (m_stream) {
+        mWriter.flush();
+    }
+    syslog(LOG_DEBUG, "SensordataGet: Sent %llu messages in %llu socket writes since replay start.",
+           (unsigned long long)mWriter.messageCount(), (unsigned long long)mWriter.sendCount());
+}
+
+/* 回放时间隔小于windowUs的数据合并为一次写入，0表示不合并 */
+void SensordataGet::setCoalesceWindow(uint windowUs)
+{
+    mPlayer.setCoalesceWindow(windowUs);
+}
+
+void SensordataGet::setStream(SocketStream *stream)
+{
+    if (stream) {
+        stream->attachStats(&mStreamStats);
+    }
+    mWriter.setStream(stream);
+    /* 容器端不再读取时不能无限期阻塞D-Bus调用 */
+    mWriter.setTimeout(SOCKET_WRITE_TIMEOUT_MS);
+}
+
+QVariantMap SensordataGet::getStreamStats()
+{
+    {
+        /* 两次写入之间容器端可能已退出 */
+        QMutexLocker locker(&mWriteLock);
+        if (m_stream) {
+            m_stream->peerAlive();
+        }
     }
+    return Utils::streamStatsToMap(mStreamStats);
 }
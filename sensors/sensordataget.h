@@ -24,9 +24,14 @@
 #include <QList>
 #include <QMap>
 #include <pthread.h>
+#include <atomic>
 #include <QDateTime>
+#include <QMutex>
+#include <QVariantMap>
 #include "socket/SocketStream.h"
+#include "socket/SocketWriter.h"
 #include "socket/UnixStream.h"
+#include "utils/trace_log.h"
 
 
 class SensordataGet : public QObject
@@ -37,6 +42,12 @@ public:
     ~SensordataGet();
     static SensordataGet *getInstance(void);
 
+    bool startRecord(const QString &path);
+    void stopRecord();
+    bool startReplay(const QString &path, double speed, bool loop);
+    void stopReplay();
+    void setCoalesceWindow(uint windowUs);
+    QVariantMap getStreamStats();
 
 public slots:
     void initData();
@@ -47,10 +58,22 @@ private:
     QByteArray mBuffer;
     SocketStream *m_stream = nullptr;
     bool flag = false;
-    void start();
+    std::atomic<bool> mStopping{false};
+    /* 保护mListenSock的创建与forceStop()，二者分属工作线程和析构线程 */
+    QMutex mListenLock;
+    bool start();
+    void acceptLoop();
 
-    int writeData(QString data);
-    void updateSocket(SocketStream *);
+    void deliver(const QString &data, bool more = false);
+    int writeData(QString data, bool more = false);
+    void closeStream();
+    void setStream(SocketStream *stream);
+
+    QMutex mWriteLock;
+    SocketWriter mWriter;
+    SocketStreamStats mStreamStats;
+    kmre::TraceRecorder mRecorder;
+    kmre::TracePlayer mPlayer;
 };
 
 #endif // SENSORDATAGET_H
@@ -17,22 +17,31 @@
  * limitations under the License.
  */
 
-#include "dbusadaptor.h"
+#include "sensordbusadaptor.h"
+#include "myutils.h"
+#include "utils/servicehost.h"
 
-DbusAdaptor::DbusAdaptor(QObject *parent) : QObject(parent)
+SensorDbusAdaptor::SensorDbusAdaptor(QObject *parent) : QDBusAbstractAdaptor(parent)
 {
     clock_gettime(CLOCK_MONOTONIC, &stamp);
-    QDBusConnection connection = QDBusConnection::sessionBus();
+}
+
+SensorDbusAdaptor::~SensorDbusAdaptor() {}
+
+bool SensorDbusAdaptor::registerService(QDBusConnection connection)
+{
     if (!connection.registerService(KYLIN_SENSOR_SERVICE)) {
-        return;
+        return false;
+    }
+    /* gps与sensor的对象路径都是"/"，单进程模式下共用同一个导出对象 */
+    if (connection.objectRegisteredAt(KYLIN_SENSOR_PATH) == parent()) {
+        return true;
     }
-    connection.registerObject(KYLIN_SENSOR_PATH, this, QDBusConnection::ExportAllSlots);
+    return connection.registerObject(KYLIN_SENSOR_PATH, parent(), QDBusConnection::ExportAdaptors);
 }
 
-DbusAdaptor::~DbusAdaptor() {}
-
 /* 传递加速度传感器数据 */
-void DbusAdaptor::passAcceKey(QString sensorData)
+void SensorDbusAdaptor::passAcceKey(QString sensorData)
 {
     if (sensorData == ""){
         if (flag){
@@ -56,7 +65,7 @@ void DbusAdaptor::passAcceKey(QString sensorData)
 }
 
 /* 传递加速度传感器数据 */
-//void DbusAdaptor::passAcceKey()
+//void SensorDbusAdaptor::passAcceKey()
 //{
 //    clock_gettime(CLOCK_MONOTONIC, &now);
 //    int64_t duration = time_diff_us(now, stamp);
@@ -66,11 +75,44 @@ void DbusAdaptor::passAcceKey(QString sensorData)
 //    stamp = now;
 //}
 
-void DbusAdaptor::start()
+bool SensorDbusAdaptor::startRecord(QString path)
 {
+    return SensordataGet::getInstance()->startRecord(path);
 }
 
-void DbusAdaptor::stop()
+void SensorDbusAdaptor::stopRecord()
 {
+    SensordataGet::getInstance()->stopRecord();
+}
+
+bool SensorDbusAdaptor::startReplay(QString path, double speed, bool loop)
+{
+    return SensordataGet::getInstance()->startReplay(path, speed, loop);
+}
+
+void SensorDbusAdaptor::stopReplay()
+{
+    SensordataGet::getInstance()->stopReplay();
+}
+
+void SensorDbusAdaptor::setCoalesceWindow(uint windowUs)
+{
+    SensordataGet::getInstance()->setCoalesceWindow(windowUs);
+}
+
+QVariantMap SensorDbusAdaptor::getStreamStats()
+{
+    return SensordataGet::getInstance()->getStreamStats();
+}
+
+void SensorDbusAdaptor::start()
+{
+}
+
+void SensorDbusAdaptor::stop()
+{
+    if (kmre::ServiceHost::handleStop(KYLIN_SENSOR_SERVICE)) {
+        return;
+    }
     exit(0);
 }
\ No newline at end of file
@@ -17,8 +17,8 @@
  * limitations under the License.
  */
 
-#ifndef DBUSADAPTOR_H
-#define DBUSADAPTOR_H
+#ifndef SENSOR_DBUSADAPTOR_H
+#define SENSOR_DBUSADAPTOR_H
 
 #define KYLIN_SENSOR_PATH "/"
 #define KYLIN_SENSOR_SERVICE "com.kylin.Kmre.sensor"
@@ -26,6 +26,7 @@
 
 #include <QObject>
 #include <QCoreApplication>
+#include <QtDBus/QDBusAbstractAdaptor>
 #include <QtDBus/QDBusConnection>
 #include <QDBusInterface>
 #include <QtDBus/QDBusError>
@@ -34,20 +35,30 @@
 #include <QDateTime>
 #include <QDebug>
 #include "sensordataget.h"
-#include "myutils.h"
 
-class DbusAdaptor : public QObject
+class SensorDbusAdaptor : public QDBusAbstractAdaptor
 {
     Q_OBJECT
     Q_CLASSINFO("D-Bus Interface", KYLIN_SENSOR_SERVICE)
 
 public:
-    DbusAdaptor(QObject *parent = 0);
-    virtual ~DbusAdaptor();
+    SensorDbusAdaptor(QObject *parent);
+    virtual ~SensorDbusAdaptor();
+
+    /* 申请服务名并导出parent，parent可由多个服务共用 */
+    bool registerService(QDBusConnection connection);
 
 public slots:
     /* 传递加速度传感器数据 */
     void passAcceKey(QString sensorData);
+    /* 录制/回放传感器数据 */
+    bool startRecord(QString path);
+    void stopRecord();
+    bool startReplay(QString path, double speed, bool loop);
+    void stopReplay();
+    void setCoalesceWindow(uint windowUs);
+    /* 与容器间socket的读写统计 */
+    QVariantMap getStreamStats();
     void start();
     void stop();
 
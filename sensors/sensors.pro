@@ -34,30 +34,19 @@ INSTALLS += target \
     dbus_service
 
 SOURCES += \
-        common/socket/SocketStream.cpp \
-        common/socket/UnixStream.cpp \
-        common/utils/sockets.cpp \
-        dbusadaptor.cpp \
+        sensordbusadaptor.cpp \
         kmresensor.cpp \
-        threadpool.cpp \
-        utils.cpp \
         main.cpp \
         sensordataget.cpp
 
 
 HEADERS += \
-    common/socket/SocketStream.h \
-    common/socket/UnixStream.h \
-    common/utils/sockets.h \
-    dbusadaptor.h \
+    sensordbusadaptor.h \
     kmresensor.h \
     myutils.h \
-    sensordataget.h \
-    threadpool.h \
-    utils.h
+    sensordataget.h
 
-INCLUDEPATH += common
-INCLUDEPATH += common/include
+include(../common/common.pri)
 
 unix {
     MOC_DIR = .moc
@@ -1,85 +0,0 @@
-/*
- * Copyright (c) KylinSoft Co., Ltd. 2016-2024.All rights reserved.
- *
- * Authors:
- *  Kobe Lee    lixiang@kylinos.cn
- *
- * Licensed under the Apache License, Version 2.0 (the "License");
- * you may not use this file except in compliance with the License.
- * You may obtain a copy of the License at
- *
- * http://www.apache.org/licenses/LICENSE-2.0
- *
- * Unless required by applicable law or agreed to in writing, software
- * distributed under the License is distributed on an "AS IS" BASIS,
- * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
- * See the License for the specific language governing permissions and
- * limitations under the License.
- */
-
-#include "utils.h"
-
-#include <sys/types.h>
-#include <pwd.h>
-#include <unistd.h>
-#include <sys/syslog.h>
-
-const QString& Utils::getUserName()
-{
-    static QString userName = "";
-
-    if (!userName.isEmpty()) {
-        return userName;
-    }
-
-    struct passwd  pwd;
-    struct passwd* result = 0;
-    char buf[1024];
-
-    memset(&buf, 0, sizeof(buf));
-    uint32_t uid = getuid();
-    (void)getpwuid_r(uid, &pwd, buf, 1024, &result);
-
-    if (result && pwd.pw_name) {
-        userName = pwd.pw_name;
-    }
-    else {
-        try {
-            userName = std::getenv("USER");
-        } 
-        catch (...) {
-            try {
-                userName = std::getenv("USERNAME");
-            }
-            catch (...) {
-                syslog(LOG_ERR, "[%s] Get user name failed!", __func__);
-                char name[16] = {0};
-                snprintf(name, sizeof(name), "%u", getuid());
-                userName = name;
-            }
-        }
-    }
-
-    userName.replace('\\', "_");// 在某些云环境，用户名中会有'\'字符，需将该字符转换为'_'字符
-    return userName;
-}
-
-const QString& Utils::getUid()
-{
-    int uid = -1;
-    static QString userId = "";
-
-    if (!userId.isEmpty()) {
-        return userId;
-    }
-
-    try {
-        uid = getuid();
-    }
-    catch (...) {
-        syslog(LOG_ERR, "[%s] Get user id failed!", __func__);
-    }
-    
-    userId = QString::number(uid);
-    return userId;
-}
\ No newline at end of file
@@ -0,0 +1,264 @@
+/*
+ * Copyright (c) KylinSoft Co., Ltd. 2016-2024.All rights reserved.
+ *
+ * Authors:
+ *  Kobe Lee    lixiang@kylinos.cn
+ * 
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "kmreservices.h"
+
+#include <QCoreApplication>
+#include <QDebug>
+#include <QtDBus/QDBusConnection>
+#include <QtDBus/QDBusConnectionInterface>
+#include <QtDBus/QDBusError>
+#include <QtDBus/QDBusInterface>
+#include <QtDBus/QDBusReply>
+#include <sys/syslog.h>
+
+#include "audio_adaptor.h"
+#include "kmreaudio.h"
+#include "kmregps.h"
+#include "kmresensor.h"
+#include "gpsdbusadaptor.h"
+#include "sensordbusadaptor.h"
+#include "threadpool.h"
+#include "utils.h"
+#include "utils/lockfile.h"
+#include "utils/servicehost.h"
+
+#define AUDIO_SERVICE "cn.kylinos.Kmre.Audio"
+#define AUDIO_PATH "/cn/kylinos/Kmre/Audio"
+#define SERVICES_SERVICE "cn.kylinos.Kmre.Services"
+#define SERVICES_PATH "/cn/kylinos/Kmre/Services"
+#define SERVICES_INTERFACE "cn.kylinos.Kmre.Services"
+
+KmreServices::KmreServices(QObject *parent)
+    : QObject(parent)
+{
+
+}
+
+KmreServices::~KmreServices()
+{
+    kmre::ServiceHost::setStopHandler(nullptr);
+
+    for (int fd : m_locks) {
+        unlock_fd(fd);
+    }
+    m_locks.clear();
+}
+
+bool KmreServices::lockModule(const QString &module, const char *lockName)
+{
+    int lockfd;
+    /* 与独立进程使用同一把锁，二者不会同时提供同一服务 */
+    if (lock_daemon_file(lockName, &lockfd) < 0) {
+        syslog(LOG_WARNING, "[%s] %s is already running, skip it", __func__, module.toStdString().c_str());
+        return false;
+    }
+    m_locks.insert(module, lockfd);
+    return true;
+}
+
+int KmreServices::init(const QStringList &modules)
+{
+    QStringList locked;
+
+    kmre::ServiceHost::setStopHandler([this](const std::string &service) {
+        QString name = QString::fromStdString(service);
+        QMetaObject::invokeMethod(this, [this, name]() { stopService(name); }, Qt::QueuedConnection);
+    });
+
+    QDBusConnection connection = QDBusConnection::sessionBus();
+    /* gps和sensor原本都导出在"/"，共用同一个对象 */
+    m_root = new QObject(this);
+
+    if (modules.contains("audio")) {
+        if (lockModule("audio", "kylin-kmre-audio")) {
+            m_audio = new KmreAudio(this);
+            m_audio->init();
+            new AudioAdaptor(m_audio);
+            registerModule("audio");
+        }
+        else {
+            locked << "audio";
+        }
+    }
+
+    if (modules.contains("sensor")) {
+        if (lockModule("sensor", "kylin-kmre-sensor")) {
+            registerModule("sensor");
+            m_sensor = new KmreSensor(this);
+            m_sensor->init();
+        }
+        else {
+            locked << "sensor";
+        }
+    }
+
+    if (modules.contains("gps")) {
+        if (lockModule("gps", "kylin-kmre-gps-server")) {
+            registerModule("gps");
+            m_gps = new KmreGps(this);
+            m_gps->init();
+        }
+        else {
+            locked << "gps";
+        }
+    }
+
+    /* 锁被另一个宿主持有时，本进程可能正是因其已停止的服务被D-Bus激活的 */
+    if (!locked.isEmpty()) {
+        resumeInHost(locked);
+    }
+
+    /* 各模块不再单独监听，由宿主统一订阅一次Stopped信号 */
+    if (!m_services.isEmpty()) {
+        QDBusConnection::systemBus().connect(QString("cn.kylinos.Kmre"), QString("/cn/kylinos/Kmre"),
+                                             QString("cn.kylinos.Kmre"), QString("Stopped"), this,
+                                             SLOT(onStopApplication(QString)));
+        if (!connection.registerService(SERVICES_SERVICE) ||
+            !connection.registerObject(SERVICES_PATH, this, QDBusConnection::ExportScriptableSlots)) {
+            syslog(LOG_WARNING, "[%s] Failed to register %s: %s", __func__, SERVICES_SERVICE,
+                   connection.lastError().message().toStdString().c_str());
+        }
+    }
+
+    return m_services.size();
+}
+
+bool KmreServices::registerModule(const QString &module)
+{
+    QDBusConnection connection = QDBusConnection::sessionBus();
+
+    if (module == "audio") {
+        if (connection.registerService(AUDIO_SERVICE) && connection.registerObject(AUDIO_PATH, m_audio)) {
+            m_services.insert(AUDIO_SERVICE, "audio");
+            return true;
+        }
+        syslog(LOG_ERR, "[%s] Failed to register %s: %s", __func__, AUDIO_SERVICE,
+               connection.lastError().message().toStdString().c_str());
+        return false;
+    }
+
+    QObject *adaptor = nullptr;
+    QString service;
+    bool registered = false;
+    if (module == "sensor") {
+        SensorDbusAdaptor *sensorAdaptor = new SensorDbusAdaptor(m_root);
+        registered = sensorAdaptor->registerService(connection);
+        adaptor = sensorAdaptor;
+        service = KYLIN_SENSOR_SERVICE;
+    }
+    else if (module == "gps") {
+        GpsDbusAdaptor *gpsAdaptor = new GpsDbusAdaptor(m_root);
+        registered = gpsAdaptor->registerService(connection);
+        adaptor = gpsAdaptor;
+        service = KYLIN_GPSSERVER_SERVICE;
+    }
+    else {
+        return false;
+    }
+
+    m_adaptors.insert(module, adaptor);
+    if (registered) {
+        m_services.insert(service, module);
+    }
+    return registered;
+}
+
+void KmreServices::stopService(const QString &service)
+{
+    if (!m_services.contains(service)) {
+        return;
+    }
+
+    QString module = m_services.take(service);
+    QDBusConnection connection = QDBusConnection::sessionBus();
+    connection.unregisterService(service);
+    if (module == "audio") {
+        connection.unregisterObject(AUDIO_PATH);
+    }
+    else {
+        /*
+         * gps和sensor共用"/"，先注销对象再销毁本模块的接口，
+         * 接口销毁后再为另一个模块重新导出"/"
+         */
+        QObject *adaptor = m_adaptors.take(module);
+        connection.unregisterObject(KYLIN_GPSSERVER_PATH);
+        connect(adaptor, &QObject::destroyed, this, [this]() {
+            if (!m_adaptors.isEmpty() && !QDBusConnection::sessionBus().objectRegisteredAt(KYLIN_GPSSERVER_PATH)) {
+                QDBusConnection::sessionBus().registerObject(KYLIN_GPSSERVER_PATH, m_root,
+                                                             QDBusConnection::ExportAdaptors);
+            }
+        });
+        adaptor->deleteLater();
+    }
+
+    /*
+     * 模块的工作线程阻塞在容器socket上，且数据对象是单例，无法在进程内停止和释放。
+     * 此时释放锁会让独立进程启动并与仍在运行的模块争用同一socket，所以锁一直持有；
+     * 服务名再被D-Bus激活时，新进程拿不到锁，会通过resumeService()让本进程重新注册。
+     */
+    m_stopped.insert(module);
+    syslog(LOG_INFO, "[%s] %s stopped, %s keeps running until it is resumed or the host exits", __func__,
+           service.toStdString().c_str(), module.toStdString().c_str());
+
+    /* 所有服务都已停止，退出进程 */
+    if (m_services.isEmpty()) {
+        qApp->quit();
+    }
+}
+
+bool KmreServices::resumeService(const QString &module)
+{
+    if (!m_stopped.contains(module)) {
+        return false;
+    }
+
+    if (!registerModule(module)) {
+        return false;
+    }
+
+    m_stopped.remove(module);
+    syslog(LOG_INFO, "[%s] %s resumed", __func__, module.toStdString().c_str());
+    return true;
+}
+
+void KmreServices::resumeInHost(const QStringList &modules)
+{
+    QDBusInterface host(SERVICES_SERVICE, SERVICES_PATH, SERVICES_INTERFACE, QDBusConnection::sessionBus());
+    if (!host.isValid()) {
+        return;
+    }
+
+    for (const QString &module : modules) {
+        QDBusReply<bool> reply = host.call("resumeService", module);
+        if (reply.isValid() && reply.value()) {
+            syslog(LOG_INFO, "[%s] %s is provided by the running host again", __func__,
+                   module.toStdString().c_str());
+        }
+    }
+}
+
+void KmreServices::onStopApplication(const QString &container)
+{
+    QString name = QString("kmre-%1-%2").arg(Utils::getUid()).arg(Utils::getUserName());
+    if (name == container) {
+        ThreadPool::instance()->deleteLater();
+        exit(0);
+    }
+}
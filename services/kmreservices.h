@@ -0,0 +1,73 @@
+/*
+ * Copyright (c) KylinSoft Co., Ltd. 2016-2024.All rights reserved.
+ *
+ * Authors:
+ *  Kobe Lee    lixiang@kylinos.cn
+ * 
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef KMRE_SERVICES_H
+#define KMRE_SERVICES_H
+
+#include <QObject>
+#include <QMap>
+#include <QSet>
+#include <QString>
+#include <QStringList>
+
+class KmreAudio;
+class KmreGps;
+class KmreSensor;
+
+/*
+ * 在同一进程内承载audio/sensor/gps服务，共用事件循环和session bus连接，
+ * 对外仍使用各自原有的服务名和对象路径。
+ */
+class KmreServices : public QObject
+{
+    Q_OBJECT
+    Q_CLASSINFO("D-Bus Interface", "cn.kylinos.Kmre.Services")
+public:
+    KmreServices(QObject *parent = 0);
+    ~KmreServices();
+
+    /* modules为"audio"、"sensor"、"gps"的子集，返回实际启动的模块数 */
+    int init(const QStringList &modules);
+
+public slots:
+    void onStopApplication(const QString &container);
+    /* 被D-Bus重新激活的进程拿不到锁时调用，由本进程重新提供已停止的模块 */
+    Q_SCRIPTABLE bool resumeService(const QString &module);
+
+private:
+    bool lockModule(const QString &module, const char *lockName);
+    bool registerModule(const QString &module);
+    void stopService(const QString &service);
+    void resumeInHost(const QStringList &modules);
+
+    QObject *m_root = nullptr;
+    KmreAudio *m_audio = nullptr;
+    KmreGps *m_gps = nullptr;
+    KmreSensor *m_sensor = nullptr;
+    /* 服务名 -> 模块名 */
+    QMap<QString, QString> m_services;
+    /* 模块名 -> 单实例锁 */
+    QMap<QString, int> m_locks;
+    /* 模块名 -> 导出在m_root上的gps/sensor接口 */
+    QMap<QString, QObject *> m_adaptors;
+    /* 服务名已注销、模块仍在运行的模块 */
+    QSet<QString> m_stopped;
+};
+
+#endif // KMRE_SERVICES_H
@@ -0,0 +1,54 @@
+/*
+ * Copyright (c) KylinSoft Co., Ltd. 2016-2024.All rights reserved.
+ *
+ * Authors:
+ *  Kobe Lee    lixiang@kylinos.cn
+ * 
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <QCoreApplication>
+#include <QStringList>
+#include <sys/syslog.h>
+
+#include "kmreservices.h"
+
+#define LOG_IDENT "KMRE_kylin-kmre-services"
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication a(argc, argv);
+
+    openlog(LOG_IDENT, LOG_NDELAY | LOG_NOWAIT | LOG_PID, LOG_USER);
+
+    /* --modules audio,sensor,gps 指定承载的服务，默认全部 */
+    QStringList modules = QStringList() << "audio" << "sensor" << "gps";
+    QStringList args = a.arguments();
+    int index = args.indexOf("--modules");
+    if (index > 0 && index + 1 < args.size()) {
+        modules = args.at(index + 1).split(",", QString::SkipEmptyParts);
+    }
+
+    KmreServices services;
+    if (services.init(modules) == 0) {
+        syslog(LOG_ERR, "No service registered, exit");
+        closelog();
+        return 1;
+    }
+
+    int nRet = a.exec();
+
+    closelog();
+
+    return nRet;
+}
@@ -0,0 +1,91 @@
+# Copyright (c) KylinSoft Co., Ltd. 2016-2024.All rights reserved.
+#
+# Authors:
+#  Kobe Lee    lixiang@kylinos.cn
+#
+# This program is free software; you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation; version 3.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+# Hosts the audio, sensor and gps services in one process. Only built when
+# qmake is run with CONFIG+=kmre_single_process, see ../kylin-kmre-manager.pro.
+
+TARGET = kylin-kmre-services
+TEMPLATE = app
+
+QT -= gui
+
+QT += multimedia core network dbus
+
+CONFIG += c++14 console
+CONFIG -= app_bundle
+
+CONFIG += link_pkgconfig
+PKGCONFIG += speexdsp
+
+target.source += $$TARGET
+target.path = /usr/bin
+dbus_service.files += \
+    single-process/cn.kylinos.Kmre.Audio.service \
+    single-process/com.kylin.Kmre.gps.service \
+    single-process/com.kylin.Kmre.sensor.service
+dbus_service.path = /usr/share/dbus-1/services/
+
+INSTALLS += target \
+    dbus_service
+
+DEFINES += QT_DEPRECATED_WARNINGS
+
+QMAKE_CPPFLAGS *= $(shell dpkg-buildflags --get CPPFLAGS)
+QMAKE_CFLAGS   *= $(shell dpkg-buildflags --get CFLAGS)
+QMAKE_CXXFLAGS *= $(shell dpkg-buildflags --get CXXFLAGS)
+QMAKE_LFLAGS   *= $(shell dpkg-buildflags --get LDFLAGS)
+QMAKE_CXXFLAGS *= -fpermissive
+QMAKE_CXXFLAGS += -g
+
+LIBS += -ldl -lasound
+
+INCLUDEPATH += ../audio ../gps ../sensors
+
+SOURCES += main.cpp \
+    kmreservices.cpp \
+    ../audio/kmreaudio.cpp \
+    ../audio/audio_adaptor.cpp \
+    ../audio/audioserver.cpp \
+    ../audio/playbackworker.cpp \
+    ../audio/recordingworker.cpp \
+    ../gps/gpsdbusadaptor.cpp \
+    ../gps/gpsdataget.cpp \
+    ../gps/kmregps.cpp \
+    ../sensors/sensordbusadaptor.cpp \
+    ../sensors/sensordataget.cpp \
+    ../sensors/kmresensor.cpp
+
+HEADERS += \
+    kmreservices.h \
+    ../audio/kmreaudio.h \
+    ../audio/audio_adaptor.h \
+    ../audio/audioserver.h \
+    ../audio/playbackworker.h \
+    ../audio/recordingworker.h \
+    ../gps/gpsdbusadaptor.h \
+    ../gps/gpsdataget.h \
+    ../gps/kmregps.h \
+    ../sensors/sensordbusadaptor.h \
+    ../sensors/sensordataget.h \
+    ../sensors/kmresensor.h
+
+include(../common/common.pri)
+
+unix {
+    MOC_DIR = .moc
+    OBJECTS_DIR = .obj
+}